@@ -0,0 +1,222 @@
+#include "Base64.hpp"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Encodes whole 3 byte groups and the padded tail
+void EncodeScalar(const uint8_t* src, size_t len, char* dst)
+{
+	while (len >= 3)
+	{
+		uint32_t v = (src[0] << 16) | (src[1] << 8) | src[2];
+		dst[0] = Alphabet[(v >> 18) & 0x3f];
+		dst[1] = Alphabet[(v >> 12) & 0x3f];
+		dst[2] = Alphabet[(v >> 6) & 0x3f];
+		dst[3] = Alphabet[v & 0x3f];
+		src += 3;
+		dst += 4;
+		len -= 3;
+	}
+
+	if (len)
+	{
+		uint32_t v = src[0] << 16;
+		if (len == 2)
+			v |= src[1] << 8;
+		dst[0] = Alphabet[(v >> 18) & 0x3f];
+		dst[1] = Alphabet[(v >> 12) & 0x3f];
+		dst[2] = len == 2 ? Alphabet[(v >> 6) & 0x3f] : '=';
+		dst[3] = '=';
+	}
+}
+
+#ifdef BASE64_X86
+
+// Vector kernels follow Mula and Lemire, "Faster Base64 Encoding and Decoding
+// using AVX2 Instructions": spread 12 bytes into 16 sextets, one per byte,
+// then map each sextet to its character with a small shift table.
+
+TARGET_SSSE3 inline __m128i Reshuffle(__m128i in)
+{
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+TARGET_SSSE3 inline __m128i Translate(__m128i in)
+{
+	const __m128i shifts = _mm_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	__m128i index = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	const __m128i lower = _mm_cmpgt_epi8(_mm_set1_epi8(26), in);
+	index = _mm_or_si128(index, _mm_and_si128(lower, _mm_set1_epi8(13)));
+	return _mm_add_epi8(in, _mm_shuffle_epi8(shifts, index));
+}
+
+// Returns bytes consumed, always a multiple of 3
+TARGET_SSSE3 size_t EncodeSSSE3(const uint8_t* src, size_t len, char* dst)
+{
+	size_t done = 0;
+
+	// Each step reads 16 bytes but only consumes 12
+	while (len - done >= 16)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i*)(src + done));
+		_mm_storeu_si128((__m128i*)dst, Translate(Reshuffle(in)));
+		done += 12;
+		dst += 16;
+	}
+
+	return done;
+}
+
+TARGET_AVX2 inline __m256i Reshuffle(__m256i in)
+{
+	in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+		10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+		10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	return _mm256_or_si256(t1, t3);
+}
+
+TARGET_AVX2 inline __m256i Translate(__m256i in)
+{
+	const __m256i shifts = _mm256_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	__m256i index = _mm256_subs_epu8(in, _mm256_set1_epi8(51));
+	const __m256i lower = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), in);
+	index = _mm256_or_si256(index, _mm256_and_si256(lower, _mm256_set1_epi8(13)));
+	return _mm256_add_epi8(in, _mm256_shuffle_epi8(shifts, index));
+}
+
+// Returns bytes consumed, always a multiple of 3
+TARGET_AVX2 size_t EncodeAVX2(const uint8_t* src, size_t len, char* dst)
+{
+	size_t done = 0;
+
+	// Each lane gets 12 bytes, second load reads 16 bytes starting at 12
+	while (len - done >= 28)
+	{
+		__m128i lo = _mm_loadu_si128((const __m128i*)(src + done));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(src + done + 12));
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+		_mm256_storeu_si256((__m256i*)dst, Translate(Reshuffle(in)));
+		done += 24;
+		dst += 32;
+	}
+
+	return done;
+}
+
+enum class Isa
+{
+	Scalar,
+	SSSE3,
+	AVX2
+};
+
+Isa DetectIsa()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	int max = info[0];
+
+	__cpuid(info, 1);
+	bool ssse3 = (info[2] & (1 << 9)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx2 = false;
+	if (max >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] & (1 << 5)) != 0;
+	}
+#else
+	__builtin_cpu_init();
+	bool ssse3 = __builtin_cpu_supports("ssse3");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	if (avx2)
+		return Isa::AVX2;
+	if (ssse3)
+		return Isa::SSSE3;
+	return Isa::Scalar;
+}
+
+#endif
+
+void Encode(const uint8_t* src, size_t len, char* dst)
+{
+	size_t done = 0;
+
+#ifdef BASE64_X86
+	static const Isa isa = DetectIsa();
+
+	if (isa == Isa::AVX2)
+		done = EncodeAVX2(src, len, dst);
+	if (isa >= Isa::SSSE3)
+		done += EncodeSSSE3(src + done, len - done, dst + done / 3 * 4);
+#endif
+
+	EncodeScalar(src + done, len - done, dst + done / 3 * 4);
+}
+
+}
+
+void Base64Encode(const uint8_t* src, size_t len, char* dst)
+{
+	Encode(src, len, dst);
+}
+
+void Base64EncodeScalar(const uint8_t* src, size_t len, char* dst)
+{
+	EncodeScalar(src, len, dst);
+}
+
+void Base64Encode(const uint8_t* src, size_t len, wchar_t* dst)
+{
+	// Encode in cache sized chunks and widen them, multiple of 3 so only the last one gets padding
+	const size_t Chunk = 3 * 1024;
+	char narrow[Chunk / 3 * 4];
+
+	while (len)
+	{
+		size_t size = len < Chunk ? len : Chunk;
+		size_t encoded = Base64EncodedLength(size);
+
+		Encode(src, size, narrow);
+		for (size_t i = 0; i < encoded; ++i)
+			dst[i] = narrow[i];
+
+		src += size;
+		dst += encoded;
+		len -= size;
+	}
+}
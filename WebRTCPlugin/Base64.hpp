@@ -0,0 +1,23 @@
+#ifndef BASE64_HPP
+#define BASE64_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Characters needed to encode len bytes, padding included
+inline size_t Base64EncodedLength(size_t len)
+{
+	return ((len + 2) / 3) * 4;
+}
+
+// Encode into a buffer of at least Base64EncodedLength(len) characters, no terminator is written.
+// Uses AVX2 or SSSE3 when the cpu supports them, picked once at runtime.
+void Base64Encode(const uint8_t* src, size_t len, char* dst);
+
+// Same, for wide strings such as a BSTR allocated with the final length
+void Base64Encode(const uint8_t* src, size_t len, wchar_t* dst);
+
+// Portable encoder, reference output for the vector paths
+void Base64EncodeScalar(const uint8_t* src, size_t len, char* dst);
+
+#endif
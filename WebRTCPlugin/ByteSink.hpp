@@ -0,0 +1,55 @@
+#ifndef BYTE_SINK_HPP
+#define BYTE_SINK_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Destination for encoded bytes, so encoders write straight into the final container
+class ByteSink
+{
+public:
+	virtual ~ByteSink() = default;
+
+	// Room for at least size more bytes after the written ones, nullptr if it can not grow
+	virtual uint8_t* Reserve(size_t size) = 0;
+	// Mark size bytes of the last reservation as written
+	virtual void Commit(size_t size) = 0;
+	// Bytes written so far
+	virtual size_t GetSize() const = 0;
+};
+
+// Sink backed by a vector, used as scratch when bytes still need processing
+class VectorByteSink : public ByteSink
+{
+public:
+	uint8_t* Reserve(size_t size) override
+	{
+		// Grow geometrically so encoders asking for small chunks do not copy over and over
+		if (data.size() < used + size)
+			data.resize(used + size > data.size() * 2 ? used + size : data.size() * 2);
+		return data.data() + used;
+	}
+
+	void Commit(size_t size) override
+	{
+		used += size;
+	}
+
+	size_t GetSize() const override
+	{
+		return used;
+	}
+
+	const uint8_t* GetData() const
+	{
+		return data.data();
+	}
+
+private:
+	std::vector<uint8_t> data;
+	size_t used = 0;
+};
+
+#endif
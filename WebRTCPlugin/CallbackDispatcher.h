@@ -153,6 +153,17 @@ public:
 		});
 	}
 
+	HRESULT DispatchAsync(Callback& callback, const std::shared_ptr<_variant_t> &variant)
+	{
+		//clone callback
+		Callback *cloned = new Callback(callback);
+		//Dispatch, sharing the value so big strings or arrays are not copied
+		return DispatchAsyncInternal([=]() {
+			cloned->Invoke(*variant);
+			delete(cloned);
+		});
+	}
+
 	HRESULT DispatchAsync(Callback& callback, const _variant_t &variant1, const _variant_t &variant2)
 	{
 		//clone callback
@@ -175,6 +186,17 @@ public:
 		});
 	}
 
+	HRESULT DispatchAsync(Callback& callback, const std::shared_ptr<std::vector<variant_t>> &variants)
+	{
+		//clone callback
+		Callback *cloned = new Callback(callback);
+		//Dispatch, sharing the values so big strings or arrays are not copied
+		return DispatchAsyncInternal([=]() {
+			cloned->Invoke(*variants);
+			delete(cloned);
+		});
+	}
+
 	HRESULT DispatchAsync(Callback& callback, const std::vector<variant_t> &variants)
 	{
 		//clone callback
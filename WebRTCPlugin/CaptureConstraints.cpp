@@ -0,0 +1,71 @@
+#include "CaptureConstraints.hpp"
+
+#include <math.h>
+#include <stdint.h>
+
+// Relative distance from the ideal, 0 when equal or unset, up to 1
+static double FitnessDistance(double value, double ideal)
+{
+	if (ideal < 0 || value == ideal)
+		return 0;
+
+	double larger = fabs(value) > fabs(ideal) ? fabs(value) : fabs(ideal);
+	return fabs(value - ideal) / larger;
+}
+
+int MatchCaptureMode(const std::vector<CaptureMode>& modes, const CaptureConstraints& constraints)
+{
+	// Default size only when the application asked for none
+	double idealWidth = constraints.width.ideal;
+	double idealHeight = constraints.height.ideal;
+	double idealFrameRate = constraints.frameRate.ideal;
+	if (idealWidth < 0 && idealHeight < 0)
+	{
+		idealWidth = DefaultCaptureWidth;
+		idealHeight = DefaultCaptureHeight;
+	}
+	if (idealFrameRate < 0)
+		idealFrameRate = DefaultCaptureFrameRate;
+
+	int best = -1;
+	double bestDistance = 0;
+
+	for (size_t i = 0; i < modes.size(); ++i)
+	{
+		const CaptureMode& mode = modes[i];
+
+		// Hard limits
+		if (!constraints.width.Allows(mode.width) ||
+			!constraints.height.Allows(mode.height) ||
+			!constraints.frameRate.Allows(mode.frameRate))
+			continue;
+
+		double distance =
+			FitnessDistance(mode.width, idealWidth) +
+			FitnessDistance(mode.height, idealHeight) +
+			FitnessDistance(mode.frameRate, idealFrameRate);
+
+		// Ties go to the bigger mode, then the faster one, then the preferred format
+		bool better = best < 0 || distance < bestDistance;
+		if (!better && distance == bestDistance)
+		{
+			const CaptureMode& current = modes[best];
+			int64_t pixels = (int64_t)mode.width * mode.height;
+			int64_t bestPixels = (int64_t)current.width * current.height;
+			if (pixels != bestPixels)
+				better = pixels > bestPixels;
+			else if (mode.frameRate != current.frameRate)
+				better = mode.frameRate > current.frameRate;
+			else
+				better = mode.format < current.format;
+		}
+
+		if (better)
+		{
+			best = (int)i;
+			bestDistance = distance;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,62 @@
+#ifndef CAPTURE_CONSTRAINTS_HPP
+#define CAPTURE_CONSTRAINTS_HPP
+
+#include <string>
+#include <vector>
+
+// Numeric constraint as given to getUserMedia, negative values are unset.
+// exact is stored as min and max, a bare value as ideal.
+struct ConstraintRange
+{
+	double min = -1;
+	double ideal = -1;
+	double max = -1;
+
+	bool Allows(double value) const
+	{
+		return (min < 0 || value >= min) && (max < 0 || value <= max);
+	}
+};
+
+struct CaptureConstraints
+{
+	// Empty picks the first device that opens
+	std::string deviceId;
+	bool exactDeviceId = false;
+	ConstraintRange width;
+	ConstraintRange height;
+	ConstraintRange frameRate;
+};
+
+// Pixel formats by preference, best first. The camera produces NV12, YUY2 and
+// MJPEG itself and they only need a repack or a decode into I420. A UVC camera
+// offers I420 and the rest through its driver, converting before we get it.
+enum class CaptureFormat
+{
+	NV12,
+	YUY2,
+	MJPEG,
+	I420,
+	Other
+};
+
+// One of the modes a device can capture in
+struct CaptureMode
+{
+	int width = 0;
+	int height = 0;
+	int frameRate = 0;
+	CaptureFormat format = CaptureFormat::Other;
+};
+
+// Used when no ideal is given, same as browsers
+static const int DefaultCaptureWidth = 640;
+static const int DefaultCaptureHeight = 480;
+static const int DefaultCaptureFrameRate = 30;
+
+// Pick the mode closest to the ideal values among the ones within every min and max,
+// using the getUserMedia fitness distance. Among equally close modes the first format
+// in CaptureFormat order wins. Returns its index, -1 if none is allowed.
+int MatchCaptureMode(const std::vector<CaptureMode>& modes, const CaptureConstraints& constraints);
+
+#endif
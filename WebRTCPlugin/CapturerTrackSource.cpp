@@ -0,0 +1,162 @@
+#include "stdafx.h"
+#include "LogSinkImpl.h"
+#include "CapturerTrackSource.hpp"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "rtc_base/logging.h"
+#include "rtc_base/ref_counted_object.h"
+
+namespace {
+
+class SharedCapturerTrackSource;
+
+// Sources currently running, process wide
+std::mutex registryMutex;
+std::map<std::string, SharedCapturerTrackSource*> registry;
+
+// Another mode of the same device needs a capture of its own
+std::string GetKey(const VcmCapturer::Device& device)
+{
+	return device.id + "|" +
+		std::to_string(device.capability.width) + "x" + std::to_string(device.capability.height) + "@" +
+		std::to_string(device.capability.maxFPS) + "/" + std::to_string((int)device.capability.videoType);
+}
+
+// Leaves the registry under its lock before the last reference is dropped,
+// so a lookup never hands out a source that is being destroyed
+class SharedCapturerTrackSource : public rtc::RefCountedObject<CapturerTrackSource>
+{
+public:
+	SharedCapturerTrackSource(std::unique_ptr<VcmCapturer> capturer, const std::string& key) :
+		rtc::RefCountedObject<CapturerTrackSource>(std::move(capturer), key)
+	{
+	}
+
+	rtc::RefCountReleaseStatus Release() const override
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		if (HasOneRef())
+		{
+			auto it = registry.find(key);
+			if (it != registry.end() && it->second == this)
+				registry.erase(it);
+		}
+
+		// Stops the camera when it was the last one
+		return rtc::RefCountedObject<CapturerTrackSource>::Release();
+	}
+};
+
+}
+
+CapturerTrackSource::CapturerTrackSource(std::unique_ptr<VcmCapturer> capturer, const std::string& key) :
+	VideoTrackSource(/*remote=*/false),
+	capturer(std::move(capturer)),
+	key(key)
+{
+}
+
+rtc::scoped_refptr<CapturerTrackSource> CapturerTrackSource::Create(const CaptureConstraints& constraints)
+{
+	FUNC_BEGIN();
+
+	auto devices = VcmCapturer::FindDevices(constraints);
+
+	// Out of the lock, releasing it takes the lock again
+	rtc::scoped_refptr<CapturerTrackSource> source;
+	{
+		// Held while opening so two tracks do not open the same camera twice
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		for (const auto& device : devices)
+		{
+			std::string key = GetKey(device);
+
+			// Already running
+			auto it = registry.find(key);
+			if (it != registry.end())
+			{
+				source = it->second;
+				break;
+			}
+
+			std::unique_ptr<VcmCapturer> capturer(VcmCapturer::Create(device));
+			if (capturer)
+			{
+				SharedCapturerTrackSource* shared = new SharedCapturerTrackSource(std::move(capturer), key);
+				registry[key] = shared;
+				source = shared;
+				break;
+			}
+
+			// Busy capturing another mode for us, share it and let each sink adapter scale
+			for (const auto& entry : registry)
+			{
+				if (entry.second->capturer->id_ == device.id)
+				{
+					RTC_LOG(LS_INFO) << "sharing running capture " << entry.first << " instead of " << key;
+					source = entry.second;
+					break;
+				}
+			}
+			if (source)
+				break;
+		}
+	}
+
+	FUNC_END();
+
+	return source;
+}
+
+CapturerTrackView::CapturerTrackView(const rtc::scoped_refptr<CapturerTrackSource>& shared) :
+	VideoTrackSource(/*remote=*/false),
+	shared(shared)
+{
+}
+
+rtc::scoped_refptr<CapturerTrackView> CapturerTrackView::Create(const rtc::scoped_refptr<CapturerTrackSource>& shared)
+{
+	if (!shared)
+		return nullptr;
+
+	return new rtc::RefCountedObject<CapturerTrackView>(shared);
+}
+
+void CapturerTrackView::AddOrUpdateSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, const rtc::VideoSinkWants& wants)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	shared->capturer->AddOrUpdateSink(sink, wants);
+	shared->capturer->SetCropOffset(sink, crop_offset_x, crop_offset_y);
+
+	if (std::find(sinks.begin(), sinks.end(), sink) == sinks.end())
+		sinks.push_back(sink);
+}
+
+void CapturerTrackView::RemoveSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sinks.erase(std::remove(sinks.begin(), sinks.end(), sink), sinks.end());
+	}
+
+	// Out of the lock, removing waits for a delivery whose sinks may be adding through us
+	shared->capturer->RemoveSink(sink);
+}
+
+void CapturerTrackView::SetCropOffset(float x, float y)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	crop_offset_x = x;
+	crop_offset_y = y;
+
+	// Other tracks on the same capture keep theirs
+	for (auto sink : sinks)
+		shared->capturer->SetCropOffset(sink, x, y);
+}
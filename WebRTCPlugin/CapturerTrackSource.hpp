@@ -0,0 +1,69 @@
+#ifndef CAPTURER_TRACK_SOURCE_HPP
+#define CAPTURER_TRACK_SOURCE_HPP
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pc/video_track_source.h"
+#include "api/scoped_refptr.h"
+
+#include "CaptureConstraints.hpp"
+#include "VcmCapturer.hpp"
+
+// Video source running a camera. Every track opened on the same device and mode
+// shares one, each one adapted to its own sink wants by the capturer, and the
+// camera is stopped when the last track is released.
+class CapturerTrackSource : public webrtc::VideoTrackSource
+{
+public:
+	// Running source for the constraints, the already open one when there is one
+	static rtc::scoped_refptr<CapturerTrackSource> Create(const CaptureConstraints& constraints);
+
+	std::unique_ptr<VcmCapturer> capturer;
+
+	// Device and mode it is registered for
+	const std::string key;
+
+protected:
+	CapturerTrackSource(std::unique_ptr<VcmCapturer> capturer, const std::string& key);
+
+private:
+	rtc::VideoSourceInterface<webrtc::VideoFrame>* source() override
+	{
+		return capturer.get();
+	}
+};
+
+// What one track sees of a shared source. Sinks added through it get the crop
+// offset set on it, so tracks on the same camera can pan on their own.
+class CapturerTrackView : public webrtc::VideoTrackSource
+{
+public:
+	static rtc::scoped_refptr<CapturerTrackView> Create(const rtc::scoped_refptr<CapturerTrackSource>& shared);
+
+	void AddOrUpdateSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, const rtc::VideoSinkWants& wants) override;
+	void RemoveSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) override;
+
+	// See VideoCapturer::SetCropOffset, for every sink of this track
+	void SetCropOffset(float x, float y);
+
+	const rtc::scoped_refptr<CapturerTrackSource> shared;
+
+protected:
+	explicit CapturerTrackView(const rtc::scoped_refptr<CapturerTrackSource>& shared);
+
+private:
+	rtc::VideoSourceInterface<webrtc::VideoFrame>* source() override
+	{
+		return shared->capturer.get();
+	}
+
+	std::mutex mutex;
+	std::vector<rtc::VideoSinkInterface<webrtc::VideoFrame>*> sinks;
+	float crop_offset_x = 0.5f;
+	float crop_offset_y = 0.5f;
+};
+
+#endif
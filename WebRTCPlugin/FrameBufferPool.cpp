@@ -0,0 +1,70 @@
+#include "stdafx.h"
+#include "FrameBufferPool.hpp"
+
+FrameBufferPool::FrameBufferPool(size_t maxBuffers, size_t maxSizes) :
+	maxBuffers(maxBuffers),
+	maxSizes(maxSizes > 0 ? maxSizes : 1)
+{
+	sizes.reserve(this->maxSizes);
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer> FrameBufferPool::CreateBuffer(int width, int height)
+{
+	uses++;
+
+	// Buffers of this size
+	Size* size = nullptr;
+	for (auto& it : sizes)
+	{
+		if (it.width == width && it.height == height)
+		{
+			size = &it;
+			break;
+		}
+	}
+
+	if (!size)
+	{
+		// Make room dropping the least recently used size
+		if (sizes.size() >= maxSizes)
+		{
+			auto oldest = sizes.begin();
+			for (auto it = sizes.begin(); it != sizes.end(); ++it)
+				if (it->lastUsed < oldest->lastUsed)
+					oldest = it;
+			sizes.erase(oldest);
+		}
+
+		sizes.push_back(Size{ width, height, 0, {} });
+		size = &sizes.back();
+		size->buffers.reserve(maxBuffers);
+	}
+
+	size->lastUsed = uses;
+
+	// Only us holding it, nobody downstream is reading it anymore
+	for (auto& buffer : size->buffers)
+	{
+		if (buffer->HasOneRef())
+		{
+			hits++;
+			return buffer;
+		}
+	}
+
+	misses++;
+
+	// All in use and no room for more, do not keep it
+	if (size->buffers.size() >= maxBuffers)
+		return webrtc::I420Buffer::Create(width, height);
+
+	rtc::scoped_refptr<PooledBuffer> buffer = new PooledBuffer(width, height);
+	size->buffers.push_back(buffer);
+
+	return buffer;
+}
+
+void FrameBufferPool::Release()
+{
+	sizes.clear();
+}
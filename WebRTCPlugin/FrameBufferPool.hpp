@@ -0,0 +1,57 @@
+#ifndef FRAME_BUFFER_POOL_HPP
+#define FRAME_BUFFER_POOL_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "api/video/i420_buffer.h"
+#include "rtc_base/ref_counted_object.h"
+
+// Hands out I420 buffers, reusing them once every downstream reference is
+// gone, like webrtc::I420BufferPool but keeping buffers of several sizes so
+// adapters switching resolutions back and forth do not flush it.
+// Retained buffers are bounded, when all of them are still in use a plain
+// buffer is allocated instead. Not thread safe, meant for one capture thread.
+class FrameBufferPool
+{
+public:
+	static const size_t DefaultMaxBuffers = 4;
+	static const size_t DefaultMaxSizes = 2;
+
+	explicit FrameBufferPool(size_t maxBuffers = DefaultMaxBuffers, size_t maxSizes = DefaultMaxSizes);
+
+	// Never null unless out of memory, contents are undefined
+	rtc::scoped_refptr<webrtc::I420Buffer> CreateBuffer(int width, int height);
+
+	// Drop retained buffers, the ones still in use are freed by their last owner
+	void Release();
+
+	// Buffers reused, and allocated because none of the right size was free
+	uint64_t GetHits() const { return hits; }
+	uint64_t GetMisses() const { return misses; }
+
+private:
+	typedef rtc::RefCountedObject<webrtc::I420Buffer> PooledBuffer;
+
+	struct Size
+	{
+		int width;
+		int height;
+		uint64_t lastUsed;
+		std::vector<rtc::scoped_refptr<PooledBuffer>> buffers;
+	};
+
+	size_t maxBuffers;
+	size_t maxSizes;
+	std::vector<Size> sizes;
+	uint64_t uses = 0;
+
+	std::atomic<uint64_t> hits{ 0 };
+	std::atomic<uint64_t> misses{ 0 };
+};
+
+#endif
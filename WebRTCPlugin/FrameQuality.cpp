@@ -0,0 +1,139 @@
+#include "FrameQuality.hpp"
+
+#undef FOURCC
+#include "third_party/libyuv/include/libyuv.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRAME_QUALITY_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Sum and sum of squares of the 4 neighbour Laplacian over one row, borders excluded
+inline void LaplacianRowC(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+	int from, int to, int64_t& sum, uint64_t& sumSquares)
+{
+	for (int x = from; x < to; ++x)
+	{
+		int laplacian = above[x] + below[x] + row[x - 1] + row[x + 1] - 4 * row[x];
+		sum += laplacian;
+		sumSquares += laplacian * laplacian;
+	}
+}
+
+#ifdef FRAME_QUALITY_SSE2
+
+// Laplacian of 8 pixels widened to 16 bits, it fits in -1020..1020
+inline __m128i Laplacian8(__m128i above, __m128i below, __m128i left, __m128i right, __m128i center)
+{
+	__m128i sum = _mm_add_epi16(_mm_add_epi16(above, below), _mm_add_epi16(left, right));
+	return _mm_sub_epi16(sum, _mm_slli_epi16(center, 2));
+}
+
+inline void LaplacianRowSSE2(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+	int width, int64_t& sum, uint64_t& sumSquares)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+
+	// 32 bit lanes can not overflow within a row: 1020 * 1020 * 2 per step, a few hundred steps
+	__m128i sums = _mm_setzero_si128();
+	__m128i squares = _mm_setzero_si128();
+
+	int x = 1;
+	for (; x + 16 <= width - 1; x += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(above + x));
+		__m128i b = _mm_loadu_si128((const __m128i*)(below + x));
+		__m128i l = _mm_loadu_si128((const __m128i*)(row + x - 1));
+		__m128i r = _mm_loadu_si128((const __m128i*)(row + x + 1));
+		__m128i c = _mm_loadu_si128((const __m128i*)(row + x));
+
+		__m128i lo = Laplacian8(
+			_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero),
+			_mm_unpacklo_epi8(l, zero), _mm_unpacklo_epi8(r, zero),
+			_mm_unpacklo_epi8(c, zero));
+		__m128i hi = Laplacian8(
+			_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero),
+			_mm_unpackhi_epi8(l, zero), _mm_unpackhi_epi8(r, zero),
+			_mm_unpackhi_epi8(c, zero));
+
+		sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_add_epi16(lo, hi), ones));
+		squares = _mm_add_epi32(squares, _mm_madd_epi16(lo, lo));
+		squares = _mm_add_epi32(squares, _mm_madd_epi16(hi, hi));
+	}
+
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes, sums);
+	sum += (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+	// Squares are positive, read them as unsigned
+	uint32_t squareLanes[4];
+	_mm_storeu_si128((__m128i*)squareLanes, squares);
+	sumSquares += (uint64_t)squareLanes[0] + squareLanes[1] + squareLanes[2] + squareLanes[3];
+
+	LaplacianRowC(above, row, below, x, width - 1, sum, sumSquares);
+}
+
+#endif
+
+}
+
+double ComputeSharpness(const uint8_t* dataY, int strideY, int width, int height)
+{
+	// Needs a border pixel all around
+	if (width < 3 || height < 3)
+		return 0;
+
+	int64_t sum = 0;
+	uint64_t sumSquares = 0;
+
+	for (int y = 1; y < height - 1; ++y)
+	{
+		const uint8_t* above = dataY + (y - 1) * strideY;
+		const uint8_t* row = dataY + y * strideY;
+		const uint8_t* below = dataY + (y + 1) * strideY;
+
+#ifdef FRAME_QUALITY_SSE2
+		// Keep 32 bit lane sums safe on very wide rows
+		if (width <= 8192)
+		{
+			LaplacianRowSSE2(above, row, below, width, sum, sumSquares);
+			continue;
+		}
+#endif
+		LaplacianRowC(above, row, below, 1, width - 1, sum, sumSquares);
+	}
+
+	double count = (double)(width - 2) * (height - 2);
+	double mean = sum / count;
+
+	return sumSquares / count - mean * mean;
+}
+
+double SharpnessScorer::Score(const uint8_t* dataY, int strideY, int width, int height, int maxWidth)
+{
+	if (maxWidth <= 0 || width <= maxWidth)
+		return ComputeSharpness(dataY, strideY, width, height);
+
+	int scaledWidth = maxWidth;
+	int scaledHeight = (int)((int64_t)height * maxWidth / width);
+	if (scaledHeight < 3)
+		scaledHeight = 3;
+
+	scaled.resize((size_t)scaledWidth * scaledHeight);
+
+	libyuv::ScalePlane(
+		dataY,
+		strideY,
+		width,
+		height,
+		scaled.data(),
+		scaledWidth,
+		scaledWidth,
+		scaledHeight,
+		libyuv::kFilterBox);
+
+	return ComputeSharpness(scaled.data(), scaledWidth, scaledWidth, scaledHeight);
+}
@@ -0,0 +1,25 @@
+#ifndef FRAME_QUALITY_HPP
+#define FRAME_QUALITY_HPP
+
+#include <stdint.h>
+
+#include <vector>
+
+// Sharpness of a luma plane as the variance of its Laplacian, higher is sharper.
+// Only comparable between frames of the same size and content.
+double ComputeSharpness(const uint8_t* dataY, int strideY, int width, int height);
+
+// Scores frames on a box scaled copy of their luma plane, reusing the scratch plane.
+// Scores taken with different maximum widths are not comparable.
+// Instances are not thread safe, each thread must own its scorer.
+class SharpnessScorer
+{
+public:
+	// Planes wider than maxWidth are scaled down first, zero scores at full size
+	double Score(const uint8_t* dataY, int strideY, int width, int height, int maxWidth);
+
+private:
+	std::vector<uint8_t> scaled;
+};
+
+#endif
@@ -38,6 +38,30 @@ inline int64_t GetInt(VARIANT* variant, int64_t default)
 	return default;
 }
 
+// Numbers computed in javascript are often doubles
+inline double GetNumber(VARIANT* variant, double default)
+{
+	switch (variant->vt)
+	{
+	case VT_R8:
+		return V_R8(variant);
+	case VT_R4:
+		return V_R4(variant);
+	case VT_I1:
+	case VT_I2:
+	case VT_I4:
+	case VT_UI1:
+	case VT_UI2:
+	case VT_INT:
+	case VT_UI4:
+	case VT_UINT:
+	case VT_I8:
+	case VT_UI8:
+		return (double)GetInt(variant, 0);
+	}
+	return default;
+}
+
 class JSObject
 {
 public:
@@ -80,6 +104,12 @@ public:
 		return GetInt(&prop, default);
 	}
 
+	double GetNumberProperty(const std::wstring& name, double default = 0) {
+		auto prop = GetProperty(name);
+		//Get property
+		return GetNumber(&prop, default);
+	}
+
 	bool GetBooleanProperty(const std::wstring& name, bool default = false) {
 		auto prop = GetProperty(name);
 		//Get property
@@ -0,0 +1,192 @@
+#include "JpegEncoder.hpp"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "libjpeg_turbo/jpeglib.h"
+#include "libjpeg_turbo/jerror.h"
+}
+
+namespace {
+
+// Rows in one iMCU for 4:2:0 sampling
+const int LumaRows = 16;
+const int ChromaRows = 8;
+
+struct ErrorManager
+{
+	jpeg_error_mgr pub;
+	jmp_buf jump;
+};
+
+void OnError(j_common_ptr cinfo)
+{
+	// Never let libjpeg exit the process
+	ErrorManager* err = (ErrorManager*)cinfo->err;
+	longjmp(err->jump, 1);
+}
+
+void OnOutputMessage(j_common_ptr)
+{
+}
+
+// Destination writing straight into the sink, reserving chunks as libjpeg fills them
+struct SinkDestination
+{
+	jpeg_destination_mgr pub;
+	ByteSink* sink;
+	size_t chunk;
+};
+
+void InitDestination(j_compress_ptr cinfo)
+{
+	SinkDestination* dest = (SinkDestination*)cinfo->dest;
+	dest->pub.next_output_byte = dest->sink->Reserve(dest->chunk);
+	dest->pub.free_in_buffer = dest->chunk;
+	if (!dest->pub.next_output_byte)
+		ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
+}
+
+boolean EmptyOutputBuffer(j_compress_ptr cinfo)
+{
+	// Called only when the whole chunk is full, ask for a bigger one
+	SinkDestination* dest = (SinkDestination*)cinfo->dest;
+	dest->sink->Commit(dest->chunk);
+	dest->chunk *= 2;
+	dest->pub.next_output_byte = dest->sink->Reserve(dest->chunk);
+	dest->pub.free_in_buffer = dest->chunk;
+	if (!dest->pub.next_output_byte)
+		ERREXIT(cinfo, JERR_OUT_OF_MEMORY);
+	return TRUE;
+}
+
+void TermDestination(j_compress_ptr cinfo)
+{
+	SinkDestination* dest = (SinkDestination*)cinfo->dest;
+	dest->sink->Commit(dest->chunk - dest->pub.free_in_buffer);
+}
+}
+
+bool JpegEncoder::Encode(
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	int quality,
+	ByteSink& out)
+{
+	if (width <= 0 || height <= 0)
+		return false;
+
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+
+	// libjpeg reads full DCT blocks, pad rows if the planes do not cover them
+	int paddedWidth = (width + LumaRows - 1) & ~(LumaRows - 1);
+	int paddedChromaWidth = paddedWidth / 2;
+	bool pad = paddedWidth != width;
+	if (pad)
+		padded.resize(paddedWidth * LumaRows + paddedChromaWidth * ChromaRows * 2);
+
+	jpeg_compress_struct cinfo;
+	ErrorManager err;
+	SinkDestination dest;
+
+	cinfo.err = jpeg_std_error(&err.pub);
+	err.pub.error_exit = OnError;
+	err.pub.output_message = OnOutputMessage;
+
+	if (setjmp(err.jump))
+	{
+		jpeg_destroy_compress(&cinfo);
+		return false;
+	}
+
+	jpeg_create_compress(&cinfo);
+
+	dest.pub.init_destination = InitDestination;
+	dest.pub.empty_output_buffer = EmptyOutputBuffer;
+	dest.pub.term_destination = TermDestination;
+	dest.sink = &out;
+	// Usually enough for the whole image at common qualities
+	dest.chunk = (size_t)width * height / 4 + 4096;
+	cinfo.dest = &dest.pub;
+
+	cinfo.image_width = width;
+	cinfo.image_height = height;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_YCbCr;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_colorspace(&cinfo, JCS_YCbCr);
+	jpeg_set_quality(&cinfo, quality, TRUE);
+
+	// 4:2:0, same as our planes
+	cinfo.raw_data_in = TRUE;
+	cinfo.dct_method = JDCT_ISLOW;
+	cinfo.comp_info[0].h_samp_factor = 2;
+	cinfo.comp_info[0].v_samp_factor = 2;
+	cinfo.comp_info[1].h_samp_factor = 1;
+	cinfo.comp_info[1].v_samp_factor = 1;
+	cinfo.comp_info[2].h_samp_factor = 1;
+	cinfo.comp_info[2].v_samp_factor = 1;
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	JSAMPROW rowsY[LumaRows];
+	JSAMPROW rowsU[ChromaRows];
+	JSAMPROW rowsV[ChromaRows];
+	JSAMPARRAY planes[3] = { rowsY, rowsU, rowsV };
+
+	uint8_t* paddedY = pad ? padded.data() : nullptr;
+	uint8_t* paddedU = pad ? paddedY + paddedWidth * LumaRows : nullptr;
+	uint8_t* paddedV = pad ? paddedU + paddedChromaWidth * ChromaRows : nullptr;
+
+	while (cinfo.next_scanline < cinfo.image_height)
+	{
+		int y = cinfo.next_scanline;
+
+		// Rows past the bottom repeat the last one
+		for (int i = 0; i < LumaRows; ++i)
+		{
+			int row = y + i < height ? y + i : height - 1;
+			const uint8_t* src = dataY + row * strideY;
+			if (pad)
+			{
+				uint8_t* dst = paddedY + i * paddedWidth;
+				memcpy(dst, src, width);
+				memset(dst + width, src[width - 1], paddedWidth - width);
+				src = dst;
+			}
+			rowsY[i] = (JSAMPROW)src;
+		}
+
+		for (int i = 0; i < ChromaRows; ++i)
+		{
+			int row = y / 2 + i < chromaHeight ? y / 2 + i : chromaHeight - 1;
+			const uint8_t* srcU = dataU + row * strideU;
+			const uint8_t* srcV = dataV + row * strideV;
+			if (pad)
+			{
+				uint8_t* dstU = paddedU + i * paddedChromaWidth;
+				uint8_t* dstV = paddedV + i * paddedChromaWidth;
+				memcpy(dstU, srcU, chromaWidth);
+				memset(dstU + chromaWidth, srcU[chromaWidth - 1], paddedChromaWidth - chromaWidth);
+				memcpy(dstV, srcV, chromaWidth);
+				memset(dstV + chromaWidth, srcV[chromaWidth - 1], paddedChromaWidth - chromaWidth);
+				srcU = dstU;
+				srcV = dstV;
+			}
+			rowsU[i] = (JSAMPROW)srcU;
+			rowsV[i] = (JSAMPROW)srcV;
+		}
+
+		jpeg_write_raw_data(&cinfo, planes, LumaRows);
+	}
+
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	return true;
+}
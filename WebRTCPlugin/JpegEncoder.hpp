@@ -0,0 +1,32 @@
+#ifndef JPEG_ENCODER_HPP
+#define JPEG_ENCODER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "ByteSink.hpp"
+
+// Encodes I420 images as JPEG feeding the planes straight into
+// libjpeg-turbo's raw data interface, skipping any RGB conversion.
+// Instances keep their scratch rows, so reuse them for consecutive frames.
+class JpegEncoder
+{
+public:
+	static const int DefaultQuality = 85;
+
+	bool Encode(
+		const uint8_t* dataY, int strideY,
+		const uint8_t* dataU, int strideU,
+		const uint8_t* dataV, int strideV,
+		int width, int height,
+		int quality,
+		ByteSink& out);
+
+private:
+	// Right padded copies of one iMCU row, used when width is not a multiple of 16
+	std::vector<uint8_t> padded;
+};
+
+#endif
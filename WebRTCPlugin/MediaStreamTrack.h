@@ -6,6 +6,7 @@
 #include "Callback.h"
 
 #include "api\media_stream_interface.h"
+#include "CapturerTrackSource.hpp"
 
 #if defined(_WIN32_WCE) && !defined(_CE_DCOM) && !defined(_CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA)
 #error "Single-threaded COM objects are not properly supported on Windows CE platform, such as the Windows Mobile platforms that do not include full DCOM support. Define _CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA to force ATL to support creating single-thread COM object's and allow use of it's single-threaded COM object implementations. The threading model in your rgs file was set to 'Free' as that is the only threading model supported in non DCOM Windows CE platforms."
@@ -105,6 +106,7 @@ public:
 	void FinalRelease()
 	{
 		track = nullptr;
+		source = nullptr;
 	}
 
 	void SetLabel(std::string label)
@@ -117,6 +119,12 @@ public:
 		this->track = track;
 	}
 
+	// Camera the track is captured from, only for local video tracks
+	void AttachSource(rtc::scoped_refptr<CapturerTrackView> &source)
+	{
+		this->source = source;
+	}
+
 	virtual rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> GetTrack() override
 	{
 		return track;
@@ -162,9 +170,28 @@ public:
 		return S_OK;
 	}
 
+	// Pans the crop over the capture when sinks want another aspect ratio, 0 to 1 on
+	// each axis. Only this track moves, others sharing the camera keep their own.
+	STDMETHOD(setCropOffset)(VARIANT x, VARIANT y)
+	{
+		if (!source)
+			return E_NOTIMPL;
+
+		CComVariant offsetX;
+		CComVariant offsetY;
+		if (FAILED(offsetX.ChangeType(VT_R8, &x)) || FAILED(offsetY.ChangeType(VT_R8, &y)))
+			return E_INVALIDARG;
+		if (V_R8(&offsetX) < 0 || V_R8(&offsetX) > 1 || V_R8(&offsetY) < 0 || V_R8(&offsetY) > 1)
+			return E_INVALIDARG;
+
+		source->SetCropOffset((float)V_R8(&offsetX), (float)V_R8(&offsetY));
+		return S_OK;
+	}
+
 private:
 	std::string label;
 	rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> track;
+	rtc::scoped_refptr<CapturerTrackView> source;
 };
 
 OBJECT_ENTRY_AUTO(__uuidof(MediaStreamTrack), MediaStreamTrack)
\ No newline at end of file
@@ -0,0 +1,246 @@
+#include "MosaicCompositor.hpp"
+
+#include <vector>
+
+#undef FOURCC
+#include "third_party/libyuv/include/libyuv.h"
+
+// Opaque black, for letterboxing and empty tiles
+static const uint32_t Background = 0xFF000000;
+
+void MosaicCompositor::SetSize(int width, int height)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (width < 0 || height < 0)
+		width = height = 0;
+
+	// Only reallocates when growing, contents are redrawn anyway
+	if ((int)backBuffer.width == width && (int)backBuffer.height == height)
+		return;
+
+	if (!backBuffer.Reserve(width, height))
+		backBuffer.Reserve(0, 0);
+	dirty = true;
+}
+
+void MosaicCompositor::SetRect(Tile& tile, const ImageRect& rect)
+{
+	tile.x = rect.x;
+	tile.y = rect.y;
+	tile.width = rect.width > 0 ? rect.width : 0;
+	tile.height = rect.height > 0 ? rect.height : 0;
+}
+
+int MosaicCompositor::AddTile(const ImageRect& rect)
+{
+	auto tile = std::make_shared<Tile>();
+	SetRect(*tile, rect);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	int id = nextId++;
+	tiles[id] = tile;
+	dirty = true;
+
+	return id;
+}
+
+bool MosaicCompositor::SetTileRect(int id, const ImageRect& rect)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = tiles.find(id);
+	if (it == tiles.end())
+		return false;
+
+	// Surface keeps its old size until next frame, it is cropped or letterboxed meanwhile
+	SetRect(*it->second, rect);
+	dirty = true;
+
+	return true;
+}
+
+bool MosaicCompositor::RemoveTile(int id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!tiles.erase(id))
+		return false;
+
+	// Its area has to be cleared
+	dirty = true;
+
+	return true;
+}
+
+bool MosaicCompositor::StoreFrame(
+	int id,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	int rotation,
+	ScaleFilter filter)
+{
+	// Tile stays alive while converting even if removed meanwhile
+	std::shared_ptr<Tile> tile;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = tiles.find(id);
+		if (it == tiles.end())
+			return false;
+		tile = it->second;
+	}
+
+	int tileWidth = tile->width;
+	int tileHeight = tile->height;
+	if (!tileWidth || !tileHeight || width <= 0 || height <= 0)
+		return false;
+
+	bool transposed = rotation == 90 || rotation == 270;
+	int frameWidth = transposed ? height : width;
+	int frameHeight = transposed ? width : height;
+
+	// Fit into the tile keeping the aspect ratio
+	int fitWidth = tileWidth;
+	int fitHeight = (int)((int64_t)frameHeight * tileWidth / frameWidth);
+	if (fitHeight > tileHeight)
+	{
+		fitHeight = tileHeight;
+		fitWidth = (int)((int64_t)frameWidth * tileHeight / frameHeight);
+	}
+
+	// Converted straight to the size it is shown at, up or down, so composing is a plain copy
+	RenderOptions options;
+	options.targetWidth = fitWidth > 0 ? fitWidth : 1;
+	options.targetHeight = fitHeight > 0 ? fitHeight : 1;
+	options.filter = filter;
+	options.rotation = rotation;
+	options.upscale = true;
+
+	return tile->store.Store(dataY, strideY, dataU, strideU, dataV, strideV, width, height, options, id);
+}
+
+void MosaicCompositor::Clear(int x, int y, int width, int height)
+{
+	int left = x > 0 ? x : 0;
+	int top = y > 0 ? y : 0;
+	int right = x + width < (int)backBuffer.width ? x + width : (int)backBuffer.width;
+	int bottom = y + height < (int)backBuffer.height ? y + height : (int)backBuffer.height;
+
+	if (right <= left || bottom <= top)
+		return;
+
+	libyuv::ARGBRect(backBuffer.image, backBuffer.stride, left, top, right - left, bottom - top, Background);
+}
+
+void MosaicCompositor::Draw(Tile& tile, const VideoBuffer& surface)
+{
+	int x = tile.x;
+	int y = tile.y;
+	int width = tile.width;
+	int height = tile.height;
+
+	// Centered on the tile, cropped if converted for a bigger one
+	int copyWidth = (int)surface.width < width ? (int)surface.width : width;
+	int copyHeight = (int)surface.height < height ? (int)surface.height : height;
+	int left = x + (width - copyWidth) / 2;
+	int top = y + (height - copyHeight) / 2;
+	int sourceX = ((int)surface.width - copyWidth) / 2;
+	int sourceY = ((int)surface.height - copyHeight) / 2;
+
+	// Letterbox around the picture
+	Clear(x, y, width, top - y);
+	Clear(x, top + copyHeight, width, y + height - top - copyHeight);
+	Clear(x, top, left - x, copyHeight);
+	Clear(left + copyWidth, top, x + width - left - copyWidth, copyHeight);
+
+	// Clip to the back buffer
+	if (left < 0)
+	{
+		sourceX -= left;
+		copyWidth += left;
+		left = 0;
+	}
+	if (top < 0)
+	{
+		sourceY -= top;
+		copyHeight += top;
+		top = 0;
+	}
+	if (left + copyWidth > (int)backBuffer.width)
+		copyWidth = (int)backBuffer.width - left;
+	if (top + copyHeight > (int)backBuffer.height)
+		copyHeight = (int)backBuffer.height - top;
+
+	if (copyWidth <= 0 || copyHeight <= 0)
+		return;
+
+	libyuv::ARGBCopy(
+		surface.image + sourceY * surface.stride + sourceX * 4,
+		surface.stride,
+		backBuffer.image + top * backBuffer.stride + left * 4,
+		backBuffer.stride,
+		copyWidth,
+		copyHeight);
+}
+
+bool MosaicCompositor::Compose()
+{
+	// Layout only changes on this thread, tiles are drawn without holding the lock
+	std::vector<std::shared_ptr<Tile>> current;
+	bool redraw;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		current.reserve(tiles.size());
+		for (auto& entry : tiles)
+			current.push_back(entry.second);
+		redraw = dirty;
+		dirty = false;
+	}
+
+	if (!backBuffer.width || !backBuffer.height)
+		return false;
+
+	if (redraw)
+		Clear(0, 0, backBuffer.width, backBuffer.height);
+
+	for (auto& tile : current)
+	{
+		// Untouched tiles are already in place
+		bool fresh = tile->store.HasNewFrame();
+		if (!fresh && !redraw)
+			continue;
+
+		tile->store.Read([&](const VideoFrameStore<int>::Frame& frame) {
+			Draw(*tile, frame.surface);
+		});
+
+		if (fresh)
+			composedFrames++;
+	}
+
+	return true;
+}
+
+bool MosaicCompositor::HasNewFrames()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (auto& entry : tiles)
+		if (entry.second->store.HasNewFrame())
+			return true;
+
+	return false;
+}
+
+uint64_t MosaicCompositor::GetOverwrittenFrames()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	uint64_t overwritten = 0;
+	for (auto& entry : tiles)
+		overwritten += entry.second->store.GetOverwrittenFrames();
+
+	return overwritten;
+}
@@ -0,0 +1,78 @@
+#ifndef MOSAIC_COMPOSITOR_HPP
+#define MOSAIC_COMPOSITOR_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "VideoFrameStore.hpp"
+
+// Composes several video tiles into a single ARGB back buffer.
+// Each tile converts its frames on arrival, already scaled to fit its
+// rectangle, so composing only copies the tiles that changed into place
+// and the whole mosaic is painted with a single blit.
+class MosaicCompositor
+{
+public:
+	// Called from the UI thread, back buffer size in pixels
+	void SetSize(int width, int height);
+
+	// Called from the UI thread, tiles are identified by the returned id
+	int AddTile(const ImageRect& rect);
+	bool SetTileRect(int id, const ImageRect& rect);
+	bool RemoveTile(int id);
+
+	// Called from the tile frame delivery thread, only one per tile. Rotation is clockwise in degrees.
+	bool StoreFrame(
+		int id,
+		const uint8_t* dataY, int strideY,
+		const uint8_t* dataU, int strideU,
+		const uint8_t* dataV, int strideV,
+		int width, int height,
+		int rotation,
+		ScaleFilter filter);
+
+	// Called from the UI thread, copies new tile frames into the back buffer.
+	// Returns false while there is nothing to show.
+	bool Compose();
+
+	// Valid until next Compose or SetSize call
+	const VideoBuffer& GetBackBuffer() const { return backBuffer; }
+
+	// Whether a tile has a frame waiting to be composed
+	bool HasNewFrames();
+
+	uint64_t GetComposedFrames() const { return composedFrames; }
+	uint64_t GetOverwrittenFrames();
+
+private:
+	struct Tile
+	{
+		// Written by the UI thread, read by the delivery one
+		std::atomic<int> x{ 0 };
+		std::atomic<int> y{ 0 };
+		std::atomic<int> width{ 0 };
+		std::atomic<int> height{ 0 };
+		VideoFrameStore<int> store;
+	};
+
+	void SetRect(Tile& tile, const ImageRect& rect);
+	// Copy the stored surface centered on its rectangle, clearing the uncovered area
+	void Draw(Tile& tile, const VideoBuffer& surface);
+	// Fill a rectangle of the back buffer with black, clipped to it
+	void Clear(int x, int y, int width, int height);
+
+	std::mutex mutex;
+	std::map<int, std::shared_ptr<Tile>> tiles;
+	int nextId = 1;
+	// Whole buffer has to be redrawn
+	bool dirty = true;
+
+	VideoBuffer backBuffer;
+	std::atomic<uint64_t> composedFrames{ 0 };
+};
+
+#endif
@@ -0,0 +1,257 @@
+// MosaicRenderer.cpp : Implementation of MosaicRenderer
+#include "stdafx.h"
+#include "LogSinkImpl.h"
+#include "MosaicRenderer.h"
+#include "JSObject.h"
+
+// Frames a hidden tile still gets, so resuming starts from a recent one
+static const int HiddenFramerate = 1;
+
+void MosaicTileSink::OnFrame(const webrtc::VideoFrame& frame)
+{
+	renderer->OnTileFrame(id, frame);
+}
+
+void MosaicTileSink::UpdateWants(int pixelCount, bool hidden)
+{
+	// Nothing changed
+	if (pixelCount == wantedPixelCount && hidden == wantedHidden)
+		return;
+
+	wantedPixelCount = pixelCount;
+	wantedHidden = hidden;
+
+	rtc::VideoSinkWants wanted;
+	wanted.rotation_applied = true;
+	// No more pixels than the tile shows
+	wanted.max_pixel_count = pixelCount;
+	// Hidden frames are dropped on arrival, no point in the source making them
+	if (hidden)
+		wanted.max_framerate_fps = HiddenFramerate;
+
+	track->AddOrUpdateSink(this, wanted);
+}
+
+void MosaicTileSink::Stop()
+{
+	track->RemoveSink(this);
+}
+
+HRESULT MosaicRenderer::OnDrawAdvanced(ATL_DRAWINFO& di)
+{
+	FUNC_BEGIN();
+
+	RECT* rc = (RECT*)di.prcBounds;
+	HDC hdc = di.hdcDraw;
+
+	// Back buffer follows the element size
+	compositor.SetSize(rc->right - rc->left, rc->bottom - rc->top);
+
+	// Copy tiles with new frames into place
+	if (compositor.Compose())
+	{
+		// Whole mosaic in one go, already at display size
+		const VideoBuffer& buffer = compositor.GetBackBuffer();
+
+		BITMAPINFO info = { 0 };
+		info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		info.bmiHeader.biWidth = buffer.width;
+		info.bmiHeader.biHeight = -(LONG)buffer.height;
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+
+		SetDIBitsToDevice(
+			hdc,
+			rc->left,
+			rc->top,
+			buffer.width,
+			buffer.height,
+			0,
+			0,
+			0,
+			buffer.height,
+			buffer.image,
+			&info,
+			DIB_RGB_COLORS
+		);
+	}
+	else
+	{
+		// Nothing to show yet
+		HBRUSH hBrush = CreateSolidBrush(RGB(0, 0, 0));
+		FillRect(hdc, rc, hBrush);
+		DeleteObject(hBrush);
+	}
+
+	// Allow next invalidation, issuing it now if a frame arrived while painting
+	paintPending = false;
+	if (compositor.HasNewFrames())
+		Invalidate();
+
+	FUNC_END_RET_S(S_OK);
+}
+
+void MosaicRenderer::OnTileFrame(int id, const webrtc::VideoFrame& frame)
+{
+	FUNC_BEGIN();
+
+	framesReceived++;
+
+	// Nobody is looking, last composed frames are kept for resuming
+	if (!active || clipped)
+	{
+		FUNC_END();
+		return;
+	}
+
+	// Converted on arrival at the size it is shown on its tile
+	auto yuv = frame.video_frame_buffer()->ToI420();
+	if (compositor.StoreFrame(
+		id,
+		yuv->DataY(),
+		yuv->StrideY(),
+		yuv->DataU(),
+		yuv->StrideU(),
+		yuv->DataV(),
+		yuv->StrideV(),
+		yuv->width(),
+		yuv->height(),
+		frame.rotation(),
+		ScaleFilter::Box))
+	{
+		// All tiles share a single paint
+		Invalidate();
+	}
+
+	FUNC_END();
+}
+
+void MosaicRenderer::Invalidate()
+{
+	// Not in place active yet, first paint will pick up the latest frames
+	if (!hwndParent)
+		return;
+
+	// Previous paint has not happened yet, it will pick up the latest frames
+	if (paintPending.exchange(true))
+		return;
+
+	RECT rect;
+	{
+		std::lock_guard<std::mutex> lock(rectMutex);
+		rect = controlRect;
+	}
+
+	// Only our own area, once we know it
+	::InvalidateRect(hwndParent, ::IsRectEmpty(&rect) ? NULL : &rect, FALSE);
+}
+
+void MosaicRenderer::UpdateSinkWants()
+{
+	bool hidden = !active || clipped;
+
+	for (auto& entry : sinks)
+	{
+		const ImageRect& rect = rects[entry.first];
+		entry.second->UpdateWants(rect.width * rect.height, hidden);
+	}
+}
+
+bool MosaicRenderer::ParseRect(VARIANT& variant, ImageRect& rect)
+{
+	JSObject obj(variant);
+	if (obj.isNull())
+		return false;
+
+	rect.x = (int)obj.GetNumberProperty(L"x");
+	rect.y = (int)obj.GetNumberProperty(L"y");
+	rect.width = (int)obj.GetNumberProperty(L"width");
+	rect.height = (int)obj.GetNumberProperty(L"height");
+
+	return rect.width >= 0 && rect.height >= 0;
+}
+
+STDMETHODIMP MosaicRenderer::addTrack(VARIANT track, VARIANT rect, LONG* id)
+{
+	FUNC_BEGIN();
+
+	if (!id)
+		FUNC_END_RET_S(E_POINTER);
+
+	//Get dispatch interface
+	if (track.vt != VT_DISPATCH)
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	IDispatch* disp = V_DISPATCH(&track);
+	if (!disp)
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	ImageRect tileRect;
+	if (!ParseRect(rect, tileRect))
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	//Get atl com object from track.
+	CComPtr<ITrackAccess> proxy;
+	HRESULT hr = disp->QueryInterface(IID_PPV_ARGS(&proxy));
+	if (FAILED(hr))
+		FUNC_END_RET_S(hr);
+
+	//Convert to video
+	webrtc::VideoTrackInterface* videoTrack = reinterpret_cast<webrtc::VideoTrackInterface*>(proxy->GetTrack().get());
+	if (!videoTrack)
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	//Tile must exist before the first frame arrives
+	int tile = compositor.AddTile(tileRect);
+	rects[tile] = tileRect;
+	sinks[tile].reset(new MosaicTileSink(this, tile, videoTrack));
+
+	//Add it as video sink
+	UpdateSinkWants();
+	Invalidate();
+
+	*id = tile;
+
+	FUNC_END_RET_S(S_OK);
+}
+
+STDMETHODIMP MosaicRenderer::setTileRect(LONG id, VARIANT rect)
+{
+	FUNC_BEGIN();
+
+	ImageRect tileRect;
+	if (!ParseRect(rect, tileRect))
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	if (!compositor.SetTileRect(id, tileRect))
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	rects[id] = tileRect;
+
+	//Get frames sized for the new layout
+	UpdateSinkWants();
+	Invalidate();
+
+	FUNC_END_RET_S(S_OK);
+}
+
+STDMETHODIMP MosaicRenderer::removeTrack(LONG id)
+{
+	FUNC_BEGIN();
+
+	auto it = sinks.find(id);
+	if (it == sinks.end())
+		FUNC_END_RET_S(E_INVALIDARG);
+
+	//Stop frames before removing its tile
+	it->second->Stop();
+	sinks.erase(it);
+	rects.erase(id);
+	compositor.RemoveTile(id);
+
+	//Clear its area
+	Invalidate();
+
+	FUNC_END_RET_S(S_OK);
+}
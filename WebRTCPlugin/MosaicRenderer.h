@@ -0,0 +1,218 @@
+// MosaicRenderer.h : Declaration of the MosaicRenderer
+#pragma once
+#include "resource.h"       // main symbols
+#include <atlctl.h>
+#include "WebRTCPlugin_i.h"
+#include "MediaStreamTrack.h"
+#include "MosaicCompositor.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "api/video/video_frame.h"
+#include "api/video/video_sink_interface.h"
+
+
+#if defined(_WIN32_WCE) && !defined(_CE_DCOM) && !defined(_CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA)
+#error "Single-threaded COM objects are not properly supported on Windows CE platform, such as the Windows Mobile platforms that do not include full DCOM support. Define _CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA to force ATL to support creating single-thread COM object's and allow use of it's single-threaded COM object implementations. The threading model in your rgs file was set to 'Free' as that is the only threading model supported in non DCOM Windows CE platforms."
+#endif
+
+using namespace ATL;
+
+class MosaicRenderer;
+
+// Feeds the frames of one track into its mosaic tile
+class MosaicTileSink : public rtc::VideoSinkInterface<webrtc::VideoFrame>
+{
+public:
+	MosaicTileSink(MosaicRenderer* renderer, int id, webrtc::VideoTrackInterface* track) :
+		renderer(renderer),
+		id(id),
+		track(track)
+	{
+	}
+
+	virtual void OnFrame(const webrtc::VideoFrame& frame) override;
+
+	// Ask the source for no more pixels than the tile shows, barely any frames if hidden
+	void UpdateWants(int pixelCount, bool hidden);
+	// No frames are delivered once it returns
+	void Stop();
+
+private:
+	MosaicRenderer* renderer;
+	int id;
+	rtc::scoped_refptr<webrtc::VideoTrackInterface> track;
+	int wantedPixelCount = -1;
+	bool wantedHidden = false;
+};
+
+// MosaicRenderer
+// Shows several tracks on a single control, each one on its own tile.
+// Frames are converted on arrival at their tile size and composed on one
+// back buffer, painted with a single blit per refresh.
+class ATL_NO_VTABLE MosaicRenderer :
+	public CComObjectRootEx<CComSingleThreadModel>,
+	public IDispatchImpl<IMosaicRenderer, &IID_IMosaicRenderer, &LIBID_WebRTCPluginLib, /*wMajor =*/ 1, /*wMinor =*/ 0>,
+	public IOleControlImpl<MosaicRenderer>,
+	public IOleObjectImpl<MosaicRenderer>,
+	public IOleInPlaceActiveObjectImpl<MosaicRenderer>,
+	public IViewObjectExImpl<MosaicRenderer>,
+	public IOleInPlaceObjectWindowlessImpl<MosaicRenderer>,
+	public IObjectSafetyImpl<MosaicRenderer, INTERFACESAFE_FOR_UNTRUSTED_CALLER>,
+	public CComCoClass<MosaicRenderer, &CLSID_MosaicRenderer>,
+	public CComControl<MosaicRenderer>
+{
+public:
+
+	MosaicRenderer()
+	{
+	}
+
+	DECLARE_OLEMISC_STATUS(
+		OLEMISC_RECOMPOSEONRESIZE |
+		OLEMISC_CANTLINKINSIDE |
+		OLEMISC_INSIDEOUT |
+		OLEMISC_ACTIVATEWHENVISIBLE |
+		OLEMISC_SETCLIENTSITEFIRST
+		)
+
+	DECLARE_REGISTRY_RESOURCEID(IDR_MOSAICRENDERER)
+
+	DECLARE_NOT_AGGREGATABLE(MosaicRenderer)
+
+	BEGIN_COM_MAP(MosaicRenderer)
+		COM_INTERFACE_ENTRY(IMosaicRenderer)
+		COM_INTERFACE_ENTRY(IDispatch)
+		COM_INTERFACE_ENTRY(IViewObjectEx)
+		COM_INTERFACE_ENTRY(IViewObject2)
+		COM_INTERFACE_ENTRY(IViewObject)
+		COM_INTERFACE_ENTRY(IOleInPlaceObjectWindowless)
+		COM_INTERFACE_ENTRY(IOleInPlaceObject)
+		COM_INTERFACE_ENTRY2(IOleWindow, IOleInPlaceObjectWindowless)
+		COM_INTERFACE_ENTRY(IOleInPlaceActiveObject)
+		COM_INTERFACE_ENTRY(IOleControl)
+		COM_INTERFACE_ENTRY(IOleObject)
+		COM_INTERFACE_ENTRY_IID(IID_IObjectSafety, IObjectSafety)
+	END_COM_MAP()
+
+	BEGIN_PROP_MAP(MosaicRenderer)
+		PROP_DATA_ENTRY("_cx", m_sizeExtent.cx, VT_UI4)
+		PROP_DATA_ENTRY("_cy", m_sizeExtent.cy, VT_UI4)
+	END_PROP_MAP()
+
+	BEGIN_MSG_MAP(MosaicRenderer)
+		CHAIN_MSG_MAP(CComControl<MosaicRenderer>)
+		DEFAULT_REFLECTION_HANDLER()
+	END_MSG_MAP()
+
+	// IViewObjectEx
+	DECLARE_VIEW_STATUS(0)
+
+	// IMosaicRenderer
+public:
+
+	HRESULT OnDrawAdvanced(ATL_DRAWINFO& di);
+
+	DECLARE_PROTECT_FINAL_CONSTRUCT()
+
+	HRESULT OnPostVerbInPlaceActivate()
+	{
+		HRESULT hr = m_spInPlaceSite->GetWindow(&hwndParent);
+
+		// Back on the page, show the last frames right away
+		active = true;
+		UpdateSinkWants();
+		Invalidate();
+
+		return hr;
+	}
+
+	HRESULT IOleInPlaceObject_InPlaceDeactivate()
+	{
+		// Not shown until activated again
+		active = false;
+		UpdateSinkWants();
+
+		return CComControl<MosaicRenderer>::IOleInPlaceObject_InPlaceDeactivate();
+	}
+
+	void FinalRelease()
+	{
+		// Stop receiving frames
+		for (auto& entry : sinks)
+			entry.second->Stop();
+		sinks.clear();
+	}
+
+	HRESULT IOleInPlaceObject_SetObjectRects(LPCRECT prcPos, LPCRECT prcClip)
+	{
+		HRESULT hr = CComControl<MosaicRenderer>::IOleInPlaceObject_SetObjectRects(prcPos, prcClip);
+
+		// Scrolled out of the view
+		RECT visible;
+		bool wasClipped = clipped.exchange(!::IntersectRect(&visible, prcPos, prcClip));
+		if (wasClipped && !clipped)
+			Invalidate();
+
+		// Full rate only while in view
+		if (wasClipped != clipped)
+			UpdateSinkWants();
+
+		// Area to invalidate on new frames
+		std::lock_guard<std::mutex> lock(rectMutex);
+		controlRect = *prcPos;
+
+		return hr;
+	}
+
+	STDMETHOD(addTrack)(VARIANT track, VARIANT rect, LONG* id);
+	STDMETHOD(setTileRect)(LONG id, VARIANT rect);
+	STDMETHOD(removeTrack)(LONG id);
+	STDMETHOD(get_framesReceived)(LONG* pVal)
+	{
+		*pVal = (LONG)framesReceived;
+		return S_OK;
+	}
+	STDMETHOD(get_framesPainted)(LONG* pVal)
+	{
+		*pVal = (LONG)compositor.GetComposedFrames();
+		return S_OK;
+	}
+	STDMETHOD(get_framesSkipped)(LONG* pVal)
+	{
+		// Converted but replaced before being composed
+		*pVal = (LONG)compositor.GetOverwrittenFrames();
+		return S_OK;
+	}
+
+	// Called from each tile frame delivery thread
+	void OnTileFrame(int id, const webrtc::VideoFrame& frame);
+
+private:
+	void UpdateSinkWants();
+	void Invalidate();
+	bool ParseRect(VARIANT& variant, ImageRect& rect);
+
+private:
+	MosaicCompositor compositor;
+
+	// Tiles by id, only touched from the UI thread
+	std::map<int, std::unique_ptr<MosaicTileSink>> sinks;
+	std::map<int, ImageRect> rects;
+
+	std::atomic<bool> paintPending{ false };
+	std::mutex rectMutex;
+	RECT controlRect = { 0 };
+
+	// Visibility, frames are dropped on arrival while hidden
+	std::atomic<bool> active{ true };
+	std::atomic<bool> clipped{ false };
+
+	std::atomic<uint64_t> framesReceived{ 0 };
+
+	HWND hwndParent = NULL;
+};
+
+OBJECT_ENTRY_AUTO(__uuidof(MosaicRenderer), MosaicRenderer)
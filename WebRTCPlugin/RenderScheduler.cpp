@@ -0,0 +1,149 @@
+#include "RenderScheduler.hpp"
+
+#include <algorithm>
+
+const int64_t LatencyHistogram::BoundsUs[LatencyHistogram::Buckets - 1] = {
+	2000, 5000, 10000, 20000, 50000, 100000, 200000
+};
+
+// Recent frames the jitter is measured on, a few seconds of video
+static const size_t TransitWindow = 128;
+
+// Share of recent frames that must arrive in time, in percent
+static const size_t OnTimePercent = 95;
+
+// Delay drops by this fraction of the excess on each frame, so it does not follow short calm spells
+static const int64_t DelayDecay = 32;
+
+// Transit jumps bigger than this are a new source timeline, not jitter
+static const int64_t DiscontinuityUs = 5000000;
+
+// Frames in a row behind the maximum latency that mean the path got slower for good
+static const int StepFrames = 10;
+
+void LatencyHistogram::Add(int64_t us)
+{
+	size_t bucket = 0;
+	while (bucket < Buckets - 1 && us > BoundsUs[bucket])
+		bucket++;
+
+	counts[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset()
+{
+	for (size_t i = 0; i < Buckets; ++i)
+		counts[i].store(0, std::memory_order_relaxed);
+}
+
+std::vector<uint64_t> LatencyHistogram::GetCounts() const
+{
+	std::vector<uint64_t> out(Buckets);
+	for (size_t i = 0; i < Buckets; ++i)
+		out[i] = counts[i].load(std::memory_order_relaxed);
+	return out;
+}
+
+RenderTiming::RenderTiming()
+{
+	transits.reserve(TransitWindow);
+}
+
+void RenderTiming::SetMaxLatency(int64_t us)
+{
+	maxLatencyUs = us > 0 ? us : 0;
+	if (delayUs > maxLatencyUs)
+		delayUs = maxLatencyUs;
+}
+
+void RenderTiming::Reset()
+{
+	transits.clear();
+	next = 0;
+	delayUs = 0;
+	releasedUs = INT64_MIN;
+	behind = 0;
+}
+
+int64_t RenderTiming::GetJitter(int64_t baseUs) const
+{
+	std::vector<int64_t> sorted(transits);
+	size_t index = (sorted.size() - 1) * OnTimePercent / 100;
+	std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+	return sorted[index] - baseUs;
+}
+
+int64_t RenderTiming::Schedule(int64_t timestampUs, int64_t nowUs)
+{
+	// Source and local clocks have unrelated origins, only transit changes matter
+	int64_t transit = nowUs - timestampUs;
+
+	if (!transits.empty())
+	{
+		int64_t base = *std::min_element(transits.begin(), transits.end());
+		if (transit - base > DiscontinuityUs || base - transit > DiscontinuityUs)
+			Reset();
+	}
+
+	// Older than a frame already shown
+	if (timestampUs <= releasedUs)
+		return -1;
+
+	if (transits.size() < TransitWindow)
+		transits.push_back(transit);
+	else
+		transits[next] = transit;
+	next = (next + 1) % TransitWindow;
+
+	int64_t base = *std::min_element(transits.begin(), transits.end());
+
+	// More behind the fastest path than the latency allowed, dropped before anybody converts it.
+	// Only a lasting step in transit keeps doing it, then forget the faster frames so this
+	// one becomes the base instead of freezing until the old fastest frame leaves the window.
+	if (transit - base > maxLatencyUs)
+	{
+		if (++behind < StepFrames)
+			return -1;
+
+		// Oldest first, so the window keeps rolling in order
+		if (transits.size() == TransitWindow)
+			std::rotate(transits.begin(), transits.begin() + next, transits.end());
+
+		int64_t lowest = transit - maxLatencyUs;
+		transits.erase(std::remove_if(transits.begin(), transits.end(), [lowest](int64_t value) {
+			return value < lowest;
+		}), transits.end());
+		next = transits.size() % TransitWindow;
+
+		base = *std::min_element(transits.begin(), transits.end());
+	}
+	behind = 0;
+
+	// Follow jitter increases at once, decreases slowly
+	int64_t target = std::min(GetJitter(base), maxLatencyUs);
+	int64_t delay = delayUs;
+	if (target > delay)
+		delay = target;
+	else
+		delay -= (delay - target + DelayDecay - 1) / DelayDecay;
+	delayUs = delay;
+
+	int64_t renderUs = timestampUs + base + delay;
+
+	if (nowUs > renderUs)
+	{
+		late.Add(nowUs - renderUs);
+
+		// Show it as soon as possible
+		return nowUs;
+	}
+
+	early.Add(renderUs - nowUs);
+
+	return renderUs;
+}
+
+void RenderTiming::OnReleased(int64_t timestampUs)
+{
+	releasedUs = timestampUs;
+}
@@ -0,0 +1,235 @@
+#ifndef RENDER_SCHEDULER_HPP
+#define RENDER_SCHEDULER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts of durations in fixed buckets, safe to read while being filled
+class LatencyHistogram
+{
+public:
+	// Upper bounds of every bucket but the last one, which is open ended
+	static const size_t Buckets = 8;
+	static const int64_t BoundsUs[Buckets - 1];
+
+	LatencyHistogram() { Reset(); }
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	void Add(int64_t us);
+	void Reset();
+	std::vector<uint64_t> GetCounts() const;
+
+private:
+	std::atomic<uint64_t> counts[Buckets];
+};
+
+// Decides when frames should be shown so they keep the pace they were captured at.
+// Transit times of recent frames give the fastest path from the source, render
+// time adds a delay over it that covers most of the observed jitter, growing at
+// once and shrinking slowly, never over the maximum latency. Frames further behind
+// the fastest path than that are dropped, unless they keep coming and move the base.
+// Not thread safe.
+class RenderTiming
+{
+public:
+	static const int64_t DefaultMaxLatencyUs = 150000;
+
+	RenderTiming();
+
+	void SetMaxLatency(int64_t us);
+	int64_t GetMaxLatency() const { return maxLatencyUs; }
+
+	// Render time on the local clock for a frame arriving now, -1 if it is too late to be shown
+	int64_t Schedule(int64_t timestampUs, int64_t nowUs);
+
+	// Frame released for rendering, older ones arriving afterwards are dropped
+	void OnReleased(int64_t timestampUs);
+
+	// Forget the source timing, for discontinuities or restarts
+	void Reset();
+
+	int64_t GetDelay() const { return delayUs; }
+
+	// How late frames arrived after their render time, and how long early ones waited for it
+	const LatencyHistogram& GetLateHistogram() const { return late; }
+	const LatencyHistogram& GetEarlyHistogram() const { return early; }
+
+private:
+	// Transit time under which the given share of recent frames arrived
+	int64_t GetJitter(int64_t baseUs) const;
+
+	std::vector<int64_t> transits;
+	size_t next = 0;
+	std::atomic<int64_t> delayUs{ 0 };
+	int64_t maxLatencyUs = DefaultMaxLatencyUs;
+	int64_t releasedUs = INT64_MIN;
+	// Frames in a row over the maximum latency
+	int behind = 0;
+
+	LatencyHistogram late;
+	LatencyHistogram early;
+};
+
+// Holds frames until their render time and hands them, in timestamp order, to
+// the release function on its own timer thread. When several frames are due at
+// once only the newest one is released, the others are dropped before anybody
+// converts them. The thread is started with the first queued frame.
+template<typename T>
+class RenderScheduler
+{
+public:
+	typedef std::function<void(T&)> ReleaseFunction;
+
+	explicit RenderScheduler(ReleaseFunction release) : release(release)
+	{
+	}
+
+	~RenderScheduler()
+	{
+		Stop();
+	}
+
+	RenderScheduler(const RenderScheduler&) = delete;
+	RenderScheduler& operator=(const RenderScheduler&) = delete;
+
+	// Queue a frame, returns false if it was dropped for being too late. Frames with
+	// no capture time, zero, are timed by their arrival.
+	bool Push(int64_t timestampUs, const T& item)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		int64_t now = Now();
+		if (!timestampUs)
+			timestampUs = now;
+
+		int64_t renderUs = timing.Schedule(timestampUs, now);
+		if (renderUs < 0)
+		{
+			dropped++;
+			return false;
+		}
+
+		// Same timestamp twice, keep the latest
+		Entry& entry = pending[timestampUs];
+		entry.renderUs = renderUs;
+		entry.item = item;
+
+		if (!thread.joinable())
+		{
+			running = true;
+			thread = std::thread(&RenderScheduler::Run, this);
+		}
+
+		cond.notify_one();
+
+		return true;
+	}
+
+	// Drop pending frames and join the thread, pushing again restarts it
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			running = false;
+			cond.notify_one();
+		}
+
+		if (thread.joinable())
+			thread.join();
+
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.clear();
+		timing.Reset();
+	}
+
+	void SetMaxLatency(int64_t us)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		timing.SetMaxLatency(us);
+	}
+
+	int64_t GetMaxLatency()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return timing.GetMaxLatency();
+	}
+
+	int64_t GetDelay() const { return timing.GetDelay(); }
+	uint64_t GetDropped() const { return dropped; }
+	std::vector<uint64_t> GetLateCounts() const { return timing.GetLateHistogram().GetCounts(); }
+	std::vector<uint64_t> GetEarlyCounts() const { return timing.GetEarlyHistogram().GetCounts(); }
+
+private:
+	struct Entry
+	{
+		int64_t renderUs = 0;
+		T item;
+	};
+
+	static int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (running)
+		{
+			if (pending.empty())
+			{
+				cond.wait(lock);
+				continue;
+			}
+
+			// Sleep until the oldest one is due, or something new is queued
+			int64_t now = Now();
+			auto first = pending.begin();
+			if (first->second.renderUs > now)
+			{
+				cond.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::microseconds(first->second.renderUs)));
+				continue;
+			}
+
+			// Newest due frame wins, older ones would only be replaced before being seen
+			auto last = first;
+			for (auto it = std::next(first); it != pending.end() && it->second.renderUs <= now; ++it)
+			{
+				last = it;
+				dropped++;
+			}
+
+			T item = last->second.item;
+			timing.OnReleased(last->first);
+			pending.erase(first, std::next(last));
+
+			// Render without blocking the delivery thread
+			lock.unlock();
+			release(item);
+			lock.lock();
+		}
+	}
+
+	ReleaseFunction release;
+	RenderTiming timing;
+	std::map<int64_t, Entry> pending;
+	std::atomic<uint64_t> dropped{ 0 };
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::thread thread;
+	bool running = false;
+};
+
+#endif
@@ -0,0 +1,530 @@
+#include "stdafx.h"
+#include "LogSinkImpl.h"
+#include "SnapshotEncoder.h"
+#include "VideoFrameStore.hpp"
+#include "Base64.hpp"
+#include "FrameQuality.hpp"
+
+#include <map>
+#include <mutex>
+
+#undef FOURCC
+#include "third_party/libyuv/include/libyuv.h"
+
+//////////////////////////////////////////////////////////////////////////
+
+// Encode straight into the BSTR handed to javascript, no intermediate string
+static HRESULT ToBase64(const uint8_t* data, size_t size, _bstr_t& base64)
+{
+	BSTR encoded = SysAllocStringLen(nullptr, (UINT)Base64EncodedLength(size));
+	if (!encoded)
+		return E_OUTOFMEMORY;
+
+	Base64Encode(data, size, encoded);
+	base64.Attach(encoded);
+
+	return S_OK;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static bool GetEncoderClsid(std::wstring format, CLSID* pClsid)
+{
+	// Encoders are only enumerated once per format
+	static std::mutex cacheMutex;
+	static std::map<std::wstring, CLSID> cache;
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	auto it = cache.find(format);
+	if (it != cache.end())
+	{
+		*pClsid = it->second;
+		return true;
+	}
+
+	UINT num = 0;          // number of image encoders
+	UINT size = 0;         // size of the image encoder array in bytes
+
+	Gdiplus::ImageCodecInfo* pImageCodecInfo = NULL;
+
+	Gdiplus::GetImageEncodersSize(&num, &size);
+	if (size == 0)
+		return false;
+
+	pImageCodecInfo = (Gdiplus::ImageCodecInfo*)(malloc(size));
+	if (pImageCodecInfo == NULL)
+		return false;
+
+	GetImageEncoders(num, size, pImageCodecInfo);
+	
+	for (UINT j = 0; j < num; ++j)
+	{
+		if (_wcsicmp(pImageCodecInfo[j].MimeType, format.c_str()) == 0)
+		{
+			*pClsid = pImageCodecInfo[j].Clsid;
+			cache[format] = *pClsid;
+			free(pImageCodecInfo);
+			return true;
+		}
+	}
+
+	free(pImageCodecInfo);
+	return false;
+}
+
+static HRESULT EncodeJpeg(
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	webrtc::VideoRotation rotation, int quality, ByteSink& sink)
+{
+	// Rotate upright in I420, still no rgb conversion needed
+	YUVBuffer rotated;
+	if (rotation != webrtc::kVideoRotation_0)
+	{
+		bool transposed = rotation == webrtc::kVideoRotation_90 || rotation == webrtc::kVideoRotation_270;
+		int rotatedWidth = transposed ? height : width;
+		int rotatedHeight = transposed ? width : height;
+
+		if (!rotated.Reserve(rotatedWidth, rotatedHeight))
+			return E_OUTOFMEMORY;
+
+		libyuv::I420Rotate(
+			dataY,
+			strideY,
+			dataU,
+			strideU,
+			dataV,
+			strideV,
+			rotated.DataY(),
+			rotated.strideY,
+			rotated.DataU(),
+			rotated.strideUV,
+			rotated.DataV(),
+			rotated.strideUV,
+			width,
+			height,
+			(libyuv::RotationMode)rotation);
+
+		dataY = rotated.DataY();
+		dataU = rotated.DataU();
+		dataV = rotated.DataV();
+		strideY = rotated.strideY;
+		strideU = strideV = rotated.strideUV;
+		width = rotatedWidth;
+		height = rotatedHeight;
+	}
+
+	if (quality < 1 || quality > 100)
+		quality = JpegEncoder::DefaultQuality;
+
+	JpegEncoder encoder;
+	if (!encoder.Encode(dataY, strideY, dataU, strideU, dataV, strideV, width, height, quality, sink))
+	{
+		RTC_LOG(LS_INFO) << "failed to encode jpeg snapshot";
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+HRESULT EncodeSnapshot(const webrtc::I420BufferInterface& yuv, webrtc::VideoRotation rotation, const SnapshotOptions& options, ByteSink& sink)
+{
+	FUNC_BEGIN();
+
+	HRESULT hr = S_OK;
+
+	const uint8_t* dataY = yuv.DataY();
+	const uint8_t* dataU = yuv.DataU();
+	const uint8_t* dataV = yuv.DataV();
+	int strideY = yuv.StrideY();
+	int strideU = yuv.StrideU();
+	int strideV = yuv.StrideV();
+	int frameWidth = yuv.width();
+	int frameHeight = yuv.height();
+
+	// Crop and scale in I420 first, so everything after only sees output pixels
+	YUVBuffer region;
+	if (options.region.width > 0 || options.width > 0 || options.height > 0)
+	{
+		bool transposed = rotation == webrtc::kVideoRotation_90 || rotation == webrtc::kVideoRotation_270;
+
+		// Region and output size are given on the upright image
+		ImageRect rect;
+		if (options.region.width > 0 && options.region.height > 0)
+			rect = UnrotateRect(options.region, frameWidth, frameHeight, rotation);
+		else
+		{
+			rect.width = frameWidth;
+			rect.height = frameHeight;
+		}
+
+		// Missing output dimensions keep the region aspect ratio
+		int outWidth = transposed ? options.height : options.width;
+		int outHeight = transposed ? options.width : options.height;
+		if (outWidth <= 0 && outHeight <= 0)
+		{
+			outWidth = rect.width;
+			outHeight = rect.height;
+		}
+		else if (outWidth <= 0)
+			outWidth = (int)((int64_t)outHeight * rect.width / rect.height);
+		else if (outHeight <= 0)
+			outHeight = (int)((int64_t)outWidth * rect.height / rect.width);
+
+		if (!CropAndScaleI420(region,
+				dataY, strideY, dataU, strideU, dataV, strideV,
+				frameWidth, frameHeight,
+				rect, outWidth, outHeight, ScaleFilter::Box))
+		{
+			RTC_LOG(LS_INFO) << "invalid snapshot region";
+			FUNC_END_RET_S(E_INVALIDARG);
+		}
+
+		dataY = region.DataY();
+		dataU = region.DataU();
+		dataV = region.DataV();
+		strideY = region.strideY;
+		strideU = strideV = region.strideUV;
+		frameWidth = region.width;
+		frameHeight = region.height;
+	}
+
+	// JPEG is encoded from the yuv planes directly
+	if (_wcsicmp(options.mimeType.c_str(), L"image/jpeg") == 0)
+	{
+		hr = EncodeJpeg(dataY, strideY, dataU, strideU, dataV, strideV,
+			frameWidth, frameHeight, rotation, options.quality, sink);
+		FUNC_END_RET_S(hr);
+	}
+
+	// Convert to rgba, rotated but never mirrored
+	RenderOptions renderOptions;
+	renderOptions.rotation = rotation;
+
+	VideoBuffer image;
+	FrameConverter converter;
+	if (!converter.Convert(image,
+			dataY, strideY,
+			dataU, strideU,
+			dataV, strideV,
+			frameWidth, frameHeight,
+			renderOptions))
+		FUNC_END_RET_S(E_OUTOFMEMORY);
+
+	// Get width and height
+	int width = image.width;
+	int height = image.height;
+	uint8_t* rgba = image.image;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	IStream* pStream = nullptr;
+	Gdiplus::Bitmap* bm = nullptr;
+
+	CLSID clsid;
+	if (GetEncoderClsid(options.mimeType, &clsid))
+	{
+		bm = new Gdiplus::Bitmap(width, height, width * 4,
+			PixelFormat32bppARGB, rgba);
+
+		hr = CreateStreamOnHGlobal(NULL, TRUE, &pStream);
+		if (FAILED(hr))
+		{
+			RTC_LOG(LS_INFO) << "failed to create snapshot stream";
+			goto clean_up;
+		}
+
+		auto st = bm->Save(pStream, &clsid);
+		if (st != Gdiplus::Ok)
+		{
+			RTC_LOG(LS_INFO) << "failed to save snapshot to stream";
+			hr = E_FAIL;
+			goto clean_up;
+		}
+
+		ULARGE_INTEGER liSize = {0};
+		hr = IStream_Size(pStream, &liSize);
+		if (FAILED(hr))
+		{
+			RTC_LOG(LS_INFO) << "failed to get stream size";
+			goto clean_up;
+		}
+
+		ULARGE_INTEGER pos = { 0 };
+		LARGE_INTEGER liPos = { 0 };
+		hr = pStream->Seek(liPos, STREAM_SEEK_SET, &pos);
+		if (FAILED(hr))
+		{
+			RTC_LOG(LS_INFO) << "failed to set stream read position";
+			goto clean_up;
+		}
+
+		// Read the stream straight into the sink
+		BYTE* strmBuff = sink.Reserve(liSize.QuadPart);
+		if (!strmBuff)
+		{
+			RTC_LOG(LS_INFO) << "failed to allocate snapshot buffer";
+			hr = E_OUTOFMEMORY;
+			goto clean_up;
+		}
+		
+		ULONG bytesRead = 0;
+		hr = pStream->Read(strmBuff, liSize.QuadPart, &bytesRead);
+		if (SUCCEEDED(hr))
+		{
+			sink.Commit(bytesRead);
+		}
+	}
+	else
+	{
+		RTC_LOG(LS_INFO) << "failed to create snapshot encoder";
+		hr = E_INVALIDARG;
+	}
+
+clean_up:
+	if (pStream)
+		pStream->Release();
+
+	if (bm)
+		delete bm;
+
+	FUNC_END_RET_S(hr);
+}
+
+HRESULT EncodeSnapshot(const webrtc::I420BufferInterface& yuv, webrtc::VideoRotation rotation, const SnapshotOptions& options, _variant_t& result)
+{
+	HRESULT hr;
+
+	if (options.binary)
+	{
+		// Encoder output lands directly in the array handed to javascript
+		SafeArrayByteSink sink;
+		hr = EncodeSnapshot(yuv, rotation, options, sink);
+		if (FAILED(hr) || !sink.GetSize())
+			return FAILED(hr) ? hr : E_FAIL;
+
+		SAFEARRAY* array = sink.Detach();
+		if (!array)
+			return E_OUTOFMEMORY;
+
+		result.Clear();
+		result.vt = VT_ARRAY | VT_UI1;
+		result.parray = array;
+
+		return S_OK;
+	}
+
+	VectorByteSink sink;
+	hr = EncodeSnapshot(yuv, rotation, options, sink);
+	if (FAILED(hr) || !sink.GetSize())
+		return FAILED(hr) ? hr : E_FAIL;
+
+	_bstr_t base64;
+	hr = ToBase64(sink.GetData(), sink.GetSize(), base64);
+	if (FAILED(hr))
+		return hr;
+
+	result.Clear();
+	result.vt = VT_BSTR;
+	result.bstrVal = base64.Detach();
+
+	return S_OK;
+}
+
+uint8_t* SafeArrayByteSink::Reserve(size_t size)
+{
+	ULONG count = array.m_psa ? array.GetCount() : 0;
+	if (used + size <= count)
+		return (uint8_t*)array.m_psa->pvData + used;
+
+	// Grow geometrically, the array stays locked so its data pointer is valid until the next resize
+	size_t grow = used + size > (size_t)count * 2 ? used + size : (size_t)count * 2;
+	if (grow > ULONG_MAX)
+		return nullptr;
+
+	HRESULT hr = array.m_psa ? array.Resize((ULONG)grow) : array.Create((ULONG)grow);
+	if (FAILED(hr))
+		return nullptr;
+
+	return (uint8_t*)array.m_psa->pvData + used;
+}
+
+SAFEARRAY* SafeArrayByteSink::Detach()
+{
+	// Trim to the written bytes
+	HRESULT hr = array.m_psa ? array.Resize((ULONG)used) : array.Create((ULONG)used);
+	if (FAILED(hr))
+		return nullptr;
+
+	used = 0;
+	return array.Detach();
+}
+
+SnapshotTask::SnapshotTask(std::shared_ptr<rtc::Thread>& thread, VARIANT callback,
+	rtc::scoped_refptr<webrtc::I420BufferInterface> yuv, webrtc::VideoRotation rotation, const SnapshotOptions& options) :
+	yuv(yuv),
+	rotation(rotation),
+	options(options)
+{
+	SetThread(thread);
+	MarshalCallback(done, callback);
+}
+
+void SnapshotTask::Run()
+{
+	FUNC_BEGIN();
+
+	// No frame yet
+	if (!yuv)
+	{
+		variant_t none;
+		none.vt = VT_NULL;
+		DispatchAsync(done, none);
+		FUNC_END();
+		return;
+	}
+
+	auto result = std::make_shared<_variant_t>();
+	HRESULT hr = EncodeSnapshot(*yuv, rotation, options, *result);
+
+	// Release frame as soon as possible
+	yuv = nullptr;
+
+	if (FAILED(hr))
+		result->vt = VT_NULL;
+
+	// Shared, so the encoded image is never copied on its way to the callback
+	DispatchAsync(done, result);
+
+	FUNC_END();
+}
+
+BurstTask::BurstTask(std::shared_ptr<rtc::Thread>& thread, VARIANT callback,
+	size_t count, bool score, const SnapshotOptions& options) :
+	count(count),
+	score(score),
+	options(options)
+{
+	SetThread(thread);
+	MarshalCallback(done, callback);
+	shots.reserve(count);
+}
+
+bool BurstTask::AddFrame(rtc::scoped_refptr<webrtc::I420BufferInterface> yuv, webrtc::VideoRotation rotation, int64_t timestampUs)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Settled already, by its timeout
+	if (started)
+		return true;
+
+	// Same frame delivered again
+	if (!shots.empty() && timestampUs && shots.back().timestampUs == timestampUs)
+		return false;
+
+	Shot shot;
+	shot.yuv = yuv;
+	shot.rotation = rotation;
+	shot.timestampUs = timestampUs;
+	shots.push_back(shot);
+
+	return shots.size() >= count;
+}
+
+void BurstTask::Start(WorkerPool& pool)
+{
+	FUNC_BEGIN();
+
+	// No frames are added once started
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (started)
+		{
+			FUNC_END();
+			return;
+		}
+		started = true;
+	}
+
+	pending = shots.size();
+
+	// Nothing collected
+	if (shots.empty())
+	{
+		Finish();
+		FUNC_END();
+		return;
+	}
+
+	rtc::scoped_refptr<BurstTask> self(this);
+	for (size_t i = 0; i < shots.size(); ++i)
+	{
+		// Pool already stopped, run it here
+		if (!pool.Post([self, i]() { self->Encode(i); }))
+			Encode(i);
+	}
+
+	FUNC_END();
+}
+
+void BurstTask::Encode(size_t index)
+{
+	Shot& shot = shots[index];
+
+	if (FAILED(EncodeSnapshot(*shot.yuv, shot.rotation, options, shot.image)))
+		shot.image.vt = VT_NULL;
+
+	if (score)
+		shot.sharpness = ComputeSharpness(shot.yuv->DataY(), shot.yuv->StrideY(), shot.yuv->width(), shot.yuv->height());
+
+	// Release frame as soon as possible
+	shot.yuv = nullptr;
+
+	// Last one reports all of them
+	if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		Finish();
+}
+
+void BurstTask::Finish()
+{
+	FUNC_BEGIN();
+
+	ULONG size = (ULONG)shots.size();
+	auto args = std::make_shared<std::vector<variant_t>>(3);
+
+	if (!size)
+	{
+		for (auto& arg : *args)
+			arg.vt = VT_NULL;
+		DispatchAsync(done, args);
+		FUNC_END();
+		return;
+	}
+
+	CComSafeArray<VARIANT> images(size);
+	CComSafeArray<VARIANT> timestamps(size);
+	CComSafeArray<VARIANT> scores(size);
+
+	for (ULONG i = 0; i < size; ++i)
+	{
+		// Move encoded images into the array, no copies
+		images.SetAt(i, shots[i].image, FALSE);
+		shots[i].image.Detach();
+		timestamps.SetAt(i, _variant_t(shots[i].timestampUs / 1000.0));
+		scores.SetAt(i, score ? _variant_t(shots[i].sharpness) : _variant_t());
+	}
+
+	(*args)[0].vt = VT_ARRAY | VT_VARIANT;
+	(*args)[0].parray = images.Detach();
+	(*args)[1].vt = VT_ARRAY | VT_VARIANT;
+	(*args)[1].parray = timestamps.Detach();
+	(*args)[2].vt = VT_ARRAY | VT_VARIANT;
+	(*args)[2].parray = scores.Detach();
+
+	DispatchAsync(done, args);
+
+	FUNC_END();
+}
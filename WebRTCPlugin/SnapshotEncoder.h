@@ -0,0 +1,130 @@
+// SnapshotEncoder.h : Encoding of video frames into still images
+#pragma once
+#include "CallbackDispatcher.h"
+#include "JpegEncoder.hpp"
+#include "ByteSink.hpp"
+#include "VideoFrameStore.hpp"
+#include "WorkerPool.hpp"
+
+#include <atlsafe.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "api/video/video_frame_buffer.h"
+#include "api/video/video_rotation.h"
+#include "api/scoped_refptr.h"
+
+#ifdef NOMINMAX
+#undef NOMINMAX 
+#ifndef max
+#define max(a,b)            (((a) > (b)) ? (a) : (b))
+#endif
+#ifndef min
+#define min(a,b)            (((a) < (b)) ? (a) : (b))
+#endif
+#endif
+
+#include <gdiplus.h>
+#pragma comment(lib, "Gdiplus.lib")
+
+#undef max
+#undef min
+
+struct SnapshotOptions
+{
+	// image/png through GDI+ or image/jpeg straight from the I420 planes
+	std::wstring mimeType = L"image/png";
+	// JPEG quality, 1 to 100
+	int quality = JpegEncoder::DefaultQuality;
+	// Raw bytes as a VT_ARRAY | VT_UI1 safe array instead of a base64 string
+	bool binary = false;
+	// Area of the upright frame to capture, whole frame when empty
+	ImageRect region;
+	// Output size, region size when zero
+	int width = 0;
+	int height = 0;
+};
+
+// Sink writing into a VT_UI1 safe array, handed over to javascript without copies
+class SafeArrayByteSink : public ByteSink
+{
+public:
+	uint8_t* Reserve(size_t size) override;
+	void Commit(size_t size) override { used += size; }
+	size_t GetSize() const override { return used; }
+
+	// Trims the array to the written bytes and releases it, nullptr on failure
+	SAFEARRAY* Detach();
+
+private:
+	CComSafeArray<BYTE> array;
+	size_t used = 0;
+};
+
+// Encode an I420 frame, rotated upright, into the sink. Can be called from any thread.
+HRESULT EncodeSnapshot(const webrtc::I420BufferInterface& yuv, webrtc::VideoRotation rotation, const SnapshotOptions& options, ByteSink& sink);
+
+// Same, as a base64 BSTR or a byte safe array depending on the options
+HRESULT EncodeSnapshot(const webrtc::I420BufferInterface& yuv, webrtc::VideoRotation rotation, const SnapshotOptions& options, _variant_t& result);
+
+// Encodes a frame on a worker thread and returns the result through a JS callback dispatched on the event thread
+class SnapshotTask :
+	public rtc::RefCountedObject<CallbackDispatcher<rtc::RefCountInterface>>
+{
+public:
+	SnapshotTask(std::shared_ptr<rtc::Thread>& thread, VARIANT callback,
+		rtc::scoped_refptr<webrtc::I420BufferInterface> yuv, webrtc::VideoRotation rotation, const SnapshotOptions& options);
+	virtual ~SnapshotTask() = default;
+
+	// Called on the snapshot thread
+	void Run();
+
+private:
+	Callback done;
+	rtc::scoped_refptr<webrtc::I420BufferInterface> yuv;
+	webrtc::VideoRotation rotation;
+	SnapshotOptions options;
+};
+
+// Collects consecutive distinct frames, encodes them in parallel on a worker pool and returns
+// them all in a single JS callback: callback(images, timestampsMs, sharpnessScores)
+class BurstTask :
+	public rtc::RefCountedObject<CallbackDispatcher<rtc::RefCountInterface>>
+{
+public:
+	BurstTask(std::shared_ptr<rtc::Thread>& thread, VARIANT callback,
+		size_t count, bool score, const SnapshotOptions& options);
+	virtual ~BurstTask() = default;
+
+	// Called on the frame delivery thread, returns true once all frames are collected or it was started
+	bool AddFrame(rtc::scoped_refptr<webrtc::I420BufferInterface> yuv, webrtc::VideoRotation rotation, int64_t timestampUs);
+
+	// Encode the collected frames, the last one to finish fires the callback. Only the first call does
+	// anything, so a full burst and its timeout can both settle it.
+	void Start(WorkerPool& pool);
+
+private:
+	void Encode(size_t index);
+	void Finish();
+
+	struct Shot
+	{
+		rtc::scoped_refptr<webrtc::I420BufferInterface> yuv;
+		webrtc::VideoRotation rotation = webrtc::kVideoRotation_0;
+		int64_t timestampUs = 0;
+		_variant_t image;
+		double sharpness = 0;
+	};
+
+	Callback done;
+	size_t count;
+	bool score;
+	SnapshotOptions options;
+	std::mutex mutex;
+	bool started = false;
+	std::vector<Shot> shots;
+	std::atomic<size_t> pending{ 0 };
+};
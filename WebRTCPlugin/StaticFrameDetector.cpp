@@ -0,0 +1,91 @@
+#include "StaticFrameDetector.hpp"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STATIC_FRAME_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const int SampledRows = StaticFrameDetector::BlockRows / StaticFrameDetector::RowStep;
+
+// Sum of absolute differences of one row of a block
+inline uint32_t RowSad(const uint8_t* a, const uint8_t* b, int size)
+{
+#ifdef STATIC_FRAME_SSE2
+	if (size == StaticFrameDetector::BlockWidth)
+	{
+		__m128i sad = _mm_sad_epu8(
+			_mm_loadu_si128((const __m128i*)a),
+			_mm_loadu_si128((const __m128i*)b));
+		return _mm_cvtsi128_si32(sad) + _mm_cvtsi128_si32(_mm_srli_si128(sad, 8));
+	}
+#endif
+	uint32_t sad = 0;
+	for (int i = 0; i < size; ++i)
+		sad += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+	return sad;
+}
+
+}
+
+bool StaticFrameDetector::IsStatic(const uint8_t* dataY, int strideY, int width, int height, double threshold)
+{
+	// Nothing to compare with
+	if (width != this->width || height != this->height || reference.empty())
+	{
+		Store(dataY, strideY, width, height);
+		return false;
+	}
+
+	int rows = (height + RowStep - 1) / RowStep;
+
+	for (int band = 0; band < rows; band += SampledRows)
+	{
+		int bandRows = rows - band < SampledRows ? rows - band : SampledRows;
+
+		for (int x = 0; x < width; x += BlockWidth)
+		{
+			int blockWidth = width - x < BlockWidth ? width - x : BlockWidth;
+			uint32_t sad = 0;
+
+			for (int i = 0; i < bandRows; ++i)
+			{
+				int row = band + i;
+				sad += RowSad(
+					dataY + row * RowStep * strideY + x,
+					reference.data() + row * width + x,
+					blockWidth);
+			}
+
+			// Any changed block is enough
+			if (sad > threshold * blockWidth * bandRows)
+			{
+				Store(dataY, strideY, width, height);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void StaticFrameDetector::Reset()
+{
+	reference.clear();
+	width = height = 0;
+}
+
+void StaticFrameDetector::Store(const uint8_t* dataY, int strideY, int width, int height)
+{
+	int rows = (height + RowStep - 1) / RowStep;
+
+	reference.resize((size_t)width * rows);
+	for (int row = 0; row < rows; ++row)
+		memcpy(reference.data() + row * width, dataY + row * RowStep * strideY, width);
+
+	this->width = width;
+	this->height = height;
+}
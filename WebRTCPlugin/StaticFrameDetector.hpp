@@ -0,0 +1,36 @@
+#ifndef STATIC_FRAME_DETECTOR_HPP
+#define STATIC_FRAME_DETECTOR_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Detects frames whose luma barely changed since the last changed one.
+// Every RowStep-th row is kept as reference and compared in blocks of
+// BlockWidth x BlockRows pixels with SAD, so a small moving area is enough
+// to make a frame count as changed. Chroma is not compared.
+// Instances are not thread safe, each thread must own its detector.
+class StaticFrameDetector
+{
+public:
+	static const int RowStep = 4;
+	static const int BlockWidth = 16;
+	static const int BlockRows = 16;
+
+	// Returns true if no block differs by more than threshold on average per pixel.
+	// Otherwise the frame becomes the reference for the next ones.
+	bool IsStatic(const uint8_t* dataY, int strideY, int width, int height, double threshold);
+
+	// Forget the reference, the next frame always counts as changed
+	void Reset();
+
+private:
+	void Store(const uint8_t* dataY, int strideY, int width, int height);
+
+	std::vector<uint8_t> reference;
+	int width = 0;
+	int height = 0;
+};
+
+#endif
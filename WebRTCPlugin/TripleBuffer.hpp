@@ -0,0 +1,92 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Wait-free single producer / single consumer triple buffer.
+// The writer always owns one slot and the reader another one, the third
+// slot holds the latest published value and is exchanged atomically, so
+// neither side ever blocks or allocates.
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Writer side: slot to fill before calling Publish
+	T& GetWriteBuffer()
+	{
+		return slots[writeIndex];
+	}
+
+	// Writer side: make the write slot the latest one
+	void Publish()
+	{
+		uint8_t prev = ready.exchange(writeIndex | Fresh, std::memory_order_acq_rel);
+		writeIndex = prev & IndexMask;
+
+		// Previous value was never picked up by the reader
+		if (prev & Fresh)
+			overwritten.fetch_add(1, std::memory_order_relaxed);
+		published.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Reader side: pick up the latest published slot, returns true if it is a new one
+	bool Update()
+	{
+		if (!(ready.load(std::memory_order_relaxed) & Fresh))
+			return false;
+
+		uint8_t prev = ready.exchange(readIndex, std::memory_order_acq_rel);
+		readIndex = prev & IndexMask;
+		hasRead = true;
+
+		return true;
+	}
+
+	// Reader side: whether a published slot is waiting to be picked up
+	bool HasUpdate() const
+	{
+		return (ready.load(std::memory_order_relaxed) & Fresh) != 0;
+	}
+
+	// Reader side: latest slot picked up by Update
+	T& GetReadBuffer()
+	{
+		return slots[readIndex];
+	}
+
+	// Reader side: whether Update has ever returned a slot
+	bool HasReadBuffer() const
+	{
+		return hasRead;
+	}
+
+	uint64_t GetPublished() const
+	{
+		return published.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetOverwritten() const
+	{
+		return overwritten.load(std::memory_order_relaxed);
+	}
+
+private:
+	static const uint8_t IndexMask	= 0x03;
+	static const uint8_t Fresh	= 0x04;
+
+	T slots[3];
+	uint8_t writeIndex = 0;
+	uint8_t readIndex = 1;
+	bool hasRead = false;
+	std::atomic<uint8_t> ready{ 2 };
+	std::atomic<uint64_t> published{ 0 };
+	std::atomic<uint64_t> overwritten{ 0 };
+};
+
+#endif
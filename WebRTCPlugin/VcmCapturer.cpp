@@ -13,48 +13,60 @@ VcmCapturer::VcmCapturer() : vcm_(nullptr)
 {
 }
 
-bool VcmCapturer::Init(size_t width, size_t height, size_t target_fps, size_t capture_device_index)
+std::vector<VcmCapturer::Device> VcmCapturer::FindDevices(const CaptureConstraints& constraints)
 {
 	FUNC_BEGIN();
 
-	std::vector<std::string> device_ids;
-	std::vector<std::string> device_names;
+	std::vector<Device> devices;
 	std::unique_ptr<webrtc::VideoCaptureModule::DeviceInfo> device_info(webrtc::VideoCaptureFactory::CreateDeviceInfo());
 
 	// Check there is no error
 	if (!device_info)
 	{
 		FUNC_END();
-		return false;
+		return devices;
 	}
 
-	// Get all names for devices
+	// Get all names for devices, the requested one first
 	int num_devices = device_info->NumberOfDevices();
 	for (int i = 0; i < num_devices; ++i)
 	{
 		const uint32_t kSize = 256;
 		char name[kSize] = { 0 };
 		char id[kSize] = { 0 };
-		if (device_info->GetDeviceName(i, name, kSize, id, kSize) != -1)
-		{
-			device_ids.push_back(id);
-			device_names.push_back(name);
-		}
-	}
+		if (device_info->GetDeviceName(i, name, kSize, id, kSize) == -1)
+			continue;
 
-	// Try all 
-	for (const auto& id : device_ids)
-	{
-		// Open capturer
-		vcm_ = webrtc::VideoCaptureFactory::Create(id.c_str());
-		if (vcm_)
+		bool requested = !constraints.deviceId.empty() && (constraints.deviceId == id || constraints.deviceId == name);
+
+		// Only that one will do
+		if (constraints.exactDeviceId && !requested)
+			continue;
+
+		// Pick one of its native modes so nothing has to be scaled in software
+		Device device;
+		device.id = id;
+		if (!SelectCapability(device_info.get(), device.id, constraints, device.capability))
 		{
-			id_ = id;
-			label = id_;
-			break;
+			RTC_LOG(LS_INFO) << "no capability of " << id << " satisfies constraints";
+			continue;
 		}
+
+		devices.insert(requested ? devices.begin() : devices.end(), device);
 	}
 
+	FUNC_END();
+
+	return devices;
+}
+
+bool VcmCapturer::Init(const Device& device)
+{
+	FUNC_BEGIN();
+
+	// Open capturer
+	vcm_ = webrtc::VideoCaptureFactory::Create(device.id.c_str());
+
 	// Ensure it is created
 	if (!vcm_)
 	{
@@ -62,14 +74,14 @@ bool VcmCapturer::Init(size_t width, size_t height, size_t target_fps, size_t ca
 		return false;
 	}
 
-	vcm_->RegisterCaptureDataCallback(this);
+	id_ = device.id;
+	label = id_;
+	capability_ = device.capability;
 
-	device_info->GetCapability(vcm_->CurrentDeviceName(), 0, capability_);
+	vcm_->RegisterCaptureDataCallback(this);
 
-	capability_.width     = static_cast<int32_t>(width);
-	capability_.height    = static_cast<int32_t>(height);
-	capability_.maxFPS    = static_cast<int32_t>(target_fps);
-	capability_.videoType = webrtc::VideoType::kI420;
+	RTC_LOG(LS_INFO) << "starting capture [" << capability_.width << "x" << capability_.height
+	                 << "@" << capability_.maxFPS << ", type:" << (int)capability_.videoType << "]";
 
 	if (vcm_->StartCapture(capability_) != 0)
 	{
@@ -85,15 +97,80 @@ bool VcmCapturer::Init(size_t width, size_t height, size_t target_fps, size_t ca
 	return true;
 }
 
-VcmCapturer* VcmCapturer::Create(size_t width, size_t height, size_t target_fps, size_t capture_device_index)
+CaptureFormat VcmCapturer::GetCaptureFormat(webrtc::VideoType type)
+{
+	switch (type)
+	{
+	case webrtc::VideoType::kI420:
+	case webrtc::VideoType::kIYUV:
+		return CaptureFormat::I420;
+	case webrtc::VideoType::kNV12:
+		return CaptureFormat::NV12;
+	case webrtc::VideoType::kYUY2:
+		return CaptureFormat::YUY2;
+	case webrtc::VideoType::kMJPEG:
+		return CaptureFormat::MJPEG;
+	default:
+		return CaptureFormat::Other;
+	}
+}
+
+bool VcmCapturer::SelectCapability(webrtc::VideoCaptureModule::DeviceInfo* device_info, const std::string& id, const CaptureConstraints& constraints, webrtc::VideoCaptureCapability& selected)
+{
+	std::vector<webrtc::VideoCaptureCapability> capabilities;
+	std::vector<CaptureMode> modes;
+
+	int32_t count = device_info->NumberOfCapabilities(id.c_str());
+	for (int32_t i = 0; i < count; ++i)
+	{
+		webrtc::VideoCaptureCapability capability;
+		if (device_info->GetCapability(id.c_str(), i, capability) != 0)
+			continue;
+
+		CaptureMode mode;
+		mode.width = capability.width;
+		mode.height = capability.height;
+		mode.frameRate = capability.maxFPS;
+		mode.format = GetCaptureFormat(capability.videoType);
+
+		capabilities.push_back(capability);
+		modes.push_back(mode);
+	}
+
+	// Nothing enumerated, ask for the ideal values and let the module find its closest mode
+	if (modes.empty())
+	{
+		auto value = [](const ConstraintRange& range, int fallback) {
+			return range.ideal >= 0 ? (int32_t)range.ideal : (range.min >= 0 ? (int32_t)range.min : fallback);
+		};
+
+		selected.width = value(constraints.width, DefaultCaptureWidth);
+		selected.height = value(constraints.height, DefaultCaptureHeight);
+		selected.maxFPS = value(constraints.frameRate, DefaultCaptureFrameRate);
+		selected.videoType = webrtc::VideoType::kI420;
+		return true;
+	}
+
+	int index = MatchCaptureMode(modes, constraints);
+	if (index < 0)
+		return false;
+
+	// Exact mode, the module opens the capability matching all of it, format included,
+	// so the driver does not convert for us and libyuv does it on the capture thread
+	selected = capabilities[index];
+
+	return true;
+}
+
+VcmCapturer* VcmCapturer::Create(const Device& device)
 {
 	FUNC_BEGIN();
 
 	std::unique_ptr<VcmCapturer> vcm_capturer(new VcmCapturer());
-	if (!vcm_capturer->Init(width, height, target_fps, capture_device_index))
+	if (!vcm_capturer->Init(device))
 	{
-		RTC_LOG(LS_WARNING) << "Failed to create VcmCapturer(w = " << width << ", h = " << height
-		                    << ", fps = " << target_fps << ")";
+		RTC_LOG(LS_WARNING) << "Failed to create VcmCapturer(w = " << device.capability.width << ", h = " << device.capability.height
+		                    << ", fps = " << device.capability.maxFPS << ", device = " << device.id << ")";
 		FUNC_END();
 		return nullptr;
 	}
@@ -102,6 +179,19 @@ VcmCapturer* VcmCapturer::Create(size_t width, size_t height, size_t target_fps,
 	return vcm_capturer.release();
 }
 
+VcmCapturer* VcmCapturer::Create(const CaptureConstraints& constraints)
+{
+	// Try all
+	for (const auto& device : FindDevices(constraints))
+	{
+		VcmCapturer* capturer = Create(device);
+		if (capturer)
+			return capturer;
+	}
+
+	return nullptr;
+}
+
 void VcmCapturer::Destroy()
 {
 	FUNC_BEGIN();
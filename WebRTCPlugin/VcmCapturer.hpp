@@ -6,13 +6,27 @@
 #include <string>
 
 #include "VideoCapturer.hpp"
+#include "CaptureConstraints.hpp"
 #include "modules/video_capture/video_capture.h"
 #include "api/scoped_refptr.h"
 
 class VcmCapturer : public VideoCapturer, public rtc::VideoSinkInterface<webrtc::VideoFrame>
 {
 	public:
-		static VcmCapturer* Create(size_t width, size_t height, size_t target_fps, size_t capture_device_index);
+		// A device and the mode to open it in
+		struct Device
+		{
+			std::string id;
+			webrtc::VideoCaptureCapability capability;
+		};
+
+		// Devices with a mode satisfying the constraints, the requested one first
+		static std::vector<Device> FindDevices(const CaptureConstraints& constraints);
+
+		// Opens the device in that mode, null on failure
+		static VcmCapturer* Create(const Device& device);
+		// Opens the first device that works among the ones found for the constraints
+		static VcmCapturer* Create(const CaptureConstraints& constraints);
 		virtual ~VcmCapturer();
 
 		void OnFrame(const webrtc::VideoFrame& frame) override;
@@ -22,7 +36,9 @@ class VcmCapturer : public VideoCapturer, public rtc::VideoSinkInterface<webrtc:
 
 	private:
 		VcmCapturer();
-		bool Init(size_t width, size_t height, size_t target_fps, size_t capture_device_index);
+		bool Init(const Device& device);
+		static CaptureFormat GetCaptureFormat(webrtc::VideoType type);
+		static bool SelectCapability(webrtc::VideoCaptureModule::DeviceInfo* device_info, const std::string& id, const CaptureConstraints& constraints, webrtc::VideoCaptureCapability& selected);
 		void Destroy();
 
 		rtc::scoped_refptr<webrtc::VideoCaptureModule> vcm_;
@@ -9,75 +9,230 @@
 #include "api/video/video_rotation.h"
 #include "api/scoped_refptr.h"
 
+// Start of the crop on one axis, even so chroma planes line up
+static int GetCropStart(int size, int cropped, float offset)
+{
+	offset = std::min(std::max(offset, 0.0f), 1.0f);
+	int start = (int)((size - cropped) * offset + 0.5f) & ~1;
+	return std::min(start, size - cropped);
+}
+
 VideoCapturer::VideoCapturer() = default;
-VideoCapturer::~VideoCapturer() = default;
+
+VideoCapturer::~VideoCapturer()
+{
+	RTC_LOG(LS_INFO) << "capturer buffer pool [hits:" << buffer_pool.GetHits()
+	                 << ", misses:" << buffer_pool.GetMisses()
+	                 << ", scales:" << scales << ", shared:" << shared_scales << "]";
+}
 
 void VideoCapturer::OnFrame(const webrtc::VideoFrame& frame)
 {
 	FUNC_BEGIN();
 
-	int cropped_width = 0;
-	int cropped_height = 0;
-	int out_width = 0;
-	int out_height = 0;
-
-	if (!video_adapter.AdaptFrameResolution(
-		frame.width(),
-		frame.height(),
-		frame.timestamp_us() * 1000,
-		&cropped_width,
-		&cropped_height,
-		&out_width,
-		&out_height))
+	std::lock_guard<std::recursive_mutex> delivering(delivery_mutex);
+
+	// Adapt for every sink under the lock, deliver once out of it
 	{
-		FUNC_END();
-		// Drop frame in order to respect frame rate constraint.
-		return;
+		std::lock_guard<std::mutex> lock(sinks_mutex);
+		Adapt(frame);
 	}
 
-	if (out_height != frame.height() || out_width != frame.width())
+	// A sink calling AddOrUpdateSink or RemoveSink from its OnFrame does not deadlock
+	for (auto& delivery : deliveries)
 	{
-		// Video adapter has requested a down-scale. Allocate a new buffer and
-		// return scaled version.
-		rtc::scoped_refptr<webrtc::I420Buffer> scaled_buffer =
-			webrtc::I420Buffer::Create(out_width, out_height);
-		scaled_buffer->ScaleFrom(*frame.video_frame_buffer()->ToI420());
-		broadcaster.OnFrame(webrtc::VideoFrame::Builder()
-			.set_video_frame_buffer(scaled_buffer)
-			.set_rotation(webrtc::kVideoRotation_0)
-			.set_timestamp_us(frame.timestamp_us())
-			.set_id(frame.id())
-			.build());
+		// Removed by an earlier sink of this frame
+		if (delivery.sink)
+			delivery.sink->OnFrame(delivery.frame);
 	}
-	else
+
+	// Do not hold the buffers until the next frame, the pool reuses them once sinks are done
+	deliveries.clear();
+
+	FUNC_END();
+}
+
+void VideoCapturer::Adapt(const webrtc::VideoFrame& frame)
+{
+	// Scaled outputs of this frame, shared between sinks wanting the same size
+	scaled.clear();
+
+	for (auto& entry : sinks)
 	{
+		int cropped_width = 0;
+		int cropped_height = 0;
+		int out_width = 0;
+		int out_height = 0;
+
+		// Each sink drops frames to respect its own frame rate constraint
+		if (!entry->adapter.AdaptFrameResolution(
+			frame.width(),
+			frame.height(),
+			frame.timestamp_us() * 1000,
+			&cropped_width,
+			&cropped_height,
+			&out_width,
+			&out_height))
+			continue;
+
+		// Nothing left at that size
+		if (out_width <= 0 || out_height <= 0)
+			continue;
+
+		// Disabled track, same size in black
+		if (entry->wants.black_frames)
+		{
+			if (!entry->black_buffer || entry->black_buffer->width() != out_width || entry->black_buffer->height() != out_height)
+			{
+				entry->black_buffer = webrtc::I420Buffer::Create(out_width, out_height);
+				webrtc::I420Buffer::SetBlack(entry->black_buffer.get());
+			}
+			deliveries.push_back(Delivery{ entry->sink, webrtc::VideoFrame::Builder()
+				.set_video_frame_buffer(entry->black_buffer)
+				.set_rotation(frame.rotation())
+				.set_timestamp_us(frame.timestamp_us())
+				.set_id(frame.id())
+				.build() });
+			continue;
+		}
+
 		// No adaptations needed, just return the frame as is.
-		broadcaster.OnFrame(frame);
+		if (out_height == frame.height() && out_width == frame.width())
+		{
+			deliveries.push_back(Delivery{ entry->sink, frame });
+			continue;
+		}
+
+		int crop_x = GetCropStart(frame.width(), cropped_width, entry->crop_offset_x);
+		int crop_y = GetCropStart(frame.height(), cropped_height, entry->crop_offset_y);
+
+		// Already scaled for another sink
+		Scaled* output = nullptr;
+		for (auto& it : scaled)
+		{
+			if (it.crop_x == crop_x && it.crop_y == crop_y &&
+				it.cropped_width == cropped_width && it.cropped_height == cropped_height &&
+				it.out_width == out_width && it.out_height == out_height)
+			{
+				output = &it;
+				break;
+			}
+		}
+
+		if (!output)
+		{
+			// Video adapter has requested a down-scale. Take a buffer from the pool,
+			// reused once downstream is done with it, and return scaled version.
+			rtc::scoped_refptr<webrtc::I420Buffer> scaled_buffer =
+				buffer_pool.CreateBuffer(out_width, out_height);
+
+			// Crop to the adapted aspect ratio and scale in a single pass, only
+			// reading the cropped pixels of the source planes
+			scaled_buffer->CropAndScaleFrom(
+				*frame.video_frame_buffer()->ToI420(),
+				crop_x,
+				crop_y,
+				cropped_width,
+				cropped_height);
+
+			scaled.push_back(Scaled{ crop_x, crop_y, cropped_width, cropped_height, out_width, out_height,
+				webrtc::VideoFrame::Builder()
+					.set_video_frame_buffer(scaled_buffer)
+					.set_rotation(webrtc::kVideoRotation_0)
+					.set_timestamp_us(frame.timestamp_us())
+					.set_id(frame.id())
+					.build(),
+				0 });
+			output = &scaled.back();
+			scales++;
+		}
+
+		if (output->sinks++ == 1)
+			shared_scales++;
+
+		deliveries.push_back(Delivery{ entry->sink, output->frame });
+	}
+
+	// Deliveries keep their own references
+	scaled.clear();
+}
+
+void VideoCapturer::SetCropOffset(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, float x, float y)
+{
+	std::lock_guard<std::mutex> lock(sinks_mutex);
+
+	for (auto& entry : sinks)
+	{
+		if (entry->sink == sink)
+		{
+			entry->crop_offset_x = x;
+			entry->crop_offset_y = y;
+		}
 	}
-	FUNC_END();
 }
 
 rtc::VideoSinkWants VideoCapturer::GetSinkWants()
 {
-	return broadcaster.wants();
+	std::lock_guard<std::mutex> lock(sinks_mutex);
+
+	// Same aggregation as rtc::VideoBroadcaster
+	rtc::VideoSinkWants wants;
+	wants.rotation_applied = false;
+	for (const auto& entry : sinks)
+	{
+		if (entry->wants.rotation_applied)
+			wants.rotation_applied = true;
+		if (entry->wants.max_pixel_count < wants.max_pixel_count)
+			wants.max_pixel_count = entry->wants.max_pixel_count;
+		if (entry->wants.target_pixel_count &&
+			(!wants.target_pixel_count || *entry->wants.target_pixel_count < *wants.target_pixel_count))
+			wants.target_pixel_count = entry->wants.target_pixel_count;
+		if (entry->wants.max_framerate_fps < wants.max_framerate_fps)
+			wants.max_framerate_fps = entry->wants.max_framerate_fps;
+	}
+	if (wants.target_pixel_count && *wants.target_pixel_count >= wants.max_pixel_count)
+		wants.target_pixel_count.emplace(wants.max_pixel_count);
+
+	return wants;
 }
 
 void VideoCapturer::AddOrUpdateSink(
 	rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, const rtc::VideoSinkWants& wants)
 {
-	broadcaster.AddOrUpdateSink(sink, wants);
-	UpdateVideoAdapter();
+	std::lock_guard<std::mutex> lock(sinks_mutex);
+
+	auto it = std::find_if(sinks.begin(), sinks.end(), [sink](const std::unique_ptr<SinkAdapter>& entry) {
+		return entry->sink == sink;
+	});
+
+	if (it == sinks.end())
+	{
+		sinks.emplace_back(new SinkAdapter());
+		it = sinks.end() - 1;
+		(*it)->sink = sink;
+	}
+
+	// Only this sink adapter follows its wants
+	(*it)->wants = wants;
+	(*it)->adapter.OnResolutionFramerateRequest(
+		wants.target_pixel_count, wants.max_pixel_count, wants.max_framerate_fps);
 }
 
 void VideoCapturer::RemoveSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink)
 {
-	broadcaster.RemoveSink(sink);
-	UpdateVideoAdapter();
-}
+	// Waits for a frame being delivered, unless called from a sink of it
+	std::lock_guard<std::recursive_mutex> delivering(delivery_mutex);
 
-void VideoCapturer::UpdateVideoAdapter()
-{
-	rtc::VideoSinkWants wants = broadcaster.wants();
-	video_adapter.OnResolutionFramerateRequest(
-		wants.target_pixel_count, wants.max_pixel_count, wants.max_framerate_fps);
+	// Not given the rest of the current frame either
+	for (auto& delivery : deliveries)
+	{
+		if (delivery.sink == sink)
+			delivery.sink = nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(sinks_mutex);
+
+	sinks.erase(std::remove_if(sinks.begin(), sinks.end(), [sink](const std::unique_ptr<SinkAdapter>& entry) {
+		return entry->sink == sink;
+	}), sinks.end());
 }
@@ -3,13 +3,20 @@
 
 #include <stddef.h>
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include "media/base/video_adapter.h"
-#include "media/base/video_broadcaster.h"
 #include "api/video/video_frame.h"
 #include "api/video/video_source_interface.h"
 
+#include "FrameBufferPool.hpp"
+
+// Source adapting the captured frames for each sink on its own, so the preview
+// and the encoder can get different sizes and frame rates from the same capture.
+// Sinks wanting the same size share the scaled frame.
 class VideoCapturer : public rtc::VideoSourceInterface<webrtc::VideoFrame>
 {
 public:
@@ -20,15 +27,72 @@ public:
 	  rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, const rtc::VideoSinkWants& wants) override;
 	void RemoveSink(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink) override;
 
+	// Where the adapter crop of an added sink is taken from when the aspect ratio
+	// changes, 0 to 1 on each axis, 0.5 keeps it centered. Moving it pans over the
+	// full capture for that sink only.
+	void SetCropOffset(rtc::VideoSinkInterface<webrtc::VideoFrame>* sink, float x, float y);
+
+	// Downscaled frames written on a reused buffer, or on a new one
+	uint64_t GetPoolHits() const { return buffer_pool.GetHits(); }
+	uint64_t GetPoolMisses() const { return buffer_pool.GetMisses(); }
+
+	// Scaled frames delivered to more than one sink, and scalings done
+	uint64_t GetSharedScales() const { return shared_scales; }
+	uint64_t GetScales() const { return scales; }
+
 protected:
 	void OnFrame(const webrtc::VideoFrame& frame);
+	// Aggregated over all sinks, the least any of them wants
 	rtc::VideoSinkWants GetSinkWants();
 
 private:
-	void UpdateVideoAdapter();
+	// Adaptations of the frame for every sink into deliveries, under sinks_mutex
+	void Adapt(const webrtc::VideoFrame& frame);
+
+	// Sizes scaled to at once, one per sink at most
+	static const size_t MaxScaledSizes = 4;
+
+	struct SinkAdapter
+	{
+		rtc::VideoSinkInterface<webrtc::VideoFrame>* sink;
+		rtc::VideoSinkWants wants;
+		cricket::VideoAdapter adapter;
+		rtc::scoped_refptr<webrtc::I420Buffer> black_buffer;
+		float crop_offset_x = 0.5f;
+		float crop_offset_y = 0.5f;
+	};
+
+	// Output of one adaptation for the current frame
+	struct Scaled
+	{
+		int crop_x;
+		int crop_y;
+		int cropped_width;
+		int cropped_height;
+		int out_width;
+		int out_height;
+		webrtc::VideoFrame frame;
+		int sinks;
+	};
+
+	// Frame handed to one sink once out of sinks_mutex
+	struct Delivery
+	{
+		rtc::VideoSinkInterface<webrtc::VideoFrame>* sink;
+		webrtc::VideoFrame frame;
+	};
+
+	// Held while delivering, so no frame reaches a sink once RemoveSink returns.
+	// Recursive, sinks may remove themselves or others from their OnFrame.
+	std::recursive_mutex delivery_mutex;
+	std::vector<Delivery> deliveries;
 
-	rtc::VideoBroadcaster broadcaster;
-	cricket::VideoAdapter video_adapter;
+	std::mutex sinks_mutex;
+	std::vector<std::unique_ptr<SinkAdapter>> sinks;
+	std::vector<Scaled> scaled;
+	FrameBufferPool buffer_pool{ FrameBufferPool::DefaultMaxBuffers, MaxScaledSizes };
+	std::atomic<uint64_t> scales{ 0 };
+	std::atomic<uint64_t> shared_scales{ 0 };
 };
 
 #endif
@@ -0,0 +1,426 @@
+#include "VideoFrameStore.hpp"
+
+#undef FOURCC
+#include "third_party/libyuv/include/libyuv.h"
+
+bool VideoBuffer::Reserve(size_t width, size_t height)
+{
+	size_t size = width * height * 4;
+
+	// Grow only, so steady state frames reuse the same memory
+	if (size > capacity)
+	{
+		uint8_t* aux = (uint8_t*)realloc(image, size);
+		if (!aux)
+			return false;
+		image = aux;
+		capacity = size;
+	}
+
+	this->width = width;
+	this->height = height;
+	this->stride = width * 4;
+
+	return true;
+}
+
+bool YUVBuffer::Reserve(int width, int height)
+{
+	int chromaHeight = (height + 1) / 2;
+	int strideUV = (width + 1) / 2;
+	size_t size = width * height + strideUV * chromaHeight * 2;
+
+	// Grow only, so steady state frames reuse the same memory
+	if (size > capacity)
+	{
+		uint8_t* aux = (uint8_t*)realloc(data, size);
+		if (!aux)
+			return false;
+		data = aux;
+		capacity = size;
+	}
+
+	this->width = width;
+	this->height = height;
+	this->strideY = width;
+	this->strideUV = strideUV;
+
+	return true;
+}
+
+bool ConvertI420ToARGB(
+	VideoBuffer& buffer,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height)
+{
+	if (!buffer.Reserve(width, height))
+		return false;
+
+	libyuv::I420ToARGB(
+		dataY,
+		strideY,
+		dataU,
+		strideU,
+		dataV,
+		strideV,
+		buffer.image,
+		buffer.stride,
+		width,
+		height);
+
+	return true;
+}
+
+ImageRect UnrotateRect(const ImageRect& rect, int width, int height, int rotation)
+{
+	ImageRect src;
+
+	switch (rotation)
+	{
+	case 90:
+		src.x = rect.y;
+		src.y = height - rect.x - rect.width;
+		src.width = rect.height;
+		src.height = rect.width;
+		break;
+	case 180:
+		src.x = width - rect.x - rect.width;
+		src.y = height - rect.y - rect.height;
+		src.width = rect.width;
+		src.height = rect.height;
+		break;
+	case 270:
+		src.x = width - rect.y - rect.height;
+		src.y = rect.x;
+		src.width = rect.height;
+		src.height = rect.width;
+		break;
+	default:
+		src = rect;
+		break;
+	}
+
+	return src;
+}
+
+bool CropAndScaleI420(
+	YUVBuffer& buffer,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	const ImageRect& region,
+	int outWidth, int outHeight,
+	ScaleFilter filter)
+{
+	// Clamp to the image
+	int left = region.x > 0 ? region.x : 0;
+	int top = region.y > 0 ? region.y : 0;
+	int right = region.x + region.width < width ? region.x + region.width : width;
+	int bottom = region.y + region.height < height ? region.y + region.height : height;
+
+	// Chroma is subsampled, start on an even pixel keeping the far edges
+	left &= ~1;
+	top &= ~1;
+
+	if (right <= left || bottom <= top || outWidth <= 0 || outHeight <= 0)
+		return false;
+
+	if (!buffer.Reserve(outWidth, outHeight))
+		return false;
+
+	// Only the pixels of the region are ever read
+	libyuv::I420Scale(
+		dataY + top * strideY + left,
+		strideY,
+		dataU + (top / 2) * strideU + left / 2,
+		strideU,
+		dataV + (top / 2) * strideV + left / 2,
+		strideV,
+		right - left,
+		bottom - top,
+		buffer.DataY(),
+		buffer.strideY,
+		buffer.DataU(),
+		buffer.strideUV,
+		buffer.DataV(),
+		buffer.strideUV,
+		outWidth,
+		outHeight,
+		(libyuv::FilterMode)filter);
+
+	return true;
+}
+
+// Rows converted at once when rotating or mirroring, even to keep chroma rows aligned
+static const int BandHeight = 16;
+
+// Slices smaller than this are not worth a thread switch
+static const int MinSliceHeight = 64;
+
+void FrameConverter::SetThreads(WorkerPool* pool, int threads)
+{
+	this->pool = pool;
+	this->threads = pool && threads > 1 ? threads : 1;
+}
+
+int FrameConverter::GetSlices(int height) const
+{
+	int slices = height / MinSliceHeight;
+	if (slices > threads)
+		slices = threads;
+	return slices > 1 ? slices : 1;
+}
+
+int FrameConverter::GetSliceStart(int height, int slices, int index) const
+{
+	if (index >= slices)
+		return height;
+
+	// Multiple of the band height so chroma rows and bands never straddle slices
+	return (int)((int64_t)height * index / slices) & ~(BandHeight - 1);
+}
+
+bool FrameConverter::Convert(
+	VideoBuffer& buffer,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	const RenderOptions& options)
+{
+	bool transposed = options.rotation == 90 || options.rotation == 270;
+
+	// Target is given after rotation, scale before it
+	int targetWidth = transposed ? options.targetHeight : options.targetWidth;
+	int targetHeight = transposed ? options.targetWidth : options.targetHeight;
+
+	// Upscaling in I420 would only add pixels to convert, leave it to the blit unless asked for
+	bool scale = !(targetWidth <= 0 || targetHeight <= 0 ||
+		(targetWidth == width && targetHeight == height) ||
+		(!options.upscale && (int64_t)targetWidth * targetHeight >= (int64_t)width * height));
+
+	int outWidth = scale ? targetWidth : width;
+	int outHeight = scale ? targetHeight : height;
+
+	if (scale && !scaled.Reserve(targetWidth, targetHeight))
+		return false;
+
+	// Mirroring after rotating is the same as rotating the other way after mirroring
+	int rotation = options.rotation;
+	bool mirror = options.mirror;
+	if (mirror)
+		rotation = (360 - rotation) % 360;
+
+	if (!buffer.Reserve(transposed ? outHeight : outWidth, transposed ? outWidth : outHeight))
+		return false;
+
+	int slices = GetSlices(outHeight);
+
+	// Band buffers are only needed when moving pixels around
+	bool banded = rotation || mirror;
+	if (banded && !(mirror && rotation == 180))
+	{
+		while ((int)bands.size() < slices)
+			bands.emplace_back(new VideoBuffer[2]);
+
+		for (int i = 0; i < slices; ++i)
+			if (!bands[i][0].Reserve(outWidth, BandHeight) || (mirror && rotation && !bands[i][1].Reserve(outWidth, BandHeight)))
+				return false;
+	}
+
+	// Slices can only scale their own rows when every one maps onto whole even source rows,
+	// as then the filter walks the same grid as for the whole image
+	int ratio = scale && height % outHeight == 0 ? height / outHeight : 0;
+	bool sliceScale = slices > 1 && ratio && (height + 1) / 2 == ratio * ((outHeight + 1) / 2);
+
+	// Otherwise scale the whole image first, a plane per thread, and slice the conversion only
+	if (scale && !sliceScale)
+	{
+		auto scalePlane = [&](size_t plane) {
+			const uint8_t* data = plane == 0 ? dataY : plane == 1 ? dataU : dataV;
+			int stride = plane == 0 ? strideY : plane == 1 ? strideU : strideV;
+			uint8_t* dst = plane == 0 ? scaled.DataY() : plane == 1 ? scaled.DataU() : scaled.DataV();
+			int dstStride = plane == 0 ? scaled.strideY : scaled.strideUV;
+
+			libyuv::ScalePlane(
+				data,
+				stride,
+				plane == 0 ? width : (width + 1) / 2,
+				plane == 0 ? height : (height + 1) / 2,
+				dst,
+				dstStride,
+				plane == 0 ? outWidth : (outWidth + 1) / 2,
+				plane == 0 ? outHeight : (outHeight + 1) / 2,
+				(libyuv::FilterMode)options.filter);
+		};
+
+		if (slices > 1)
+			pool->ParallelFor(3, scalePlane);
+		else
+			for (size_t plane = 0; plane < 3; ++plane)
+				scalePlane(plane);
+	}
+
+	auto run = [&](size_t index) {
+		int from = GetSliceStart(outHeight, slices, (int)index);
+		int to = GetSliceStart(outHeight, slices, (int)index + 1);
+		VideoBuffer* scratch = banded && !bands.empty() ? bands[index].get() : nullptr;
+
+		if (!scale)
+		{
+			TransformRows(buffer, dataY, strideY, dataU, strideU, dataV, strideV,
+				width, height, rotation, mirror, from, to, scratch);
+			return;
+		}
+
+		// Scale this slice rows right before converting them
+		if (sliceScale)
+			libyuv::I420Scale(
+				dataY + from * ratio * strideY,
+				strideY,
+				dataU + (from * ratio / 2) * strideU,
+				strideU,
+				dataV + (from * ratio / 2) * strideV,
+				strideV,
+				width,
+				(to - from) * ratio,
+				scaled.DataY() + from * scaled.strideY,
+				scaled.strideY,
+				scaled.DataU() + (from / 2) * scaled.strideUV,
+				scaled.strideUV,
+				scaled.DataV() + (from / 2) * scaled.strideUV,
+				scaled.strideUV,
+				outWidth,
+				to - from,
+				(libyuv::FilterMode)options.filter);
+
+		TransformRows(buffer,
+			scaled.DataY(), scaled.strideY,
+			scaled.DataU(), scaled.strideUV,
+			scaled.DataV(), scaled.strideUV,
+			outWidth, outHeight, rotation, mirror, from, to, scratch);
+	};
+
+	if (slices > 1)
+		pool->ParallelFor(slices, run);
+	else
+		run(0);
+
+	return true;
+}
+
+void FrameConverter::TransformRows(
+	VideoBuffer& buffer,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	int rotation, bool mirror,
+	int from, int to,
+	VideoBuffer* scratch)
+{
+	// Nothing to move around
+	if (!rotation && !mirror)
+	{
+		libyuv::I420ToARGB(
+			dataY + from * strideY,
+			strideY,
+			dataU + (from / 2) * strideU,
+			strideU,
+			dataV + (from / 2) * strideV,
+			strideV,
+			buffer.image + from * buffer.stride,
+			buffer.stride,
+			width,
+			to - from);
+		return;
+	}
+
+	// Mirrored and rotated 180 is a vertical flip, libyuv does it while converting
+	if (mirror && rotation == 180)
+	{
+		libyuv::I420ToARGB(
+			dataY + from * strideY,
+			strideY,
+			dataU + (from / 2) * strideU,
+			strideU,
+			dataV + (from / 2) * strideV,
+			strideV,
+			buffer.image + (height - to) * buffer.stride,
+			buffer.stride,
+			width,
+			-(to - from));
+		return;
+	}
+
+	for (int y = from; y < to; y += BandHeight)
+	{
+		int rows = to - y < BandHeight ? to - y : BandHeight;
+
+		// Convert band
+		libyuv::I420ToARGB(
+			dataY + y * strideY,
+			strideY,
+			dataU + (y / 2) * strideU,
+			strideU,
+			dataV + (y / 2) * strideV,
+			strideV,
+			scratch[0].image,
+			scratch[0].stride,
+			width,
+			rows);
+
+		// Mirror only, straight into place
+		if (!rotation)
+		{
+			libyuv::ARGBMirror(
+				scratch[0].image,
+				scratch[0].stride,
+				buffer.image + y * buffer.stride,
+				buffer.stride,
+				width,
+				rows);
+			continue;
+		}
+
+		const VideoBuffer* band = &scratch[0];
+		if (mirror)
+		{
+			libyuv::ARGBMirror(
+				scratch[0].image,
+				scratch[0].stride,
+				scratch[1].image,
+				scratch[1].stride,
+				width,
+				rows);
+			band = &scratch[1];
+		}
+
+		// Where the band lands once rotated
+		uint8_t* dst;
+		switch (rotation)
+		{
+		case 90:
+			dst = buffer.image + (height - y - rows) * 4;
+			break;
+		case 180:
+			dst = buffer.image + (height - y - rows) * buffer.stride;
+			break;
+		default:
+			dst = buffer.image + y * 4;
+			break;
+		}
+
+		libyuv::ARGBRotate(
+			band->image,
+			band->stride,
+			dst,
+			buffer.stride,
+			width,
+			rows,
+			(libyuv::RotationMode)rotation);
+	}
+}
@@ -0,0 +1,243 @@
+#ifndef VIDEO_FRAME_STORE_HPP
+#define VIDEO_FRAME_STORE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <vector>
+
+#include "TripleBuffer.hpp"
+#include "WorkerPool.hpp"
+
+// Persistent ARGB surface, only reallocated when a bigger frame arrives
+struct VideoBuffer
+{
+	size_t width	= 0;
+	size_t height	= 0;
+	size_t stride	= 0;
+	size_t capacity	= 0;
+	uint8_t* image	= nullptr;
+
+	VideoBuffer() = default;
+	VideoBuffer(const VideoBuffer&) = delete;
+	VideoBuffer& operator=(const VideoBuffer&) = delete;
+
+	bool Reserve(size_t width, size_t height);
+
+	~VideoBuffer()
+	{
+		if (image) free(image);
+	}
+};
+
+// Writer owned I420 image used as intermediate when scaling before conversion
+struct YUVBuffer
+{
+	int width	= 0;
+	int height	= 0;
+	int strideY	= 0;
+	int strideUV	= 0;
+	size_t capacity	= 0;
+	uint8_t* data	= nullptr;
+
+	YUVBuffer() = default;
+	YUVBuffer(const YUVBuffer&) = delete;
+	YUVBuffer& operator=(const YUVBuffer&) = delete;
+
+	bool Reserve(int width, int height);
+
+	uint8_t* DataY() const { return data; }
+	uint8_t* DataU() const { return data + strideY * height; }
+	uint8_t* DataV() const { return DataU() + strideUV * ((height + 1) / 2); }
+
+	~YUVBuffer()
+	{
+		if (data) free(data);
+	}
+};
+
+// Same values as libyuv::FilterMode
+enum class ScaleFilter
+{
+	None		= 0,
+	Linear		= 1,
+	Bilinear	= 2,
+	Box		= 3
+};
+
+// Convert an I420 image into the buffer, growing it if needed
+bool ConvertI420ToARGB(
+	VideoBuffer& buffer,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height);
+
+// Rectangle on an image, in pixels
+struct ImageRect
+{
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+// Map a rectangle on the upright image back onto the image before its clockwise rotation
+ImageRect UnrotateRect(const ImageRect& rect, int width, int height, int rotation);
+
+// Crop a region of an I420 image and scale it to the output size in one pass, growing the buffer if needed.
+// The region is clamped to the image and its origin aligned to even pixels so chroma planes line up.
+bool CropAndScaleI420(
+	YUVBuffer& buffer,
+	const uint8_t* dataY, int strideY,
+	const uint8_t* dataU, int strideU,
+	const uint8_t* dataV, int strideV,
+	int width, int height,
+	const ImageRect& region,
+	int outWidth, int outHeight,
+	ScaleFilter filter);
+
+// How a frame has to be laid out on its ARGB surface
+struct RenderOptions
+{
+	// Display size, after rotation. Zero keeps the frame size.
+	int targetWidth = 0;
+	int targetHeight = 0;
+	ScaleFilter filter = ScaleFilter::Box;
+	// Clockwise rotation in degrees, 0, 90, 180 or 270
+	int rotation = 0;
+	// Horizontal flip applied after rotation
+	bool mirror = false;
+	// Scale up to the target too, instead of leaving it to the blit
+	bool upscale = false;
+};
+
+// Scales, rotates, mirrors and converts I420 images into ARGB surfaces.
+// When the target is smaller than the image, it is scaled in I420 first so
+// only output pixels are converted. Rotation and mirroring are done in the
+// same pass as the conversion, a few rows at a time through small band
+// buffers, so no full size intermediate image is ever allocated.
+// Big images can be split in horizontal slices converted on their own pool
+// thread. Integer ratios scale per slice too, others scale a plane per thread first.
+// Instances are not thread safe, each writer must own its converter.
+class FrameConverter
+{
+public:
+	// Split frames in up to threads slices run on the pool, one keeps all work on the caller thread
+	void SetThreads(WorkerPool* pool, int threads);
+
+	bool Convert(
+		VideoBuffer& buffer,
+		const uint8_t* dataY, int strideY,
+		const uint8_t* dataU, int strideU,
+		const uint8_t* dataV, int strideV,
+		int width, int height,
+		const RenderOptions& options);
+
+private:
+	// Convert source rows [from, to) into their place on the already reserved buffer
+	void TransformRows(
+		VideoBuffer& buffer,
+		const uint8_t* dataY, int strideY,
+		const uint8_t* dataU, int strideU,
+		const uint8_t* dataV, int strideV,
+		int width, int height,
+		int rotation, bool mirror,
+		int from, int to,
+		VideoBuffer* scratch);
+
+	// Slices for an image of the given height, boundaries are multiples of the band height
+	int GetSlices(int height) const;
+	int GetSliceStart(int height, int slices, int index) const;
+
+	YUVBuffer scaled;
+	// Two band buffers per slice
+	std::vector<std::unique_ptr<VideoBuffer[]>> bands;
+	WorkerPool* pool = nullptr;
+	int threads = 1;
+};
+
+// Converts each I420 frame once, on arrival, into reusable ARGB surfaces
+// handed to the reader through a triple buffer. The payload travels along
+// with the surface, so readers get the source frame that produced it.
+template<typename PayloadT>
+class VideoFrameStore
+{
+public:
+	struct Frame
+	{
+		VideoBuffer surface;
+		PayloadT payload;
+	};
+
+	// Called from the frame delivery thread, see FrameConverter::SetThreads
+	void SetThreads(WorkerPool* pool, int threads)
+	{
+		converter.SetThreads(pool, threads);
+	}
+
+	// Called from the frame delivery thread
+	bool Store(
+		const uint8_t* dataY, int strideY,
+		const uint8_t* dataU, int strideU,
+		const uint8_t* dataV, int strideV,
+		int width, int height,
+		const RenderOptions& options,
+		const PayloadT& payload)
+	{
+		return Store(dataY, strideY, dataU, strideU, dataV, strideV, width, height, options, payload, [](VideoBuffer&) {});
+	}
+
+	// Same, running process on the converted surface before handing it to the reader
+	template<typename ProcessT>
+	bool Store(
+		const uint8_t* dataY, int strideY,
+		const uint8_t* dataU, int strideU,
+		const uint8_t* dataV, int strideV,
+		int width, int height,
+		const RenderOptions& options,
+		const PayloadT& payload,
+		ProcessT process)
+	{
+		Frame& frame = frames.GetWriteBuffer();
+
+		if (!converter.Convert(frame.surface,
+				dataY, strideY, dataU, strideU, dataV, strideV,
+				width, height, options))
+			return false;
+
+		process(frame.surface);
+		frame.payload = payload;
+		frames.Publish();
+
+		return true;
+	}
+
+	// Runs functor with the latest converted frame, returns false if there is none yet.
+	// Must always be called from the same thread.
+	template<typename FunctorT>
+	bool Read(FunctorT functor)
+	{
+		frames.Update();
+
+		if (!frames.HasReadBuffer())
+			return false;
+
+		functor(frames.GetReadBuffer());
+		return true;
+	}
+
+	// Whether a frame has been stored since the last Read
+	bool HasNewFrame() const { return frames.HasUpdate(); }
+
+	uint64_t GetConvertedFrames() const { return frames.GetPublished(); }
+	uint64_t GetOverwrittenFrames() const { return frames.GetOverwritten(); }
+
+private:
+	TripleBuffer<Frame> frames;
+	FrameConverter converter;
+};
+
+#endif
@@ -0,0 +1,518 @@
+#include "VideoOverlay.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VIDEO_OVERLAY_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Exact x / 255 for x up to 255 * 255, rounded
+inline uint32_t Div255(uint32_t x)
+{
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+// Premultiplied color over one layer pixel
+inline void Over(uint8_t* pixel, uint32_t color, uint32_t alpha)
+{
+	uint32_t inverse = 255 - alpha;
+	pixel[0] = (uint8_t)(Div255((color & 0xFF) * alpha) + Div255(pixel[0] * inverse));
+	pixel[1] = (uint8_t)(Div255(((color >> 8) & 0xFF) * alpha) + Div255(pixel[1] * inverse));
+	pixel[2] = (uint8_t)(Div255(((color >> 16) & 0xFF) * alpha) + Div255(pixel[2] * inverse));
+	pixel[3] = (uint8_t)(alpha + Div255(pixel[3] * inverse));
+}
+
+// Distance from a point to a segment
+inline float SegmentDistance(float px, float py, float ax, float ay, float bx, float by)
+{
+	float dx = bx - ax;
+	float dy = by - ay;
+	float length = dx * dx + dy * dy;
+	float t = length > 0 ? ((px - ax) * dx + (py - ay) * dy) / length : 0;
+	t = t < 0 ? 0 : (t > 1 ? 1 : t);
+	float ex = px - ax - t * dx;
+	float ey = py - ay - t * dy;
+	return sqrtf(ex * ex + ey * ey);
+}
+
+// Coverage of a pixel at the given distance from an edge, one pixel of anti-aliasing
+inline float Coverage(float distance)
+{
+	float coverage = 0.5f - distance;
+	return coverage < 0 ? 0 : (coverage > 1 ? 1 : coverage);
+}
+
+struct Segment
+{
+	float ax, ay, bx, by;
+};
+
+// Run the coverage function over the box, clipped to the layer, widening the row spans it draws on
+template<typename CoverageT>
+void Fill(OverlayLayer& layer, float left, float top, float right, float bottom, uint32_t color, CoverageT coverage)
+{
+	int x0 = std::max(0, (int)floorf(left));
+	int y0 = std::max(0, (int)floorf(top));
+	int x1 = std::min((int)layer.image.width, (int)ceilf(right) + 1);
+	int y1 = std::min((int)layer.image.height, (int)ceilf(bottom) + 1);
+
+	uint32_t alpha = color >> 24;
+
+	for (int y = y0; y < y1; ++y)
+	{
+		uint8_t* row = layer.image.image + y * layer.image.stride;
+		int first = x1;
+		int last = x0;
+
+		for (int x = x0; x < x1; ++x)
+		{
+			// Sampled at pixel centers
+			float value = coverage(x + 0.5f, y + 0.5f);
+			uint32_t weight = (uint32_t)(alpha * value + 0.5f);
+			if (!weight)
+				continue;
+
+			Over(row + x * 4, color, weight);
+			first = std::min(first, x);
+			last = x + 1;
+		}
+
+		if (first >= last)
+			continue;
+
+		if (layer.rowStart[y] >= layer.rowEnd[y])
+		{
+			layer.rowStart[y] = first;
+			layer.rowEnd[y] = last;
+		}
+		else
+		{
+			layer.rowStart[y] = std::min(layer.rowStart[y], first);
+			layer.rowEnd[y] = std::max(layer.rowEnd[y], last);
+		}
+	}
+}
+
+// Strokes made of several segments, covered once even where they join
+void StrokeSegments(OverlayLayer& layer, const Segment* segments, int count, float lineWidth, uint32_t color)
+{
+	float half = lineWidth / 2;
+	float left = segments[0].ax, right = left, top = segments[0].ay, bottom = top;
+	for (int i = 0; i < count; ++i)
+	{
+		left = std::min(left, std::min(segments[i].ax, segments[i].bx));
+		right = std::max(right, std::max(segments[i].ax, segments[i].bx));
+		top = std::min(top, std::min(segments[i].ay, segments[i].by));
+		bottom = std::max(bottom, std::max(segments[i].ay, segments[i].by));
+	}
+
+	Fill(layer, left - half - 1, top - half - 1, right + half + 1, bottom + half + 1, color, [&](float x, float y) {
+		float distance = SegmentDistance(x, y, segments[0].ax, segments[0].ay, segments[0].bx, segments[0].by);
+		for (int i = 1; i < count; ++i)
+			distance = std::min(distance, SegmentDistance(x, y, segments[i].ax, segments[i].ay, segments[i].bx, segments[i].by));
+		return Coverage(distance - half);
+	});
+}
+
+// Printable ASCII in 5x7 dots, one byte per column, top row in the lowest bit
+const uint8_t Font5x7[95][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+	{ 0x00, 0x00, 0x5F, 0x00, 0x00 }, // !
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, // "
+	{ 0x14, 0x7F, 0x14, 0x7F, 0x14 }, // #
+	{ 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, // $
+	{ 0x23, 0x13, 0x08, 0x64, 0x62 }, // %
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, // &
+	{ 0x00, 0x05, 0x03, 0x00, 0x00 }, // '
+	{ 0x00, 0x1C, 0x22, 0x41, 0x00 }, // (
+	{ 0x00, 0x41, 0x22, 0x1C, 0x00 }, // )
+	{ 0x14, 0x08, 0x3E, 0x08, 0x14 }, // *
+	{ 0x08, 0x08, 0x3E, 0x08, 0x08 }, // +
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, // ,
+	{ 0x08, 0x08, 0x08, 0x08, 0x08 }, // -
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, // .
+	{ 0x20, 0x10, 0x08, 0x04, 0x02 }, // /
+	{ 0x3E, 0x51, 0x49, 0x45, 0x3E }, // 0
+	{ 0x00, 0x42, 0x7F, 0x40, 0x00 }, // 1
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, // 2
+	{ 0x21, 0x41, 0x45, 0x4B, 0x31 }, // 3
+	{ 0x18, 0x14, 0x12, 0x7F, 0x10 }, // 4
+	{ 0x27, 0x45, 0x45, 0x45, 0x39 }, // 5
+	{ 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // 6
+	{ 0x01, 0x71, 0x09, 0x05, 0x03 }, // 7
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, // 8
+	{ 0x06, 0x49, 0x49, 0x29, 0x1E }, // 9
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, // :
+	{ 0x00, 0x56, 0x36, 0x00, 0x00 }, // ;
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, // <
+	{ 0x14, 0x14, 0x14, 0x14, 0x14 }, // =
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, // >
+	{ 0x02, 0x01, 0x51, 0x09, 0x06 }, // ?
+	{ 0x32, 0x49, 0x79, 0x41, 0x3E }, // @
+	{ 0x7E, 0x11, 0x11, 0x11, 0x7E }, // A
+	{ 0x7F, 0x49, 0x49, 0x49, 0x36 }, // B
+	{ 0x3E, 0x41, 0x41, 0x41, 0x22 }, // C
+	{ 0x7F, 0x41, 0x41, 0x22, 0x1C }, // D
+	{ 0x7F, 0x49, 0x49, 0x49, 0x41 }, // E
+	{ 0x7F, 0x09, 0x09, 0x09, 0x01 }, // F
+	{ 0x3E, 0x41, 0x49, 0x49, 0x7A }, // G
+	{ 0x7F, 0x08, 0x08, 0x08, 0x7F }, // H
+	{ 0x00, 0x41, 0x7F, 0x41, 0x00 }, // I
+	{ 0x20, 0x40, 0x41, 0x3F, 0x01 }, // J
+	{ 0x7F, 0x08, 0x14, 0x22, 0x41 }, // K
+	{ 0x7F, 0x40, 0x40, 0x40, 0x40 }, // L
+	{ 0x7F, 0x02, 0x0C, 0x02, 0x7F }, // M
+	{ 0x7F, 0x04, 0x08, 0x10, 0x7F }, // N
+	{ 0x3E, 0x41, 0x41, 0x41, 0x3E }, // O
+	{ 0x7F, 0x09, 0x09, 0x09, 0x06 }, // P
+	{ 0x3E, 0x41, 0x51, 0x21, 0x5E }, // Q
+	{ 0x7F, 0x09, 0x19, 0x29, 0x46 }, // R
+	{ 0x46, 0x49, 0x49, 0x49, 0x31 }, // S
+	{ 0x01, 0x01, 0x7F, 0x01, 0x01 }, // T
+	{ 0x3F, 0x40, 0x40, 0x40, 0x3F }, // U
+	{ 0x1F, 0x20, 0x40, 0x20, 0x1F }, // V
+	{ 0x3F, 0x40, 0x38, 0x40, 0x3F }, // W
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, // X
+	{ 0x07, 0x08, 0x70, 0x08, 0x07 }, // Y
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, // Z
+	{ 0x00, 0x7F, 0x41, 0x41, 0x00 }, // [
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, // backslash
+	{ 0x00, 0x41, 0x41, 0x7F, 0x00 }, // ]
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, // ^
+	{ 0x40, 0x40, 0x40, 0x40, 0x40 }, // _
+	{ 0x00, 0x01, 0x02, 0x04, 0x00 }, // `
+	{ 0x20, 0x54, 0x54, 0x54, 0x78 }, // a
+	{ 0x7F, 0x48, 0x44, 0x44, 0x38 }, // b
+	{ 0x38, 0x44, 0x44, 0x44, 0x20 }, // c
+	{ 0x38, 0x44, 0x44, 0x48, 0x7F }, // d
+	{ 0x38, 0x54, 0x54, 0x54, 0x18 }, // e
+	{ 0x08, 0x7E, 0x09, 0x01, 0x02 }, // f
+	{ 0x0C, 0x52, 0x52, 0x52, 0x3E }, // g
+	{ 0x7F, 0x08, 0x04, 0x04, 0x78 }, // h
+	{ 0x00, 0x44, 0x7D, 0x40, 0x00 }, // i
+	{ 0x20, 0x40, 0x44, 0x3D, 0x00 }, // j
+	{ 0x7F, 0x10, 0x28, 0x44, 0x00 }, // k
+	{ 0x00, 0x41, 0x7F, 0x40, 0x00 }, // l
+	{ 0x7C, 0x04, 0x18, 0x04, 0x78 }, // m
+	{ 0x7C, 0x08, 0x04, 0x04, 0x78 }, // n
+	{ 0x38, 0x44, 0x44, 0x44, 0x38 }, // o
+	{ 0x7C, 0x14, 0x14, 0x14, 0x08 }, // p
+	{ 0x08, 0x14, 0x14, 0x18, 0x7C }, // q
+	{ 0x7C, 0x08, 0x04, 0x04, 0x08 }, // r
+	{ 0x48, 0x54, 0x54, 0x54, 0x20 }, // s
+	{ 0x04, 0x3F, 0x44, 0x40, 0x20 }, // t
+	{ 0x3C, 0x40, 0x40, 0x20, 0x7C }, // u
+	{ 0x1C, 0x20, 0x40, 0x20, 0x1C }, // v
+	{ 0x3C, 0x40, 0x30, 0x40, 0x3C }, // w
+	{ 0x44, 0x28, 0x10, 0x28, 0x44 }, // x
+	{ 0x0C, 0x50, 0x50, 0x50, 0x3C }, // y
+	{ 0x44, 0x64, 0x54, 0x4C, 0x44 }, // z
+	{ 0x00, 0x08, 0x36, 0x41, 0x00 }, // {
+	{ 0x00, 0x00, 0x7F, 0x00, 0x00 }, // |
+	{ 0x00, 0x41, 0x36, 0x08, 0x00 }, // }
+	{ 0x08, 0x04, 0x08, 0x10, 0x08 }  // ~
+};
+
+// Dots of a glyph column, anything outside printable ASCII shows as '?'
+inline uint8_t GlyphColumn(char c, int column)
+{
+	unsigned char index = (unsigned char)c;
+	if (index < 0x20 || index > 0x7E)
+		index = '?';
+	return Font5x7[index - 0x20][column];
+}
+
+// Text left aligned at left and vertically centered on middle. Glyphs are 5x7 dots
+// in a 6x8 cell, each dot a square of fontSize / 8 pixels covering what it overlaps.
+void DrawText(OverlayLayer& layer, const std::string& text, float left, float middle, float fontSize, uint32_t color)
+{
+	if (text.empty() || fontSize < 1)
+		return;
+
+	float dot = fontSize / 8;
+	float top = middle - dot * 7 / 2;
+	int columns = (int)text.size() * 6;
+
+	Fill(layer, left - 1, top - 1, left + columns * dot + 1, top + 7 * dot + 1, color, [&](float x, float y) {
+		// Pixel square in dot units
+		float px0 = (x - 0.5f - left) / dot;
+		float px1 = (x + 0.5f - left) / dot;
+		float py0 = (y - 0.5f - top) / dot;
+		float py1 = (y + 0.5f - top) / dot;
+
+		int c0 = std::max(0, (int)floorf(px0));
+		int c1 = std::min(columns - 1, (int)floorf(px1));
+		int r0 = std::max(0, (int)floorf(py0));
+		int r1 = std::min(6, (int)floorf(py1));
+
+		float covered = 0;
+		for (int c = c0; c <= c1; ++c)
+		{
+			// Spacing column between glyphs
+			if (c % 6 == 5)
+				continue;
+			uint8_t dots = GlyphColumn(text[c / 6], c % 6);
+			float width = std::min(px1, (float)(c + 1)) - std::max(px0, (float)c);
+			for (int r = r0; r <= r1; ++r)
+				if (dots & (1 << r))
+					covered += width * (std::min(py1, (float)(r + 1)) - std::max(py0, (float)r));
+		}
+
+		// Overlap is in dots squared, the pixel is dot * dot of them
+		covered *= dot * dot;
+		return covered > 1 ? 1.0f : covered;
+	});
+}
+
+#ifdef VIDEO_OVERLAY_SSE2
+// Blend four premultiplied pixels over four surface ones
+inline __m128i BlendSSE2(__m128i src, __m128i dst)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i max = _mm_set1_epi16(255);
+	const __m128i round = _mm_set1_epi16(128);
+	const __m128i scale = _mm_set1_epi16(257);
+
+	// Alpha of each pixel on its four channels
+	__m128i srcLo = _mm_unpacklo_epi8(src, zero);
+	__m128i srcHi = _mm_unpackhi_epi8(src, zero);
+	__m128i alphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcLo, 0xFF), 0xFF);
+	__m128i alphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(srcHi, 0xFF), 0xFF);
+
+	// dst * (255 - alpha) / 255, same rounding as Div255
+	__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), _mm_sub_epi16(max, alphaLo)), round);
+	__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), _mm_sub_epi16(max, alphaHi)), round);
+	lo = _mm_mulhi_epu16(lo, scale);
+	hi = _mm_mulhi_epu16(hi, scale);
+
+	return _mm_adds_epu8(_mm_packus_epi16(lo, hi), src);
+}
+#endif
+
+inline void BlendPixel(const uint8_t* src, uint8_t* dst)
+{
+	uint32_t inverse = 255 - src[3];
+	for (int i = 0; i < 4; ++i)
+		dst[i] = (uint8_t)std::min<uint32_t>(255, src[i] + Div255(dst[i] * inverse));
+}
+
+}
+
+bool ParseOverlayColor(const std::string& text, uint32_t& rgb)
+{
+	if ((text.size() != 4 && text.size() != 7) || text[0] != '#')
+		return false;
+
+	uint32_t value = 0;
+	for (size_t i = 1; i < text.size(); ++i)
+	{
+		char c = text[i];
+		uint32_t digit;
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			digit = c - 'A' + 10;
+		else
+			return false;
+
+		// Short form repeats each digit, #f80 is #ff8800
+		value = text.size() == 4 ? (value << 8) | (digit << 4) | digit : (value << 4) | digit;
+	}
+
+	rgb = value;
+	return true;
+}
+
+bool RasterizeOverlay(const std::vector<OverlayShape>& shapes, OverlayLayer& layer, int width, int height)
+{
+	if (!layer.image.Reserve(width, height))
+		return false;
+
+	memset(layer.image.image, 0, layer.image.stride * layer.image.height);
+	layer.rowStart.assign(height, 0);
+	layer.rowEnd.assign(height, 0);
+
+	for (const OverlayShape& shape : shapes)
+	{
+		// Fully transparent or too thin to be seen, anchors may still have text
+		bool text = shape.type == OverlayShape::Type::Anchor && !shape.text.empty();
+		if (!(shape.color >> 24) || (shape.lineWidth <= 0 && !text))
+			continue;
+
+		float x1 = shape.x1 * width;
+		float y1 = shape.y1 * height;
+		float x2 = shape.x2 * width;
+		float y2 = shape.y2 * height;
+
+		switch (shape.type)
+		{
+		case OverlayShape::Type::Line:
+		{
+			Segment line = { x1, y1, x2, y2 };
+			StrokeSegments(layer, &line, 1, shape.lineWidth, shape.color);
+			break;
+		}
+		case OverlayShape::Type::Arrow:
+		{
+			// Head wings 30 degrees off the shaft, sized after the stroke
+			float dx = x2 - x1;
+			float dy = y2 - y1;
+			float length = sqrtf(dx * dx + dy * dy);
+			float head = std::min(length, shape.lineWidth * 4 + 6);
+			float ux = length > 0 ? dx / length : 1;
+			float uy = length > 0 ? dy / length : 0;
+			const float cos30 = 0.8660254f;
+			const float sin30 = 0.5f;
+
+			Segment arrow[3] = {
+				{ x1, y1, x2, y2 },
+				{ x2, y2, x2 - head * (ux * cos30 - uy * sin30), y2 - head * (uy * cos30 + ux * sin30) },
+				{ x2, y2, x2 - head * (ux * cos30 + uy * sin30), y2 - head * (uy * cos30 - ux * sin30) }
+			};
+			StrokeSegments(layer, arrow, 3, shape.lineWidth, shape.color);
+			break;
+		}
+		case OverlayShape::Type::Circle:
+		{
+			float radius = shape.radius * width;
+			float half = shape.lineWidth / 2;
+			float reach = radius + half + 1;
+			Fill(layer, x1 - reach, y1 - reach, x1 + reach, y1 + reach, shape.color, [&](float x, float y) {
+				float distance = sqrtf((x - x1) * (x - x1) + (y - y1) * (y - y1));
+				return Coverage(fabsf(distance - radius) - half);
+			});
+			break;
+		}
+		case OverlayShape::Type::Anchor:
+		{
+			float radius = std::max(0.0f, shape.lineWidth / 2);
+			if (radius > 0)
+			{
+				float reach = radius + 1;
+				Fill(layer, x1 - reach, y1 - reach, x1 + reach, y1 + reach, shape.color, [&](float x, float y) {
+					float distance = sqrtf((x - x1) * (x - x1) + (y - y1) * (y - y1));
+					return Coverage(distance - radius);
+				});
+			}
+
+			// Label a quarter of its height away from the dot
+			DrawText(layer, shape.text, x1 + radius + shape.fontSize / 4, y1, shape.fontSize, shape.color);
+			break;
+		}
+		}
+	}
+
+	return true;
+}
+
+void BlendOverlay(VideoBuffer& surface, const OverlayLayer& layer)
+{
+	// Layer is drawn for a surface of a given size
+	if (surface.width != layer.image.width || surface.height != layer.image.height || layer.rowEnd.size() != surface.height)
+		return;
+
+	for (size_t y = 0; y < surface.height; ++y)
+	{
+		int x = layer.rowStart[y];
+		int right = layer.rowEnd[y];
+		if (x >= right)
+			continue;
+
+		const uint8_t* src = layer.image.image + y * layer.image.stride;
+		uint8_t* dst = surface.image + y * surface.stride;
+
+#ifdef VIDEO_OVERLAY_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 4 <= right; x += 4)
+		{
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(src + x * 4));
+
+			// Gaps between shapes on the same row
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, zero)) == 0xFFFF)
+				continue;
+
+			__m128i under = _mm_loadu_si128((const __m128i*)(dst + x * 4));
+			_mm_storeu_si128((__m128i*)(dst + x * 4), BlendSSE2(pixels, under));
+		}
+#endif
+		for (; x < right; ++x)
+			if (src[x * 4 + 3])
+				BlendPixel(src + x * 4, dst + x * 4);
+	}
+}
+
+void VideoOverlay::SetShapes(std::vector<OverlayShape> shapes)
+{
+	auto list = shapes.empty() ? nullptr : std::make_shared<const std::vector<OverlayShape>>(std::move(shapes));
+
+	std::lock_guard<std::mutex> lock(state->mutex);
+	state->shapes = list;
+	state->shapesGeneration++;
+
+	// Removed at once, new shapes wait for their layer
+	if (!list)
+	{
+		state->layer = nullptr;
+		state->ready++;
+	}
+}
+
+void VideoOverlay::Apply(VideoBuffer& surface, WorkerPool& pool)
+{
+	std::shared_ptr<const std::vector<OverlayShape>> shapes;
+	std::shared_ptr<const OverlayLayer> layer;
+	uint64_t shapesGeneration;
+	bool request = false;
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		shapes = state->shapes;
+		layer = state->layer;
+		shapesGeneration = state->shapesGeneration;
+
+		// Shapes or size changed since the last request
+		if (shapes && (state->requestedShapes != shapesGeneration || state->requestedWidth != surface.width || state->requestedHeight != surface.height))
+		{
+			state->requestedShapes = shapesGeneration;
+			state->requestedWidth = surface.width;
+			state->requestedHeight = surface.height;
+			request = true;
+		}
+	}
+
+	if (request)
+	{
+		std::shared_ptr<State> shared = state;
+		int width = (int)surface.width;
+		int height = (int)surface.height;
+		auto rasterize = [shared, shapes, shapesGeneration, width, height]() {
+			auto drawn = std::make_shared<OverlayLayer>();
+			if (!RasterizeOverlay(*shapes, *drawn, width, height))
+				return;
+			shared->rasterized++;
+
+			// Dropped if the shapes changed meanwhile, a newer one is on its way
+			std::lock_guard<std::mutex> lock(shared->mutex);
+			if (shared->shapesGeneration != shapesGeneration)
+				return;
+			shared->layer = drawn;
+			shared->ready++;
+		};
+
+		// Pool already stopped, draw it here
+		if (!pool.Post(rasterize))
+			rasterize();
+	}
+
+	// Previous layer until the new one is ready, BlendOverlay skips it if the size changed
+	if (layer)
+		BlendOverlay(surface, *layer);
+}
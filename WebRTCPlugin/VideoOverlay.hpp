@@ -0,0 +1,98 @@
+#ifndef VIDEO_OVERLAY_HPP
+#define VIDEO_OVERLAY_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "VideoFrameStore.hpp"
+#include "WorkerPool.hpp"
+
+// Vector annotation drawn over the video. Positions are normalized to the
+// displayed image, 0 to 1 from left to right and top to bottom.
+struct OverlayShape
+{
+	enum class Type
+	{
+		Line,
+		Arrow,	// From the first point, head on the second one
+		Circle,	// Centered on the first point
+		Anchor	// Filled dot on the first point with its text to the right
+	};
+
+	Type type = Type::Line;
+	float x1 = 0;
+	float y1 = 0;
+	float x2 = 0;
+	float y2 = 0;
+	// Circle radius, normalized to the image width
+	float radius = 0;
+	// Stroke width, or anchor dot diameter, in pixels
+	float lineWidth = 3;
+	// Anchor label, printable ASCII, and its height in pixels
+	std::string text;
+	float fontSize = 16;
+	// Straight, not premultiplied, ARGB
+	uint32_t color = 0xFFFF0000;
+};
+
+// Premultiplied ARGB annotations, with the columns they touch on each row
+struct OverlayLayer
+{
+	VideoBuffer image;
+	// Drawn pixels of row y are in [rowStart[y], rowEnd[y]), none when equal
+	std::vector<int> rowStart;
+	std::vector<int> rowEnd;
+};
+
+// Parse a "#rgb" or "#rrggbb" CSS color into 0xRRGGBB, false if malformed
+bool ParseOverlayColor(const std::string& text, uint32_t& rgb);
+
+// Draw anti-aliased shapes on a transparent layer of the given size
+bool RasterizeOverlay(const std::vector<OverlayShape>& shapes, OverlayLayer& layer, int width, int height);
+
+// Blend a layer of the same size over the surface, only touching the drawn spans
+void BlendOverlay(VideoBuffer& surface, const OverlayLayer& layer);
+
+// Shapes can be replaced from any thread. They are rasterized on a worker pool
+// once per change or surface size, the writer only blends the cached layer.
+class VideoOverlay
+{
+public:
+	// Any thread, an empty list removes the overlay
+	void SetShapes(std::vector<OverlayShape> shapes);
+
+	// Increased when a new layer is ready or the overlay is removed, so unchanged
+	// frames can be shown again with it
+	uint64_t GetGeneration() const { return state->ready; }
+
+	// Writer thread, blend the ready layer over a converted surface. A layer for new
+	// shapes or a new size is requested from the pool, the previous one is kept until then.
+	void Apply(VideoBuffer& surface, WorkerPool& pool);
+
+	uint64_t GetRasterized() const { return state->rasterized; }
+
+private:
+	// Shared with pending rasterizations, which may end after the overlay is gone
+	struct State
+	{
+		std::mutex mutex;
+		std::shared_ptr<const std::vector<OverlayShape>> shapes;
+		uint64_t shapesGeneration = 0;
+		std::shared_ptr<const OverlayLayer> layer;
+		// Shapes and size of the last requested rasterization
+		uint64_t requestedShapes = 0;
+		size_t requestedWidth = 0;
+		size_t requestedHeight = 0;
+		std::atomic<uint64_t> ready{ 0 };
+		std::atomic<uint64_t> rasterized{ 0 };
+	};
+
+	std::shared_ptr<State> state = std::make_shared<State>();
+};
+
+#endif
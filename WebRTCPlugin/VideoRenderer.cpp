@@ -3,10 +3,31 @@
 #include "LogSinkImpl.h"
 #include "WebRTCProxy.h"
 #include "VideoRenderer.h"
+#include "JSObject.h"
 #undef FOURCC
 #include "third_party/libyuv/include/libyuv.h"
 #include "api/video/i420_buffer.h"
+#include "rtc_base/time_utils.h"
 
+// Frames a single burst can hold, each one keeps a decoded frame alive until encoded
+static const int64_t MaxBurstFrames = 30;
+static const int64_t DefaultBurstFrames = 5;
+// How long a burst waits for its frames before returning the ones it has
+static const int64_t DefaultBurstTimeoutMs = 5000;
+static const int64_t MaxBurstTimeoutMs = 60000;
+
+// Sharpness events are scored on luma scaled down to this width, a fraction of a millisecond per frame
+static const int SharpnessEventWidth = 640;
+
+// Frames from this size up are converted on several threads when renderThreads is automatic
+static const int64_t ParallelRenderPixels = 1280 * 720;
+
+// A paint requested this long ago without happening means the window is hidden or minimized
+static const int64_t PaintStarvedUs = 500 * rtc::kNumMicrosecsPerMillisec;
+
+// What a hidden renderer asks for, enough to keep snapshots and sharpness current
+static const int HiddenPixelCount = 320 * 180;
+static const int HiddenFramerate = 1;
 
 HRESULT VideoRenderer::FinalConstruct()
 {
@@ -54,35 +75,159 @@ void VideoRenderer::OnFrame(const webrtc::VideoFrame& frame)
 		DispatchAsync(onresize, width, height);
 	}
 
-	// Only iOS rotated frames need to be adjusted.
-	webrtc::VideoFrame* clone = nullptr;
-	if (rotation == webrtc::kVideoRotation_90 ||
-		rotation == webrtc::kVideoRotation_180 ||
-	   	rotation == webrtc::kVideoRotation_270)
+	framesReceived++;
+
+	// Bursts take every distinct frame, regardless of rendering
 	{
-		// Apply rotation and clone video frame
-		webrtc::VideoFrame rotated_frame(frame);
-		rotated_frame.set_video_frame_buffer(
-				webrtc::I420Buffer::Rotate(*frame.video_frame_buffer()->GetI420(),
-				frame.rotation()));
-		rotated_frame.set_rotation(webrtc::kVideoRotation_0);
-		clone = new webrtc::VideoFrame(rotated_frame);
+		std::lock_guard<std::mutex> lock(burstMutex);
+		if (burst && burst->AddFrame(frame.video_frame_buffer()->ToI420(), frame.rotation(), frame.timestamp_us()))
+		{
+			burst->Start(*WebRTCProxy::GetEncoderPool());
+			burst = nullptr;
+		}
 	}
-	else
-		clone = new webrtc::VideoFrame(frame);
 
-	// Store clone as background frame
-	mutex.lock();
+	// Sharpness events at their own rate
+	double sharpnessFps = sharpnessRate;
+	if (sharpnessFps > 0)
+	{
+		int64_t now = rtc::TimeMicros();
+		if (now >= nextSharpnessUs)
+		{
+			nextSharpnessUs = now + (int64_t)(rtc::kNumMicrosecsPerSec / sharpnessFps);
+
+			auto yuv = frame.video_frame_buffer()->ToI420();
+			variant_t score = sharpnessScorer.Score(yuv->DataY(), yuv->StrideY(), yuv->width(), yuv->height(), SharpnessEventWidth);
+			variant_t timestamp = frame.timestamp_us() / 1000.0;
+			DispatchAsync(onsharpness, score, timestamp);
+		}
+	}
+
+	// Keep source frame for snapshots, rotation is applied while converting
+	RenderedFrame rendered;
+	rendered.yuv = frame.video_frame_buffer()->ToI420();
+	rendered.rotation = frame.rotation();
+	rendered.timestampUs = frame.timestamp_us();
+
+	// Snapshots take the newest frame even when it is not going to be painted
+	{
+		std::lock_guard<std::mutex> lock(latestMutex);
+		latest = rendered;
+	}
+
+	// Nobody is looking, only the reference above is kept. Last stored surface is kept for resuming.
+	if (!IsVisible())
+	{
+		framesHidden++;
+		FUNC_END();
+		return;
+	}
+
+	// Render rate governor, drop before doing any work
+	int fps = maxRenderFps;
+	if (fps > 0)
+	{
+		int64_t now = rtc::TimeMicros();
+		int64_t interval = rtc::kNumMicrosecsPerSec / fps;
+
+		// Too early for next one
+		int64_t next = nextRenderUs;
+		if (now < next)
+		{
+			framesSkipped++;
+			FUNC_END();
+			return;
+		}
+
+		// Keep a steady cadence unless we fell behind
+		nextRenderUs = now - next < interval ? next + interval : now + interval;
+	}
+
+	// Smooth out jitter, late frames are dropped here before being converted.
+	// Checked and pushed under the lock so a queue being turned off is not restarted.
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (renderQueue)
+		{
+			scheduler.Push(rendered.timestampUs, rendered);
+			queued = true;
+		}
+	}
+
+	if (!queued)
+		RenderFrame(rendered);
+
+	FUNC_END();
+}
+
+void VideoRenderer::RenderFrame(const RenderedFrame& rendered)
+{
+	FUNC_BEGIN();
+
+	// Delivery and scheduler threads only overlap while switching the queue
+	std::lock_guard<std::mutex> lock(renderMutex);
+
+	// Only iOS rotated frames need to be adjusted.
+	RenderOptions options;
+	options.targetWidth = displayWidth;
+	options.targetHeight = displayHeight;
+	options.filter = scaleFilter;
+	options.rotation = rendered.rotation;
+	options.mirror = mirror;
+
+	auto yuv = rendered.yuv;
+
+	// Layout and overlay changes need a new surface even for an unchanged picture
+	uint64_t overlayGeneration = overlay.GetGeneration();
+	if (options.targetWidth != storedOptions.targetWidth ||
+		options.targetHeight != storedOptions.targetHeight ||
+		options.filter != storedOptions.filter ||
+		options.rotation != storedOptions.rotation ||
+		options.mirror != storedOptions.mirror ||
+		overlayGeneration != storedOverlay)
+	{
+		staticDetector.Reset();
+		storedOptions = options;
+		storedOverlay = overlayGeneration;
+	}
 
-	frames[background] = std::shared_ptr<webrtc::VideoFrame>(clone);
+	// Nothing moved since the stored frame, keep showing it
+	double threshold = staticThreshold;
+	if (threshold >= 0 && staticDetector.IsStatic(yuv->DataY(), yuv->StrideY(), yuv->width(), yuv->height(), threshold))
+	{
+		framesStatic++;
+		FUNC_END();
+		return;
+	}
 
-	// Move background buffer to foreground
-	background = !background;
+	// Slice big frames across the render pool
+	auto& pool = WebRTCProxy::GetRenderPool();
+	int threads = renderThreads;
+	if (!threads)
+		threads = (int64_t)yuv->width() * yuv->height() >= ParallelRenderPixels ? (int)pool->GetSize() + 1 : 1;
+	store.SetThreads(pool.get(), threads);
 
-	mutex.unlock();
+	// Convert once on arrival, scaled down to the display size, and hand it
+	// to the UI thread, painting only blits the stored surface
+	store.Store(
+		yuv->DataY(),
+		yuv->StrideY(),
+		yuv->DataU(),
+		yuv->StrideU(),
+		yuv->DataV(),
+		yuv->StrideV(),
+		yuv->width(),
+		yuv->height(),
+		options,
+		rendered,
+		[this, &pool](VideoBuffer& surface) {
+			// Annotations are rasterized on the pool once per change and blended on every frame
+			overlay.Apply(surface, *pool);
+		});
 	
 	// Redraw
-	::InvalidateRect(hwndParent, NULL, 0);
+	Invalidate();
 
 	FUNC_END();
 }
@@ -118,102 +263,143 @@ HRESULT VideoRenderer::OnDrawAdvanced(ATL_DRAWINFO& di)
 	// Delete black brush
 	DeleteObject(hBrush);
 
-	// Lock
-	mutex.lock();
-
-	// Get foreground buffer
-	std::shared_ptr<webrtc::VideoFrame> frame(frames[!background]);
+	// Let next frames be scaled to the display size before conversion
+	displayWidth = rc->right - rc->left;
+	displayHeight = rc->bottom - rc->top;
+	UpdateSinkWants();
 
-	// Unlock
-	mutex.unlock();
-
-	// Check if we have a frame already
-	if (!frame)
-		FUNC_END_RET_S(S_OK);
-
-	// Get width and height
-	int width = frame->width();
-	int height = frame->height();
+	// Set stretching mode
+	int oldMode = SetStretchBltMode(hdc, HALFTONE);
 
-	// Get I420 data
-	auto yuv = frame->video_frame_buffer()->ToI420();
+	// Check if we are going to show a new frame
+	if (store.HasNewFrame())
+		framesPainted++;
 
-	// Create ARGB data
-	uint8_t* rgb = (uint8_t*)malloc(width * height * 4);
+	// Blit latest converted surface, if any
+	store.Read([&](const VideoFrameStore<RenderedFrame>::Frame& frame) {
+		const VideoBuffer& buffer = frame.surface;
 
-	// Convert to rgb
-	libyuv::I420ToARGB(
-		yuv->DataY(),
-		yuv->StrideY(),
-		yuv->DataU(),
-		yuv->StrideU(),
-		yuv->DataV(),
-		yuv->StrideV(),
-		rgb,
-		width * 4,
-		width,
-		height);
+		// Already at display size, just copy it
+		if ((int)buffer.width == displayWidth && (int)buffer.height == displayHeight)
+		{
+			BITMAPINFO info = { 0 };
+			info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+			info.bmiHeader.biWidth = buffer.width;
+			info.bmiHeader.biHeight = -(LONG)buffer.height;
+			info.bmiHeader.biPlanes = 1;
+			info.bmiHeader.biBitCount = 32;
+			info.bmiHeader.biCompression = BI_RGB;
+
+			SetDIBitsToDevice(
+				hdc,
+				rc->left,
+				rc->top,
+				buffer.width,
+				buffer.height,
+				0,
+				0,
+				0,
+				buffer.height,
+				buffer.image,
+				&info,
+				DIB_RGB_COLORS
+			);
+			return;
+		}
 
-	// Set stretching mode
-	int oldMode = SetStretchBltMode(hdc, HALFTONE);
+		// Create bitmap
+		BITMAPINFO info;
+		info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+		info.bmiHeader.biWidth = buffer.width;
+		info.bmiHeader.biHeight = buffer.height;
+		info.bmiHeader.biPlanes = 1;
+		info.bmiHeader.biBitCount = 32;
+		info.bmiHeader.biCompression = BI_RGB;
+		info.bmiHeader.biSizeImage = 0;
+		info.bmiHeader.biXPelsPerMeter = 0;
+		info.bmiHeader.biYPelsPerMeter = 0;
+		info.bmiHeader.biClrUsed = 0;
+		info.bmiHeader.biClrImportant = 0;
+
+		// Fill rect
+		int xDest = rc->left;
+		int yDest = rc->bottom;
+		int wDest = rc->right - rc->left;
+		int hDest = rc->top - rc->bottom;
+
+		// Copy & stretch
+		StretchDIBits(
+			hdc,
+			xDest,
+			yDest,
+			wDest,
+			hDest,
+			0,
+			0,
+			buffer.width,
+			buffer.height,
+			buffer.image,
+			&info,
+			DIB_RGB_COLORS,
+			SRCCOPY
+		);
+	});
 
-	// Create bitmap
-	BITMAPINFO info;
-	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-	info.bmiHeader.biWidth = width;;
-	info.bmiHeader.biHeight = height;
-	info.bmiHeader.biPlanes = 1;
-	info.bmiHeader.biBitCount = 32;
-	info.bmiHeader.biCompression = BI_RGB;
-	info.bmiHeader.biSizeImage = 0;
-	info.bmiHeader.biXPelsPerMeter = 0;
-	info.bmiHeader.biYPelsPerMeter = 0;
-	info.bmiHeader.biClrUsed = 0;
-	info.bmiHeader.biClrImportant = 0;
-
-	// Fill rect
-	int xDest = rc->left;
-	int yDest = rc->bottom;
-	int wDest = rc->right - rc->left;
-	int hDest = rc->top - rc->bottom;
-
-	// Copy & stretch
-	StretchDIBits(
-		hdc,
-		xDest,
-		yDest,
-		wDest,
-		hDest,
-		0,
-		0,
-		width,
-		height,
-		rgb,
-		&info,
-		DIB_RGB_COLORS,
-		SRCCOPY
-	);
-
-	// Clean rgb data
-	free(rgb);
-	
 	// Restore stretching mode
 	SetStretchBltMode(hdc, oldMode);
 
+	// Allow next invalidation, issuing it now if a frame arrived while painting
+	paintPending = false;
+	if (store.HasNewFrame())
+		Invalidate();
+
 	FUNC_END_RET_S(S_OK);
 }
 
+void VideoRenderer::Invalidate()
+{
+	// Not in place active yet, first paint will pick up the latest frame
+	if (!hwndParent)
+		return;
+
+	// Previous paint has not happened yet, it will pick up the latest frame
+	if (paintPending.exchange(true))
+		return;
+
+	paintRequestedUs = rtc::TimeMicros();
+
+	RECT rect;
+	{
+		std::lock_guard<std::mutex> lock(rectMutex);
+		rect = controlRect;
+	}
+
+	// Only our own area, once we know it
+	::InvalidateRect(hwndParent, ::IsRectEmpty(&rect) ? NULL : &rect, FALSE);
+}
+
 STDMETHODIMP VideoRenderer::setTrack(VARIANT track)
 {
 	FUNC_BEGIN();
 
+	//Detach from the current track
+	if (track.vt == VT_NULL || track.vt == VT_EMPTY || (track.vt == VT_DISPATCH && !V_DISPATCH(&track)))
+	{
+		if (videoTrack)
+			videoTrack->RemoveSink(this);
+		videoTrack = nullptr;
+
+		// No more frames for a running burst
+		FinishBurst();
+
+		FUNC_END_RET_S(S_OK);
+	}
+
 	//Get dispatch interface
 	if (track.vt != VT_DISPATCH)
 		FUNC_END_RET_S(E_INVALIDARG);
 
 	IDispatch* disp = V_DISPATCH(&track);
-	if (!disp)
-		FUNC_END_RET_S(E_INVALIDARG);
 
 	//Get atl com object from track.
 	CComPtr<ITrackAccess> proxy;
@@ -222,224 +408,610 @@ STDMETHODIMP VideoRenderer::setTrack(VARIANT track)
 		FUNC_END_RET_S(hr);
 
 	//Convert to video
-	webrtc::VideoTrackInterface* videoTrack = reinterpret_cast<webrtc::VideoTrackInterface*>(proxy->GetTrack().get());
-	if (!videoTrack)
+	webrtc::VideoTrackInterface* track = reinterpret_cast<webrtc::VideoTrackInterface*>(proxy->GetTrack().get());
+	if (!track)
 		FUNC_END_RET_S(E_INVALIDARG);
 
-	//Add us as video 
-	rtc::VideoSinkWants wanted;
-	wanted.rotation_applied = true;
-	videoTrack->AddOrUpdateSink(this, wanted);
+	//Remove us from previous one
+	if (videoTrack && videoTrack.get() != track)
+		videoTrack->RemoveSink(this);
+
+	videoTrack = track;
+
+	//Add us as video, forcing wants to be sent
+	wantedPixelCount = wantedFramerate = -1;
+	UpdateSinkWants();
 
 	FUNC_END_RET_S(S_OK);
 }
 
-//////////////////////////////////////////////////////////////////////////
+void VideoRenderer::UpdateSinkWants()
+{
+	if (!videoTrack)
+		return;
 
-static const std::string base64_chars =
-	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	rtc::VideoSinkWants wanted;
+	wanted.rotation_applied = true;
 
-std::string base64_encode(BYTE const* bytes_to_encode, unsigned int in_len)
-{
-	std::string ret;
-	int i = 0;
-	int j = 0;
-	unsigned char char_array_3[3];
-	unsigned char char_array_4[4];
+	int width = displayWidth;
+	int height = displayHeight;
 
-	while (in_len--)
+	// Not laid out yet, take whatever the source sends
+	if (width < 0 || height < 0)
 	{
-		char_array_3[i++] = *(bytes_to_encode++);
-		if (i == 3)
-		{
-			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-			char_array_4[3] = char_array_3[2] & 0x3f;
-
-			for (i = 0; (i < 4); i++)
-				ret += base64_chars[char_array_4[i]];
-			i = 0;
-		}
+		// Use defaults
+	}
+	else
+	{
+		// No need for more pixels than the element has
+		wanted.max_pixel_count = width * height;
+
+		// Nor for more frames than we are going to render
+		if (maxRenderFps > 0)
+			wanted.max_framerate_fps = maxRenderFps;
 	}
 
-	if (i)
+	// Nobody is looking, let the source send a trickle until shown again. A window
+	// that stops painting is only noticed on delivery, so its frames are dropped there.
+	if (!active || clipped || paused)
 	{
-		for (j = i; j < 3; j++)
-			char_array_3[j] = '\0';
+		if (wanted.max_pixel_count > HiddenPixelCount)
+			wanted.max_pixel_count = HiddenPixelCount;
+		wanted.max_framerate_fps = HiddenFramerate;
+	}
 
-		char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-		char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-		char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-		char_array_4[3] = char_array_3[2] & 0x3f;
+	// Nothing changed
+	if (wanted.max_pixel_count == wantedPixelCount && wanted.max_framerate_fps == wantedFramerate)
+		return;
 
-		for (j = 0; (j < i + 1); j++)
-			ret += base64_chars[char_array_4[j]];
+	wantedPixelCount = wanted.max_pixel_count;
+	wantedFramerate = wanted.max_framerate_fps;
 
-		while ((i++ < 3))
-			ret += '=';
+	RTC_LOG(LS_INFO) << "updating sink wants [max_pixel_count:" << wanted.max_pixel_count
+	                 << ", max_framerate_fps:" << wanted.max_framerate_fps << "]";
+
+	videoTrack->AddOrUpdateSink(this, wanted);
+}
+
+STDMETHODIMP VideoRenderer::get_scaleFilter(VARIANT* val)
+{
+	const char* name;
+	switch (scaleFilter)
+	{
+	case ScaleFilter::None:
+		name = "none";
+		break;
+	case ScaleFilter::Linear:
+		name = "linear";
+		break;
+	case ScaleFilter::Bilinear:
+		name = "bilinear";
+		break;
+	default:
+		name = "box";
+		break;
 	}
 
-	return ret;
+	variant_t out = name;
+	VariantInit(val);
+	val->vt = VT_BSTR;
+	val->bstrVal = SysAllocString(out.bstrVal);
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_scaleFilter(VARIANT val)
+{
+	if (val.vt != VT_BSTR)
+		return E_INVALIDARG;
+
+	std::string name = (char*)_bstr_t(val);
+	if (name == "none")
+		scaleFilter = ScaleFilter::None;
+	else if (name == "linear")
+		scaleFilter = ScaleFilter::Linear;
+	else if (name == "bilinear")
+		scaleFilter = ScaleFilter::Bilinear;
+	else if (name == "box")
+		scaleFilter = ScaleFilter::Box;
+	else
+		return E_INVALIDARG;
+
+	return S_OK;
 }
 
-//////////////////////////////////////////////////////////////////////////
+STDMETHODIMP VideoRenderer::get_mirror(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_BOOL;
+	val->boolVal = mirror ? VARIANT_TRUE : VARIANT_FALSE;
 
-bool GetEncoderClsid(std::wstring format, CLSID* pClsid)
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_mirror(VARIANT val)
 {
-	UINT num = 0;          // number of image encoders
-	UINT size = 0;         // size of the image encoder array in bytes
+	if (val.vt == VT_BOOL)
+		mirror = val.boolVal == VARIANT_TRUE;
+	else
+		mirror = GetInt(&val, 0) != 0;
 
-	Gdiplus::ImageCodecInfo* pImageCodecInfo = NULL;
+	return S_OK;
+}
 
-	Gdiplus::GetImageEncodersSize(&num, &size);
-	if (size == 0)
-		return false;
+STDMETHODIMP VideoRenderer::get_maxRenderFps(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_I4;
+	val->lVal = maxRenderFps;
 
-	pImageCodecInfo = (Gdiplus::ImageCodecInfo*)(malloc(size));
-	if (pImageCodecInfo == NULL)
-		return false;
+	return S_OK;
+}
 
-	GetImageEncoders(num, size, pImageCodecInfo);
-	
-	for (UINT j = 0; j < num; ++j)
+STDMETHODIMP VideoRenderer::put_maxRenderFps(VARIANT val)
+{
+	int64_t fps = (int64_t)GetNumber(&val, -1);
+	if (fps < 0)
+		return E_INVALIDARG;
+
+	maxRenderFps = (int)fps;
+	nextRenderUs = 0;
+	UpdateSinkWants();
+
+	return S_OK;
+}
+
+SnapshotOptions VideoRenderer::ParseSnapshotOptions(VARIANT& variant)
+{
+	SnapshotOptions options;
+	JSObject obj(variant);
+
+	if (!obj.isNull())
 	{
-		if (_wcsicmp(pImageCodecInfo[j].MimeType, format.c_str()) == 0)
+		_bstr_t format = obj.GetStringProperty(L"format", "image/png");
+		options.mimeType = (wchar_t*)format;
+		options.quality = (int)obj.GetIntegerProperty(L"quality", JpegEncoder::DefaultQuality);
+		options.binary = obj.GetBooleanProperty(L"binary", false);
+
+		options.width = (int)obj.GetNumberProperty(L"width");
+		options.height = (int)obj.GetNumberProperty(L"height");
+
+		CComVariant region = obj.GetProperty(L"region");
+		JSObject rect(region);
+		if (!rect.isNull())
 		{
-			*pClsid = pImageCodecInfo[j].Clsid;
-			free(pImageCodecInfo);
-			return true;
+			options.region.x = (int)rect.GetNumberProperty(L"x");
+			options.region.y = (int)rect.GetNumberProperty(L"y");
+			options.region.width = (int)rect.GetNumberProperty(L"width");
+			options.region.height = (int)rect.GetNumberProperty(L"height");
 		}
 	}
 
-	free(pImageCodecInfo);
-	return false;
+	return options;
 }
 
 STDMETHODIMP VideoRenderer::getFrame(VARIANT* val)
 {
 	FUNC_BEGIN();
 
-	HRESULT hr = S_OK;
+	// Get latest frame, painted or not
+	RenderedFrame rendered = GetLatestFrame();
 
-	// Get foreground buffer
-	mutex.lock();
-	std::shared_ptr<webrtc::VideoFrame> frame(frames[false]);
-	mutex.unlock();
+	// Check if we have a frame already
+	if (!rendered.yuv)
+		FUNC_END_RET_S(S_OK);
+
+	_variant_t base64Bitmap;
+	HRESULT hr = EncodeSnapshot(*rendered.yuv, rendered.rotation, SnapshotOptions(), base64Bitmap);
+	if (SUCCEEDED(hr) && val != nullptr)
+	{
+		// Hand over the encoded BSTR, no copy
+		*val = base64Bitmap.Detach();
+	}
+
+	FUNC_END_RET_S(hr);
+}
+
+STDMETHODIMP VideoRenderer::getFrameBytes(VARIANT options, VARIANT* val)
+{
+	FUNC_BEGIN();
+
+	if (!val)
+		FUNC_END_RET_S(E_POINTER);
+
+	VariantInit(val);
+
+	// Get latest frame, painted or not
+	RenderedFrame rendered = GetLatestFrame();
 
 	// Check if we have a frame already
-	if (!frame)
+	if (!rendered.yuv)
+	{
+		val->vt = VT_NULL;
 		FUNC_END_RET_S(S_OK);
+	}
+
+	// Always raw bytes, encoded straight into the returned array
+	SnapshotOptions snapshotOptions = ParseSnapshotOptions(options);
+	snapshotOptions.binary = true;
+
+	_variant_t bytes;
+	HRESULT hr = EncodeSnapshot(*rendered.yuv, rendered.rotation, snapshotOptions, bytes);
+	if (SUCCEEDED(hr))
+		*val = bytes.Detach();
+
+	FUNC_END_RET_S(hr);
+}
 
-	// Get width and height
-	int width = videoWidth;
-	int height = videoHeight;
+STDMETHODIMP VideoRenderer::getFrameAsync(VARIANT options, VARIANT callback)
+{
+	FUNC_BEGIN();
 
-	int imageSize = width * height * 4;
+	if (callback.vt != VT_DISPATCH)
+		FUNC_END_RET_S(E_INVALIDARG);
 
-	// Get I420 data
-	auto yuv = frame->video_frame_buffer()->ToI420();
+	// Only take a reference to the latest frame here, all the work is done on the snapshot thread
+	RenderedFrame rendered = GetLatestFrame();
 
-	uint8_t* rgba = (uint8_t*)malloc(imageSize);
-	memset(rgba, 0x0, imageSize);
+	rtc::scoped_refptr<SnapshotTask> task = new SnapshotTask(GetThread(), callback, rendered.yuv, rendered.rotation, ParseSnapshotOptions(options));
 
-	// Convert to rgba
-	libyuv::I420ToARGB(
-		yuv->DataY(),
-		yuv->StrideY(),
-		yuv->DataU(),
-		yuv->StrideU(),
-		yuv->DataV(),
-		yuv->StrideV(),
-		rgba,
-		width * 4,
-		width,
-		height);
+	auto run = [task]() {
+		task->Run();
+	};
+	WebRTCProxy::GetSnapshotThread()->Post(RTC_FROM_HERE, new EventMessageHandler<rtc::RefCountInterface, decltype(run)>(run));
+
+	FUNC_END_RET_S(S_OK);
+}
+
+STDMETHODIMP VideoRenderer::getFrameBurst(VARIANT options, VARIANT callback)
+{
+	FUNC_BEGIN();
 
-	//////////////////////////////////////////////////////////////////////////
+	if (callback.vt != VT_DISPATCH)
+		FUNC_END_RET_S(E_INVALIDARG);
 
-	IStream* pStream = nullptr;
-	Gdiplus::Bitmap* bm = nullptr;
+	int64_t count = DefaultBurstFrames;
+	int64_t timeout = DefaultBurstTimeoutMs;
+	bool score = false;
 
-	CLSID clsid;
-	if (GetEncoderClsid(L"image/png", &clsid))
+	JSObject obj(options);
+	if (!obj.isNull())
 	{
-		bm = new Gdiplus::Bitmap(width, height, width * 4,
-			PixelFormat32bppARGB, rgba);
-#ifdef _DEBUG
-		bm->Save(L"C:\\test.png", &clsid, nullptr);
-#endif // _DEBUG
-		
-		hr = CreateStreamOnHGlobal(NULL, TRUE, &pStream);
-		if (FAILED(hr))
-		{
-			RTC_LOG(LS_INFO) << "failed to create snapshot stream";
-			goto clean_up;
-		}
+		count = obj.GetIntegerProperty(L"count", DefaultBurstFrames);
+		timeout = (int64_t)obj.GetNumberProperty(L"timeout", DefaultBurstTimeoutMs);
+		score = obj.GetBooleanProperty(L"sharpness", false);
+	}
 
-		auto st = bm->Save(pStream, &clsid);
-		if (st != Gdiplus::Ok)
-		{
-			RTC_LOG(LS_INFO) << "failed to save snapshot to stream";
-			goto clean_up;
-		}
+	if (count < 1 || count > MaxBurstFrames)
+		FUNC_END_RET_S(E_INVALIDARG);
+	if (timeout < 1 || timeout > MaxBurstTimeoutMs)
+		FUNC_END_RET_S(E_INVALIDARG);
 
-		ULARGE_INTEGER liSize = {0};
-		hr = IStream_Size(pStream, &liSize);
-		if (FAILED(hr))
-		{
-			RTC_LOG(LS_INFO) << "failed to get stream size";
-			goto clean_up;
-		}
+	rtc::scoped_refptr<BurstTask> task = new BurstTask(GetThread(), callback, (size_t)count, score, ParseSnapshotOptions(options));
 
-		ULARGE_INTEGER pos = { 0 };
-		LARGE_INTEGER liPos = { 0 };
-		hr = pStream->Seek(liPos, STREAM_SEEK_SET, &pos);
-		if (FAILED(hr))
-		{
-			RTC_LOG(LS_INFO) << "failed to set stream read position";
-			goto clean_up;
-		}
+	// Frames are collected as they arrive, a running burst returns what it has so far
+	rtc::scoped_refptr<BurstTask> previous;
+	{
+		std::lock_guard<std::mutex> lock(burstMutex);
+		previous = burst;
+		burst = task;
+	}
+
+	if (previous)
+		previous->Start(*WebRTCProxy::GetEncoderPool());
+
+	// Settle with what was collected if frames stop coming
+	auto expire = [task]() {
+		task->Start(*WebRTCProxy::GetEncoderPool());
+	};
+	WebRTCProxy::GetSnapshotThread()->PostDelayed(RTC_FROM_HERE, (int)timeout, new EventMessageHandler<rtc::RefCountInterface, decltype(expire)>(expire));
+
+	FUNC_END_RET_S(S_OK);
+}
+
+RenderedFrame VideoRenderer::GetLatestFrame()
+{
+	std::lock_guard<std::mutex> lock(latestMutex);
+	return latest;
+}
+
+void VideoRenderer::FinishBurst()
+{
+	rtc::scoped_refptr<BurstTask> pending;
+	{
+		std::lock_guard<std::mutex> lock(burstMutex);
+		pending = burst;
+		burst = nullptr;
+	}
+
+	if (pending)
+		pending->Start(*WebRTCProxy::GetEncoderPool());
+}
+
+STDMETHODIMP VideoRenderer::getSharpness(VARIANT options, VARIANT* val)
+{
+	FUNC_BEGIN();
+
+	if (!val)
+		FUNC_END_RET_S(E_POINTER);
+
+	VariantInit(val);
+
+	// Latest frame, painted or not
+	RenderedFrame rendered = GetLatestFrame();
+
+	if (!rendered.yuv)
+	{
+		val->vt = VT_NULL;
+		FUNC_END_RET_S(S_OK);
+	}
+
+	// Full size unless asked to score a downscaled copy
+	int maxWidth = 0;
+	JSObject obj(options);
+	if (!obj.isNull())
+		maxWidth = (int)obj.GetIntegerProperty(L"maxWidth", 0);
+
+	SharpnessScorer scorer;
+	val->vt = VT_R8;
+	val->dblVal = scorer.Score(rendered.yuv->DataY(), rendered.yuv->StrideY(), rendered.yuv->width(), rendered.yuv->height(), maxWidth);
+
+	FUNC_END_RET_S(S_OK);
+}
+
+STDMETHODIMP VideoRenderer::get_sharpnessRate(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_R8;
+	val->dblVal = sharpnessRate;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_sharpnessRate(VARIANT val)
+{
+	double rate = GetNumber(&val, -1);
+	if (rate < 0)
+		return E_INVALIDARG;
+
+	sharpnessRate = rate;
+	nextSharpnessUs = 0;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::get_staticThreshold(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_R8;
+	val->dblVal = staticThreshold;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_staticThreshold(VARIANT val)
+{
+	double threshold = GetNumber(&val, 0);
+
+	// Negative turns detection off
+	staticThreshold = threshold;
+
+	return S_OK;
+}
 
-		// Copy the stream into buffer
-		BYTE* strmBuff = (BYTE*)malloc(liSize.QuadPart);
-		memset(strmBuff, 0x0, liSize.QuadPart);
-		
-		ULONG bytesRead = 0;
-		hr = pStream->Read(strmBuff, liSize.QuadPart, &bytesRead);
-		if (SUCCEEDED(hr))
+STDMETHODIMP VideoRenderer::get_renderThreads(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_I4;
+	val->lVal = renderThreads;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_renderThreads(VARIANT val)
+{
+	int64_t threads = (int64_t)GetNumber(&val, -1);
+	if (threads < 0)
+		return E_INVALIDARG;
+
+	// Zero goes back to automatic
+	renderThreads = (int)threads;
+
+	return S_OK;
+}
+
+bool VideoRenderer::IsVisible() const
+{
+	if (!active || clipped || paused)
+		return false;
+
+	// Laid out with no area
+	if (!displayWidth || !displayHeight)
+		return false;
+
+	// Window not painting, hidden tab or minimized browser
+	if (paintPending && rtc::TimeMicros() - paintRequestedUs > PaintStarvedUs)
+		return false;
+
+	return true;
+}
+
+STDMETHODIMP VideoRenderer::get_paused(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_BOOL;
+	val->boolVal = paused ? VARIANT_TRUE : VARIANT_FALSE;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_paused(VARIANT val)
+{
+	bool pause;
+	if (val.vt == VT_BOOL)
+		pause = val.boolVal == VARIANT_TRUE;
+	else
+		pause = GetInt(&val, 0) != 0;
+
+	bool wasPaused = paused.exchange(pause);
+
+	// Resume with the last frame while new ones arrive
+	if (wasPaused && !pause)
+		Invalidate();
+
+	// Full rate again when resuming
+	UpdateSinkWants();
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::get_renderQueue(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_BOOL;
+	val->boolVal = renderQueue ? VARIANT_TRUE : VARIANT_FALSE;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_renderQueue(VARIANT val)
+{
+	bool enable;
+	if (val.vt == VT_BOOL)
+		enable = val.boolVal == VARIANT_TRUE;
+	else
+		enable = GetInt(&val, 0) != 0;
+
+	// Queued frames are dropped, next ones are rendered on arrival again. Not under
+	// renderMutex, stopping waits for a render holding it.
+	std::lock_guard<std::mutex> lock(queueMutex);
+	bool wasQueued = renderQueue.exchange(enable);
+	if (wasQueued && !enable)
+		scheduler.Stop();
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::get_maxRenderLatency(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_R8;
+	val->dblVal = scheduler.GetMaxLatency() / 1000.0;
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_maxRenderLatency(VARIANT val)
+{
+	double latency = GetNumber(&val, -1);
+	if (latency < 0)
+		return E_INVALIDARG;
+
+	// Milliseconds
+	scheduler.SetMaxLatency((int64_t)(latency * 1000));
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::get_renderDelay(VARIANT* val)
+{
+	VariantInit(val);
+	val->vt = VT_R8;
+	val->dblVal = scheduler.GetDelay() / 1000.0;
+
+	return S_OK;
+}
+
+// Bucket counts, see LatencyHistogram::BoundsUs
+static void HistogramToVariant(const std::vector<uint64_t>& counts, VARIANT* val)
+{
+	CComSafeArray<VARIANT> buckets((ULONG)counts.size());
+	for (size_t i = 0; i < counts.size(); ++i)
+		buckets.SetAt((LONG)i, _variant_t((double)counts[i]));
+
+	VariantInit(val);
+	val->vt = VT_ARRAY | VT_VARIANT;
+	val->parray = buckets.Detach();
+}
+
+STDMETHODIMP VideoRenderer::get_lateHistogram(VARIANT* val)
+{
+	HistogramToVariant(scheduler.GetLateCounts(), val);
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::get_earlyHistogram(VARIANT* val)
+{
+	HistogramToVariant(scheduler.GetEarlyCounts(), val);
+
+	return S_OK;
+}
+
+STDMETHODIMP VideoRenderer::put_overlay(VARIANT shapes)
+{
+	FUNC_BEGIN();
+
+	std::vector<OverlayShape> list;
+	JSObject array(shapes);
+
+	// Null or an empty array removes it
+	if (!array.isNull())
+	{
+		for (auto name : array.GetPropertyNames())
 		{
-#ifdef _DEBUG
-			FILE* fp = fopen("C:\\test2.png", "wb");
-			if (fp != NULL)
+			CComVariant item = array.GetProperty(name);
+			JSObject obj(item);
+			if (obj.isNull())
+				continue;
+
+			OverlayShape shape;
+
+			std::string type = (char*)obj.GetStringProperty(L"type", "line");
+			if (type == "line")
+				shape.type = OverlayShape::Type::Line;
+			else if (type == "arrow")
+				shape.type = OverlayShape::Type::Arrow;
+			else if (type == "circle")
+				shape.type = OverlayShape::Type::Circle;
+			else if (type == "anchor")
+				shape.type = OverlayShape::Type::Anchor;
+			else
+				FUNC_END_RET_S(E_INVALIDARG);
+
+			shape.x1 = (float)obj.GetNumberProperty(L"x1", 0);
+			shape.y1 = (float)obj.GetNumberProperty(L"y1", 0);
+			shape.x2 = (float)obj.GetNumberProperty(L"x2", 0);
+			shape.y2 = (float)obj.GetNumberProperty(L"y2", 0);
+			shape.radius = (float)obj.GetNumberProperty(L"radius", 0);
+			shape.lineWidth = (float)obj.GetNumberProperty(L"lineWidth", shape.lineWidth);
+			shape.fontSize = (float)obj.GetNumberProperty(L"fontSize", shape.fontSize);
+			if (shape.type == OverlayShape::Type::Anchor)
+				shape.text = (char*)obj.GetStringProperty(L"text", "");
+
+			// Either "#rgb", "#rrggbb" or 0xrrggbb
+			uint32_t rgb = 0xFF0000;
+			CComVariant color = obj.GetProperty(L"color");
+			if (color.vt == VT_BSTR)
 			{
-				fwrite(strmBuff, bytesRead, 1, fp);
-				fclose(fp);
+				if (!ParseOverlayColor((char*)_bstr_t(color.bstrVal), rgb))
+					FUNC_END_RET_S(E_INVALIDARG);
 			}
-#endif // _DEBUG
-
-			std::string base64Bitmap = base64_encode(strmBuff, bytesRead);
-			if (!base64Bitmap.empty() && val != nullptr)
+			else
 			{
-				variant_t out = base64Bitmap.c_str();
-				(*val).vt = VT_BSTR;
-				(*val).bstrVal = SysAllocString(out.bstrVal);
+				rgb = (uint32_t)obj.GetNumberProperty(L"color", rgb) & 0xFFFFFF;
 			}
-		}
-		free(strmBuff);
-	}
-	else
-		RTC_LOG(LS_INFO) << "failed to create snapshot encoder";
 
-clean_up:
-	if (pStream)
-		pStream->Release();
+			double opacity = obj.GetNumberProperty(L"opacity", 1);
+			opacity = opacity < 0 ? 0 : (opacity > 1 ? 1 : opacity);
+			shape.color = ((uint32_t)(opacity * 255 + 0.5) << 24) | rgb;
 
-	if (bm)
-		delete bm;
+			list.push_back(shape);
+		}
+	}
 
-	// Clean rgba data
-	free(rgba);
+	// Drawn from the next converted frame on
+	overlay.SetShapes(std::move(list));
 
-	FUNC_END_RET_S(hr);
+	FUNC_END_RET_S(S_OK);
 }
@@ -5,28 +5,20 @@
 #include "WebRTCPlugin_i.h"
 #include "MediaStreamTrack.h"
 #include "CallbackDispatcher.h"
-#include  <mutex>
+#include "VideoFrameStore.hpp"
+#include "SnapshotEncoder.h"
+#include "FrameQuality.hpp"
+#include "StaticFrameDetector.hpp"
+#include "RenderScheduler.hpp"
+#include "VideoOverlay.hpp"
+#include <atomic>
+#include <mutex>
 
 #include "api/video/video_frame.h"
+#include "api/video/video_frame_buffer.h"
 #include "api/video/video_sink_interface.h"
 
 
-#ifdef NOMINMAX
-#undef NOMINMAX 
-#ifndef max
-#define max(a,b)            (((a) > (b)) ? (a) : (b))
-#endif
-#ifndef min
-#define min(a,b)            (((a) < (b)) ? (a) : (b))
-#endif
-#endif
-
-#include <gdiplus.h>
-#pragma comment(lib, "Gdiplus.lib")
-
-#undef max
-#undef min
-
 #if defined(_WIN32_WCE) && !defined(_CE_DCOM) && !defined(_CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA)
 #error "Single-threaded COM objects are not properly supported on Windows CE platform, such as the Windows Mobile platforms that do not include full DCOM support. Define _CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA to force ATL to support creating single-thread COM object's and allow use of it's single-threaded COM object implementations. The threading model in your rgs file was set to 'Free' as that is the only threading model supported in non DCOM Windows CE platforms."
 #endif
@@ -34,17 +26,12 @@
 using namespace ATL;
 
 
-
-struct VideoBuffer
+// Source frame kept along with its converted surface, for snapshots
+struct RenderedFrame
 {
-	size_t width	= 0;
-	size_t height	= 0;
-	uint8_t* image	= nullptr;
-
-	~VideoBuffer()
-	{
-		if (image) free(image);
-	}
+	rtc::scoped_refptr<webrtc::I420BufferInterface> yuv;
+	webrtc::VideoRotation rotation = webrtc::kVideoRotation_0;
+	int64_t timestampUs = 0;
 };
 
 // VideoRenderer
@@ -65,7 +52,9 @@ class ATL_NO_VTABLE VideoRenderer :
 public:
 
 
-	VideoRenderer() : shadowWindow(_T("ShadowVideoRenderer"), this, 1)
+	VideoRenderer() :
+		scheduler([this](RenderedFrame& rendered) { RenderFrame(rendered); }),
+		shadowWindow(_T("ShadowVideoRenderer"), this, 1)
 	{
 		
 	}
@@ -136,14 +125,64 @@ public:
 	HRESULT OnPostVerbInPlaceActivate()
 	{
 		HRESULT hr = m_spInPlaceSite->GetWindow(&hwndParent);
+
+		// Back on the page, show the last frame right away
+		active = true;
+		UpdateSinkWants();
+		Invalidate();
+
 		return hr;
 	}
 
+	HRESULT IOleInPlaceObject_InPlaceDeactivate()
+	{
+		// Not shown until activated again
+		active = false;
+		UpdateSinkWants();
+
+		return CComControl<VideoRenderer>::IOleInPlaceObject_InPlaceDeactivate();
+	}
+
 	void FinalRelease()
 	{
+		// Stop receiving frames
+		if (videoTrack)
+			videoTrack->RemoveSink(this);
+		videoTrack = nullptr;
+
+		// Drop queued frames, no more renders after it returns
+		scheduler.Stop();
+
+		// Return whatever a running burst collected
+		FinishBurst();
+
 		Gdiplus::GdiplusShutdown(gdiplusToken);
 	}
 
+	HRESULT IOleInPlaceObject_SetObjectRects(LPCRECT prcPos, LPCRECT prcClip)
+	{
+		HRESULT hr = CComControl<VideoRenderer>::IOleInPlaceObject_SetObjectRects(prcPos, prcClip);
+
+		// Follow element size
+		displayWidth = prcPos->right - prcPos->left;
+		displayHeight = prcPos->bottom - prcPos->top;
+
+		// Scrolled out of the view
+		RECT visible;
+		bool wasClipped = clipped.exchange(!::IntersectRect(&visible, prcPos, prcClip));
+		if (wasClipped && !clipped)
+			Invalidate();
+
+		// Frames no bigger than the element, a trickle if scrolled out
+		UpdateSinkWants();
+
+		// Area to invalidate on new frames
+		std::lock_guard<std::mutex> lock(rectMutex);
+		controlRect = *prcPos;
+
+		return hr;
+	}
+
 	STDMETHOD(setTrack) (VARIANT track);
 	STDMETHOD(get_videoWidth)(SHORT* pVal)
 	{
@@ -159,22 +198,154 @@ public:
 	{
 		return MarshalCallback(onresize, handler);
 	}
+	STDMETHODIMP put_onsharpness(VARIANT handler)
+	{
+		return MarshalCallback(onsharpness, handler);
+	}
 
 	STDMETHOD(getFrame) (VARIANT* val);
+	STDMETHOD(getFrameAsync) (VARIANT options, VARIANT callback);
+	STDMETHOD(getFrameBytes) (VARIANT options, VARIANT* val);
+	STDMETHOD(getFrameBurst) (VARIANT options, VARIANT callback);
+	STDMETHOD(getSharpness) (VARIANT options, VARIANT* val);
+	STDMETHOD(get_sharpnessRate)(VARIANT* val);
+	STDMETHOD(put_sharpnessRate)(VARIANT val);
+	STDMETHOD(get_scaleFilter)(VARIANT* val);
+	STDMETHOD(put_scaleFilter)(VARIANT val);
+	STDMETHOD(get_mirror)(VARIANT* val);
+	STDMETHOD(put_mirror)(VARIANT val);
+	STDMETHOD(get_maxRenderFps)(VARIANT* val);
+	STDMETHOD(put_maxRenderFps)(VARIANT val);
+	STDMETHOD(get_framesReceived)(LONG* pVal)
+	{
+		*pVal = (LONG)framesReceived;
+		return S_OK;
+	}
+	STDMETHOD(get_framesPainted)(LONG* pVal)
+	{
+		*pVal = (LONG)framesPainted;
+		return S_OK;
+	}
+	STDMETHOD(get_framesSkipped)(LONG* pVal)
+	{
+		// Dropped by the rate governor plus converted but replaced before being painted
+		*pVal = (LONG)(framesSkipped + store.GetOverwrittenFrames());
+		return S_OK;
+	}
+	STDMETHOD(get_framesStatic)(LONG* pVal)
+	{
+		*pVal = (LONG)framesStatic;
+		return S_OK;
+	}
+	STDMETHOD(get_staticThreshold)(VARIANT* val);
+	STDMETHOD(put_staticThreshold)(VARIANT val);
+	STDMETHOD(get_renderThreads)(VARIANT* val);
+	STDMETHOD(put_renderThreads)(VARIANT val);
+	STDMETHOD(get_paused)(VARIANT* val);
+	STDMETHOD(put_paused)(VARIANT val);
+	STDMETHOD(get_framesHidden)(LONG* pVal)
+	{
+		*pVal = (LONG)framesHidden;
+		return S_OK;
+	}
+	STDMETHOD(get_renderQueue)(VARIANT* val);
+	STDMETHOD(put_renderQueue)(VARIANT val);
+	STDMETHOD(get_maxRenderLatency)(VARIANT* val);
+	STDMETHOD(put_maxRenderLatency)(VARIANT val);
+	STDMETHOD(get_renderDelay)(VARIANT* val);
+	STDMETHOD(get_framesLate)(LONG* pVal)
+	{
+		// Too late on arrival or replaced by a newer one while queued
+		*pVal = (LONG)scheduler.GetDropped();
+		return S_OK;
+	}
+	STDMETHOD(get_lateHistogram)(VARIANT* val);
+	STDMETHOD(get_earlyHistogram)(VARIANT* val);
+	STDMETHOD(put_overlay)(VARIANT shapes);
+
+private:
+	void UpdateSinkWants();
+	SnapshotOptions ParseSnapshotOptions(VARIANT& variant);
+	void Invalidate();
+	void FinishBurst();
+	RenderedFrame GetLatestFrame();
+	bool IsVisible() const;
+	void RenderFrame(const RenderedFrame& rendered);
 
 private:
 	Gdiplus::GdiplusStartupInput gdiplusStartupInput;
 	ULONG_PTR gdiplusToken;
 
-	std::shared_ptr<webrtc::VideoFrame> frames[2];
-	std::mutex mutex;
-	bool background = 0;
+	VideoFrameStore<RenderedFrame> store;
+	// Element size, negative until laid out
+	std::atomic<int> displayWidth{ -1 };
+	std::atomic<int> displayHeight{ -1 };
+	std::atomic<ScaleFilter> scaleFilter{ ScaleFilter::Box };
+	std::atomic<bool> mirror{ false };
 	size_t videoWidth;
 	size_t videoHeight;
 	webrtc::VideoRotation rotation;
 
-	HWND hwndParent;
+	rtc::scoped_refptr<webrtc::VideoTrackInterface> videoTrack;
+	int wantedPixelCount = -1;
+	int wantedFramerate = -1;
+
+	std::atomic<int> maxRenderFps{ 0 };
+	// Reset from the UI thread when the rate changes
+	std::atomic<int64_t> nextRenderUs{ 0 };
+
+	std::atomic<bool> paintPending{ false };
+	std::mutex rectMutex;
+	RECT controlRect = { 0 };
+
+	std::atomic<uint64_t> framesReceived{ 0 };
+	std::atomic<uint64_t> framesPainted{ 0 };
+	std::atomic<uint64_t> framesSkipped{ 0 };
+
+	// Frames too close to the last changed one are neither converted nor painted.
+	// Threshold is the mean luma difference allowed per block, negative disables it.
+	StaticFrameDetector staticDetector;
+	std::atomic<double> staticThreshold{ 1.0 };
+	std::atomic<uint64_t> framesStatic{ 0 };
+	RenderOptions storedOptions;
+
+	// Threads converting each frame, zero picks them by frame size
+	std::atomic<int> renderThreads{ 0 };
+
+	// Optional queue releasing frames at their timestamp pace instead of on arrival.
+	// Frames are converted either by the delivery or by the scheduler thread, never both.
+	RenderScheduler<RenderedFrame> scheduler;
+	std::atomic<bool> renderQueue{ false };
+	std::mutex queueMutex;
+	std::mutex renderMutex;
+
+	// Annotations drawn on the surface after conversion
+	VideoOverlay overlay;
+	uint64_t storedOverlay = 0;
+
+	// Newest frame received, for snapshots
+	std::mutex latestMutex;
+	RenderedFrame latest;
+
+	// Visibility, frames are neither converted nor painted while hidden
+	std::atomic<bool> active{ true };
+	std::atomic<bool> clipped{ false };
+	std::atomic<bool> paused{ false };
+	std::atomic<int64_t> paintRequestedUs{ 0 };
+	std::atomic<uint64_t> framesHidden{ 0 };
+
+	// Burst being collected from incoming frames
+	std::mutex burstMutex;
+	rtc::scoped_refptr<BurstTask> burst;
+
+	// Sharpness events per second, scored on the frame delivery thread
+	std::atomic<double> sharpnessRate{ 0 };
+	std::atomic<int64_t> nextSharpnessUs{ 0 };
+	SharpnessScorer sharpnessScorer;
+
+	HWND hwndParent = NULL;
 	Callback onresize;
+	Callback onsharpness;
 	CContainedWindow shadowWindow;
 };
 
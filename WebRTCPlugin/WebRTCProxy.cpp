@@ -19,9 +19,8 @@
 // Normal Device Capture
 #include "modules/video_capture/video_capture.h"
 #include "modules/video_capture/video_capture_factory.h"
-#include "pc/video_track_source.h"
 #include "modules/video_coding/codecs/h264/include/h264.h"
-#include "VcmCapturer.hpp"
+#include "CapturerTrackSource.hpp"
 #include "VideoRenderer.h"
 
 extern HINSTANCE g_hInstance;
@@ -29,6 +28,10 @@ extern HINSTANCE g_hInstance;
 bool WebRTCProxy::inited = false;
 std::shared_ptr<rtc::Thread> WebRTCProxy::signalingThread;
 std::shared_ptr<rtc::Thread> WebRTCProxy::eventThread;
+std::shared_ptr<rtc::Thread> WebRTCProxy::snapshotThread;
+ULONG_PTR WebRTCProxy::snapshotGdiplusToken = 0;
+std::shared_ptr<WorkerPool> WebRTCProxy::encoderPool;
+std::shared_ptr<WorkerPool> WebRTCProxy::renderPool;
 std::shared_ptr<rtc::Thread> WebRTCProxy::workThread;
 std::shared_ptr<rtc::Thread> WebRTCProxy::networkThread;
 
@@ -98,16 +101,19 @@ HRESULT WebRTCProxy::FinalConstruct()
 
 		signalingThread = std::shared_ptr<rtc::Thread>(rtc::Thread::Create().release());
 		eventThread = std::shared_ptr<rtc::Thread>(rtc::Thread::Create().release());
+		snapshotThread = std::shared_ptr<rtc::Thread>(rtc::Thread::Create().release());
 		workThread = std::shared_ptr<rtc::Thread>(rtc::Thread::Create().release());
 		networkThread = std::shared_ptr<rtc::Thread>(rtc::Thread::CreateWithSocketServer().release());
 
 		signalingThread->SetName("signaling_thread", NULL);
 		eventThread->SetName("event_thread", NULL);
+		snapshotThread->SetName("snapshot_thread", NULL);
 		workThread->SetName("work_thread", NULL);
 		networkThread->SetName("network_thread", NULL);
 
 		if (!signalingThread->Start() || !eventThread->Start()
-			|| !workThread->Start() || !networkThread->Start())
+			|| !workThread->Start() || !networkThread->Start()
+			|| !snapshotThread->Start())
 			FUNC_END_RET_S(false);
 
 		// Initialize things on event thread
@@ -115,6 +121,22 @@ HRESULT WebRTCProxy::FinalConstruct()
 			CoInitializeEx(NULL, COINIT_MULTITHREADED /*COINIT_APARTMENTTHREADED*/);
 		});
 
+		// Snapshots are encoded with GDI+ on their own thread
+		snapshotThread->Invoke<void>(RTC_FROM_HERE, []() {
+			Gdiplus::GdiplusStartupInput gdiplusStartupInput;
+			CoInitializeEx(NULL, COINIT_MULTITHREADED);
+			Gdiplus::GdiplusStartup(&snapshotGdiplusToken, &gdiplusStartupInput, NULL);
+		});
+
+		// Burst snapshots are encoded in parallel, with COM set up on every encoder
+		// thread as on the snapshot one. GDI+ itself is started once for the process.
+		encoderPool = std::make_shared<WorkerPool>(0,
+			[]() { CoInitializeEx(NULL, COINIT_MULTITHREADED); },
+			[]() { CoUninitialize(); });
+
+		// Big frames are converted in slices, kept apart from long encodes
+		renderPool = std::make_shared<WorkerPool>(0);
+
 		inited = true;
 	}
 
@@ -161,10 +183,20 @@ void WebRTCProxy::FinalRelease()
 			CoUninitialize();
 		});
 
+		// Finish pending encodes while GDI+ is still up
+		encoderPool->Stop();
+		renderPool->Stop();
+
+		snapshotThread->Invoke<void>(RTC_FROM_HERE, []() {
+			Gdiplus::GdiplusShutdown(snapshotGdiplusToken);
+			CoUninitialize();
+		});
+
 		networkThread->Quit();
 
 		workThread->Quit();
 		eventThread->Quit();
+		snapshotThread->Quit();
 		signalingThread->Quit();
 
 		rtc::CleanupSSL();
@@ -347,47 +379,94 @@ STDMETHODIMP WebRTCProxy::createLocalAudioTrack(VARIANT constraints, IUnknown**
 	FUNC_END_RET_S(hresult);
 }
 
-class CapturerTrackSource : public webrtc::VideoTrackSource
+// ConstrainULong / ConstrainDouble: bare number or {min, max, ideal, exact}
+static ConstraintRange ParseConstraintRange(JSObject& constraints, const std::wstring& name)
 {
-public:
-	static rtc::scoped_refptr<CapturerTrackSource> Create()
+	ConstraintRange range;
+	CComVariant value = constraints.GetProperty(name);
+
+	// Negative values are unset, like in ConstraintRange
+	range.ideal = GetNumber(&value, -1);
+	if (range.ideal >= 0)
+		return range;
+
+	JSObject obj(value);
+	if (obj.isNull())
+		return range;
+
+	double exact = obj.GetNumberProperty(L"exact", -1);
+	if (exact >= 0)
 	{
-		const size_t kWidth = 640;
-		const size_t kHeight = 480;
-		const size_t kFps = 30;
-		const size_t kDeviceIndex = 0;
-		std::unique_ptr<VcmCapturer> capturer =
-			absl::WrapUnique(VcmCapturer::Create(kWidth, kHeight, kFps, kDeviceIndex));
-		if (!capturer)
-		{
-			return nullptr;
-		}
-		return new rtc::RefCountedObject<CapturerTrackSource>(std::move(capturer));
+		range.min = exact;
+		range.max = exact;
+		range.ideal = exact;
+		return range;
 	}
+	range.min = obj.GetNumberProperty(L"min", range.min);
+	range.max = obj.GetNumberProperty(L"max", range.max);
+	range.ideal = obj.GetNumberProperty(L"ideal", range.ideal);
+
+	return range;
+}
+
+/*
+dictionary MediaTrackConstraintSet {
+  ConstrainULong     width;
+  ConstrainULong     height;
+  ConstrainDouble    frameRate;
+  ConstrainDOMString deviceId;
+};
+*/
+static CaptureConstraints ParseCaptureConstraints(VARIANT& variant)
+{
+	CaptureConstraints constraints;
+	JSObject obj(variant);
+
+	// Also true or undefined, use defaults
+	if (obj.isNull())
+		return constraints;
+
+	constraints.width = ParseConstraintRange(obj, L"width");
+	constraints.height = ParseConstraintRange(obj, L"height");
+	constraints.frameRate = ParseConstraintRange(obj, L"frameRate");
 
-protected:
-	explicit CapturerTrackSource(std::unique_ptr<VcmCapturer> capturer)
-		: VideoTrackSource(/*remote=*/false), capturer(std::move(capturer))
+	CComVariant deviceId = obj.GetProperty(L"deviceId");
+	if (deviceId.vt == VT_BSTR)
 	{
+		constraints.deviceId = (char*)_bstr_t(deviceId.bstrVal);
 	}
-
-private:
-	rtc::VideoSourceInterface<webrtc::VideoFrame>* source() override
+	else
 	{
-		return capturer.get();
+		JSObject device(deviceId);
+		if (!device.isNull())
+		{
+			CComVariant exact = device.GetProperty(L"exact");
+			CComVariant ideal = device.GetProperty(L"ideal");
+			if (exact.vt == VT_BSTR)
+			{
+				constraints.deviceId = (char*)_bstr_t(exact.bstrVal);
+				constraints.exactDeviceId = true;
+			}
+			else if (ideal.vt == VT_BSTR)
+			{
+				constraints.deviceId = (char*)_bstr_t(ideal.bstrVal);
+			}
+		}
 	}
 
-public:
-	std::unique_ptr<VcmCapturer> capturer;
-};
+	return constraints;
+}
 
 STDMETHODIMP WebRTCProxy::createLocalVideoTrack(VARIANT constraints, IUnknown** track)
 {
 	FUNC_BEGIN();
 
-	//Create the video source from capture, note that the video source keeps the std::unique_ptr of the videoCapturer
-	auto captureSource = CapturerTrackSource::Create();
-	rtc::scoped_refptr<webrtc::VideoTrackSourceInterface> videoSource = captureSource;
+	//Create or share the video source from capture, note that the video source keeps the std::unique_ptr of the videoCapturer
+	auto captureSource = CapturerTrackSource::Create(ParseCaptureConstraints(constraints));
+
+	//Own view of it, so this track crop offset does not move the others
+	auto trackSource = CapturerTrackView::Create(captureSource);
+	rtc::scoped_refptr<webrtc::VideoTrackSourceInterface> videoSource = trackSource;
 	if (!videoSource)
 		FUNC_END_RET_S(E_UNEXPECTED);
 
@@ -405,6 +484,7 @@ STDMETHODIMP WebRTCProxy::createLocalVideoTrack(VARIANT constraints, IUnknown**
 
 	//Attach to native track
 	mediaStreamTrack->Attach(videoTrack);
+	mediaStreamTrack->AttachSource(trackSource);
 
 	//Set device name as label
 	mediaStreamTrack->SetLabel(captureSource->capturer->label);
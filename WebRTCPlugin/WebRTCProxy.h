@@ -4,6 +4,7 @@
 #include <atlctl.h>
 #include "WebRTCPlugin_i.h"
 #include "CallbackDispatcher.h"
+#include "WorkerPool.hpp"
 
 #if defined(_WIN32_WCE) && !defined(_CE_DCOM) && !defined(_CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA)
 #error "Single-threaded COM objects are not properly supported on Windows CE platform, such as the Windows Mobile platforms that do not include full DCOM support. Define _CE_ALLOW_SINGLE_THREADED_OBJECTS_IN_MTA to force ATL to support creating single-thread COM object's and allow use of it's single-threaded COM object implementations. The threading model in your rgs file was set to 'Free' as that is the only threading model supported in non DCOM Windows CE platforms."
@@ -104,11 +105,18 @@ public:
 	STDMETHOD(setLogFilePath)(VARIANT path, int severity = rtc::LS_VERBOSE);
 
 	static std::shared_ptr<rtc::Thread>& GetEventThread() { return eventThread; }
+	static std::shared_ptr<rtc::Thread>& GetSnapshotThread() { return snapshotThread; }
+	static std::shared_ptr<WorkerPool>& GetEncoderPool() { return encoderPool; }
+	static std::shared_ptr<WorkerPool>& GetRenderPool() { return renderPool; }
 
 private:
 	static bool inited;
 	static std::shared_ptr<rtc::Thread> signalingThread;
 	static std::shared_ptr<rtc::Thread> eventThread;
+	static std::shared_ptr<rtc::Thread> snapshotThread;
+	static ULONG_PTR snapshotGdiplusToken;
+	static std::shared_ptr<WorkerPool> encoderPool;
+	static std::shared_ptr<WorkerPool> renderPool;
 	static std::shared_ptr<rtc::Thread> WebRTCProxy::workThread;
 	static std::shared_ptr<rtc::Thread> WebRTCProxy::networkThread;
 
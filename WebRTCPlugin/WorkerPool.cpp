@@ -0,0 +1,128 @@
+#include "WorkerPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+WorkerPool::WorkerPool(size_t size) :
+	WorkerPool(size, nullptr, nullptr)
+{
+}
+
+WorkerPool::WorkerPool(size_t size, std::function<void()> init, std::function<void()> uninit) :
+	init(std::move(init)),
+	uninit(std::move(uninit))
+{
+	if (!size)
+		size = GetDefaultSize();
+
+	for (size_t i = 0; i < size; ++i)
+		threads.emplace_back(&WorkerPool::Run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+bool WorkerPool::Post(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return false;
+		tasks.push_back(std::move(task));
+	}
+	cond.notify_one();
+
+	return true;
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (!count)
+		return;
+
+	// Shared with helpers that may only start after everything is done
+	struct State
+	{
+		std::function<void(size_t)> body;
+		size_t count;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable cond;
+	};
+
+	auto state = std::make_shared<State>();
+	state->body = body;
+	state->count = count;
+
+	auto work = [state]() {
+		size_t index;
+		while ((index = state->next++) < state->count)
+		{
+			state->body(index);
+			if (++state->done == state->count)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->cond.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = count - 1 < threads.size() ? count - 1 : threads.size();
+	for (size_t i = 0; i < helpers; ++i)
+		Post(work);
+
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cond.wait(lock, [&state]() { return state->done == state->count; });
+}
+
+void WorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return;
+		stopping = true;
+	}
+	cond.notify_all();
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+size_t WorkerPool::GetDefaultSize()
+{
+	size_t cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 1;
+}
+
+void WorkerPool::Run()
+{
+	if (init)
+		init();
+
+	for (;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+			// Drain the queue before leaving
+			if (tasks.empty())
+				break;
+
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+
+	if (uninit)
+		uninit();
+}
@@ -0,0 +1,53 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running posted tasks in order of arrival.
+// Tasks must not block waiting on other tasks of the same pool.
+class WorkerPool
+{
+public:
+	explicit WorkerPool(size_t size);
+	// Runs init on each thread before its first task and uninit after its last one
+	WorkerPool(size_t size, std::function<void()> init, std::function<void()> uninit);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// Queue a task, returns false once stopped
+	bool Post(std::function<void()> task);
+
+	// Run body for every index in [0, count) on the pool and the calling thread, and wait for all of them.
+	// The caller takes indexes too, so it finishes even when every pool thread is busy.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	// Run the queued tasks and join the threads, later posts are rejected
+	void Stop();
+
+	size_t GetSize() const { return threads.size(); }
+
+	// Threads to use for size 0 pools, one less than the cores so the caller keeps one
+	static size_t GetDefaultSize();
+
+private:
+	void Run();
+
+	std::function<void()> init;
+	std::function<void()> uninit;
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool stopping = false;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "Base64.hpp"
+
+namespace {
+
+std::vector<uint8_t> MakeBytes(size_t size)
+{
+	std::vector<uint8_t> bytes(size);
+	uint32_t seed = 1;
+	for (auto& byte : bytes)
+	{
+		seed = seed * 1664525 + 1013904223;
+		byte = (uint8_t)(seed >> 24);
+	}
+	return bytes;
+}
+
+const std::string base64_chars =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Encoder used for snapshots before, kept as the baseline
+std::string base64_encode(uint8_t const* bytes_to_encode, unsigned int in_len)
+{
+	std::string ret;
+	int i = 0;
+	int j = 0;
+	unsigned char char_array_3[3];
+	unsigned char char_array_4[4];
+
+	while (in_len--)
+	{
+		char_array_3[i++] = *(bytes_to_encode++);
+		if (i == 3)
+		{
+			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+			char_array_4[3] = char_array_3[2] & 0x3f;
+
+			for (i = 0; (i < 4); i++)
+				ret += base64_chars[char_array_4[i]];
+			i = 0;
+		}
+	}
+
+	if (i)
+	{
+		for (j = i; j < 3; j++)
+			char_array_3[j] = '\0';
+
+		char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+		char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+		char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+		char_array_4[3] = char_array_3[2] & 0x3f;
+
+		for (j = 0; (j < i + 1); j++)
+			ret += base64_chars[char_array_4[j]];
+
+		while ((i++ < 3))
+			ret += '=';
+	}
+
+	return ret;
+}
+
+}
+
+static void StringAppend(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes = MakeBytes((size_t)state.range(0));
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(base64_encode(bytes.data(), (unsigned int)bytes.size()));
+
+	state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(StringAppend)->Arg(64 << 10)->Arg(2 << 20);
+
+static void EncodeNarrow(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes = MakeBytes((size_t)state.range(0));
+	std::vector<char> out(Base64EncodedLength(bytes.size()));
+
+	for (auto _ : state)
+	{
+		Base64Encode(bytes.data(), bytes.size(), out.data());
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(EncodeNarrow)->Arg(64 << 10)->Arg(2 << 20);
+
+// Straight into a preallocated wide string, as done for the BSTR
+static void EncodeWide(benchmark::State& state)
+{
+	std::vector<uint8_t> bytes = MakeBytes((size_t)state.range(0));
+	std::vector<wchar_t> out(Base64EncodedLength(bytes.size()));
+
+	for (auto _ : state)
+	{
+		Base64Encode(bytes.data(), bytes.size(), out.data());
+		benchmark::DoNotOptimize(out.data());
+	}
+
+	state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(EncodeWide)->Arg(64 << 10)->Arg(2 << 20);
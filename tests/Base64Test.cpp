@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "Base64.hpp"
+
+namespace {
+
+std::string Encode(const std::string& text)
+{
+	std::string out(Base64EncodedLength(text.size()), '\0');
+	Base64Encode((const uint8_t*)text.data(), text.size(), &out[0]);
+	return out;
+}
+
+std::wstring EncodeWide(const std::string& text)
+{
+	std::wstring out(Base64EncodedLength(text.size()), L'\0');
+	Base64Encode((const uint8_t*)text.data(), text.size(), &out[0]);
+	return out;
+}
+
+std::vector<uint8_t> MakeBytes(size_t size, uint32_t seed)
+{
+	std::vector<uint8_t> bytes(size);
+	for (auto& byte : bytes)
+	{
+		seed = seed * 1664525 + 1013904223;
+		byte = (uint8_t)(seed >> 24);
+	}
+	return bytes;
+}
+
+// Strict decoder, returns false on anything but canonical padded base64
+template<typename CharT>
+bool Decode(const CharT* src, size_t len, std::vector<uint8_t>& out)
+{
+	static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	out.clear();
+	if (len % 4)
+		return false;
+
+	for (size_t i = 0; i < len; i += 4)
+	{
+		bool last = i + 4 == len;
+		int pad = last && src[i + 3] == '=' ? (src[i + 2] == '=' ? 2 : 1) : 0;
+
+		uint32_t v = 0;
+		for (int j = 0; j < 4; ++j)
+		{
+			size_t sextet = j < 4 - pad ? alphabet.find((char)src[i + j]) : 0;
+			if (src[i + j] < 0 || src[i + j] > 127 || sextet == std::string::npos)
+				return false;
+			v = (v << 6) | (uint32_t)sextet;
+		}
+
+		out.push_back((uint8_t)(v >> 16));
+		if (pad < 2)
+			out.push_back((uint8_t)(v >> 8));
+		if (pad < 1)
+			out.push_back((uint8_t)v);
+	}
+
+	return true;
+}
+
+// Guard characters around the output to catch writes out of it
+const size_t Guard = 64;
+
+}
+
+TEST(Base64, EncodedLength)
+{
+	EXPECT_EQ(0u, Base64EncodedLength(0));
+	EXPECT_EQ(4u, Base64EncodedLength(1));
+	EXPECT_EQ(4u, Base64EncodedLength(2));
+	EXPECT_EQ(4u, Base64EncodedLength(3));
+	EXPECT_EQ(8u, Base64EncodedLength(4));
+}
+
+// Test vectors of RFC 4648, section 10
+TEST(Base64, RFC4648Vectors)
+{
+	EXPECT_EQ("", Encode(""));
+	EXPECT_EQ("Zg==", Encode("f"));
+	EXPECT_EQ("Zm8=", Encode("fo"));
+	EXPECT_EQ("Zm9v", Encode("foo"));
+	EXPECT_EQ("Zm9vYg==", Encode("foob"));
+	EXPECT_EQ("Zm9vYmE=", Encode("fooba"));
+	EXPECT_EQ("Zm9vYmFy", Encode("foobar"));
+}
+
+TEST(Base64, RFC4648VectorsWide)
+{
+	EXPECT_EQ(L"", EncodeWide(""));
+	EXPECT_EQ(L"Zg==", EncodeWide("f"));
+	EXPECT_EQ(L"Zm8=", EncodeWide("fo"));
+	EXPECT_EQ(L"Zm9v", EncodeWide("foo"));
+	EXPECT_EQ(L"Zm9vYg==", EncodeWide("foob"));
+	EXPECT_EQ(L"Zm9vYmE=", EncodeWide("fooba"));
+	EXPECT_EQ(L"Zm9vYmFy", EncodeWide("foobar"));
+}
+
+TEST(Base64, UsesWholeAlphabet)
+{
+	// Every sextet value once, in order
+	std::string bytes;
+	for (int i = 0; i < 64; i += 4)
+	{
+		uint32_t v = (i << 18) | ((i + 1) << 12) | ((i + 2) << 6) | (i + 3);
+		bytes += (char)(v >> 16);
+		bytes += (char)(v >> 8);
+		bytes += (char)v;
+	}
+
+	EXPECT_EQ("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/", Encode(bytes));
+}
+
+TEST(Base64, LongInputGoesThroughVectorPath)
+{
+	// Long enough for the vector loops, same text repeated so each group is known
+	std::string text;
+	std::string expected;
+	for (int i = 0; i < 100; ++i)
+	{
+		text += "foobar";
+		expected += "Zm9vYmFy";
+	}
+	text += "f";
+	expected += "Zg==";
+
+	EXPECT_EQ(expected, Encode(text));
+	EXPECT_EQ(std::wstring(expected.begin(), expected.end()), EncodeWide(text));
+}
+
+TEST(Base64, WritesOnlyEncodedLength)
+{
+	const char* text = "foobar!";
+	char out[16];
+	memset(out, '#', sizeof(out));
+
+	Base64Encode((const uint8_t*)text, 7, out);
+
+	EXPECT_EQ(0, memcmp(out, "Zm9vYmFyIQ==", 12));
+	EXPECT_EQ('#', out[12]);
+}
+
+// Every length up to well past the vector loops, so each path ends on each possible tail,
+// from unaligned sources too
+TEST(Base64, MatchesScalarForEveryLength)
+{
+	std::vector<uint8_t> bytes = MakeBytes(1024 + 3, 1);
+	std::vector<uint8_t> decoded;
+
+	for (size_t offset = 0; offset < 4; ++offset)
+		for (size_t len = 0; len <= 1024 - offset; ++len)
+		{
+			const uint8_t* src = bytes.data() + offset;
+			size_t encoded = Base64EncodedLength(len);
+
+			std::string expected(encoded, '\0');
+			Base64EncodeScalar(src, len, &expected[0]);
+
+			std::string out(Guard + encoded + Guard, '#');
+			Base64Encode(src, len, &out[Guard]);
+
+			ASSERT_EQ(std::string(Guard, '#'), out.substr(0, Guard)) << "length " << len;
+			ASSERT_EQ(expected, out.substr(Guard, encoded)) << "length " << len;
+			ASSERT_EQ(std::string(Guard, '#'), out.substr(Guard + encoded)) << "length " << len;
+
+			ASSERT_TRUE(Decode(out.data() + Guard, encoded, decoded)) << "length " << len;
+			ASSERT_EQ(std::vector<uint8_t>(src, src + len), decoded) << "length " << len;
+		}
+}
+
+// Wide output is encoded in chunks of 3072 bytes, cover the lengths around the first chunk boundaries
+TEST(Base64, WideMatchesScalarForEveryLength)
+{
+	const size_t Chunk = 3 * 1024;
+	std::vector<uint8_t> bytes = MakeBytes(3 * Chunk + 64, 2);
+	std::vector<uint8_t> decoded;
+
+	std::vector<size_t> lengths;
+	for (size_t len = 0; len <= 256; ++len)
+		lengths.push_back(len);
+	for (size_t boundary = Chunk; boundary <= 3 * Chunk; boundary += Chunk)
+		for (size_t len = boundary - 64; len <= boundary + 64; ++len)
+			lengths.push_back(len);
+
+	for (size_t len : lengths)
+	{
+		size_t encoded = Base64EncodedLength(len);
+
+		std::string expected(encoded, '\0');
+		Base64EncodeScalar(bytes.data(), len, &expected[0]);
+
+		std::wstring out(Guard + encoded + Guard, L'#');
+		Base64Encode(bytes.data(), len, &out[Guard]);
+
+		ASSERT_EQ(std::wstring(Guard, L'#'), out.substr(0, Guard)) << "length " << len;
+		ASSERT_EQ(std::wstring(expected.begin(), expected.end()), out.substr(Guard, encoded)) << "length " << len;
+		ASSERT_EQ(std::wstring(Guard, L'#'), out.substr(Guard + encoded)) << "length " << len;
+
+		ASSERT_TRUE(Decode(out.data() + Guard, encoded, decoded)) << "length " << len;
+		ASSERT_EQ(std::vector<uint8_t>(bytes.begin(), bytes.begin() + len), decoded) << "length " << len;
+	}
+}
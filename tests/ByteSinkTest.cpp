@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include "ByteSink.hpp"
+
+TEST(VectorByteSink, StartsEmpty)
+{
+	VectorByteSink sink;
+	EXPECT_EQ(0u, sink.GetSize());
+}
+
+TEST(VectorByteSink, KeepsCommittedBytesWhenGrowing)
+{
+	VectorByteSink sink;
+
+	// Small chunks, as an encoder filling its output would ask for them
+	for (int i = 0; i < 1000; ++i)
+	{
+		uint8_t* out = sink.Reserve(7);
+		ASSERT_NE(nullptr, out);
+		memset(out, i & 0xff, 7);
+		sink.Commit(7);
+	}
+
+	ASSERT_EQ(7000u, sink.GetSize());
+	for (size_t i = 0; i < sink.GetSize(); ++i)
+		ASSERT_EQ((uint8_t)((i / 7) & 0xff), sink.GetData()[i]) << "byte " << i;
+}
+
+TEST(VectorByteSink, CommitsPartOfReservation)
+{
+	VectorByteSink sink;
+
+	uint8_t* out = sink.Reserve(100);
+	memcpy(out, "abc", 3);
+	sink.Commit(3);
+
+	// Next reservation starts right after the committed bytes
+	out = sink.Reserve(100);
+	memcpy(out, "def", 3);
+	sink.Commit(3);
+
+	ASSERT_EQ(6u, sink.GetSize());
+	EXPECT_EQ(0, memcmp(sink.GetData(), "abcdef", 6));
+}
@@ -0,0 +1,234 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "CaptureConstraints.hpp"
+
+static CaptureMode Mode(int width, int height, int frameRate, CaptureFormat format)
+{
+	CaptureMode mode;
+	mode.width = width;
+	mode.height = height;
+	mode.frameRate = frameRate;
+	mode.format = format;
+	return mode;
+}
+
+// Capabilities as enumerated by DirectShow on a Logitech C920
+static const std::vector<CaptureMode> C920 = {
+	Mode(640, 480, 30, CaptureFormat::YUY2),
+	Mode(160, 90, 30, CaptureFormat::YUY2),
+	Mode(320, 240, 30, CaptureFormat::YUY2),
+	Mode(800, 600, 24, CaptureFormat::YUY2),
+	Mode(1280, 720, 10, CaptureFormat::YUY2),
+	Mode(1920, 1080, 5, CaptureFormat::YUY2),
+	Mode(640, 480, 30, CaptureFormat::MJPEG),
+	Mode(800, 600, 30, CaptureFormat::MJPEG),
+	Mode(1280, 720, 30, CaptureFormat::MJPEG),
+	Mode(1920, 1080, 30, CaptureFormat::MJPEG),
+};
+
+// Integrated laptop camera, high frame rate only at low resolution
+static const std::vector<CaptureMode> Laptop = {
+	Mode(1280, 720, 30, CaptureFormat::MJPEG),
+	Mode(640, 480, 60, CaptureFormat::MJPEG),
+	Mode(640, 360, 60, CaptureFormat::MJPEG),
+	Mode(1280, 720, 10, CaptureFormat::YUY2),
+	Mode(640, 480, 30, CaptureFormat::YUY2),
+	Mode(320, 240, 30, CaptureFormat::YUY2),
+};
+
+static ConstraintRange Ideal(double value)
+{
+	ConstraintRange range;
+	range.ideal = value;
+	return range;
+}
+
+static ConstraintRange Exact(double value)
+{
+	ConstraintRange range;
+	range.min = value;
+	range.max = value;
+	return range;
+}
+
+static ConstraintRange Between(double min, double max)
+{
+	ConstraintRange range;
+	range.min = min;
+	range.max = max;
+	return range;
+}
+
+// Width, height and frame rate of the mode picked, or 0x0@0 for none
+static std::vector<int> Match(const std::vector<CaptureMode>& modes, const CaptureConstraints& constraints)
+{
+	int index = MatchCaptureMode(modes, constraints);
+	if (index < 0)
+		return { 0, 0, 0 };
+	return { modes[index].width, modes[index].height, modes[index].frameRate };
+}
+
+TEST(ConstraintRange, AllowsWithinSetBounds)
+{
+	EXPECT_TRUE(ConstraintRange().Allows(0));
+	EXPECT_TRUE(Ideal(640).Allows(1920));
+	EXPECT_TRUE(Between(320, 640).Allows(320));
+	EXPECT_TRUE(Between(320, 640).Allows(640));
+	EXPECT_FALSE(Between(320, 640).Allows(319));
+	EXPECT_FALSE(Between(320, 640).Allows(641));
+	EXPECT_FALSE(Exact(30).Allows(29.97));
+}
+
+TEST(MatchCaptureMode, NothingAskedOpensDefaultMode)
+{
+	EXPECT_EQ(std::vector<int>({ 640, 480, 30 }), Match(C920, CaptureConstraints()));
+	EXPECT_EQ(std::vector<int>({ 640, 480, 30 }), Match(Laptop, CaptureConstraints()));
+}
+
+TEST(MatchCaptureMode, IdealSizeOpensThatMode)
+{
+	CaptureConstraints constraints;
+	constraints.width = Ideal(1280);
+	constraints.height = Ideal(720);
+
+	// At 30 fps, the default rate, rather than the 10 fps raw mode
+	EXPECT_EQ(std::vector<int>({ 1280, 720, 30 }), Match(C920, constraints));
+	EXPECT_EQ(std::vector<int>({ 1280, 720, 30 }), Match(Laptop, constraints));
+}
+
+TEST(MatchCaptureMode, IdealBetweenModesOpensClosest)
+{
+	CaptureConstraints constraints;
+	constraints.width = Ideal(1024);
+	constraints.height = Ideal(576);
+
+	EXPECT_EQ(std::vector<int>({ 800, 600, 30 }), Match(C920, constraints));
+}
+
+TEST(MatchCaptureMode, OnlyWidthLeavesHeightFree)
+{
+	CaptureConstraints constraints;
+	constraints.width = Ideal(1920);
+
+	EXPECT_EQ(std::vector<int>({ 1920, 1080, 30 }), Match(C920, constraints));
+}
+
+TEST(MatchCaptureMode, MinExcludesSmallerModes)
+{
+	CaptureConstraints constraints;
+	constraints.width.min = 1000;
+
+	// Closest to the default size among the allowed ones
+	EXPECT_EQ(std::vector<int>({ 1280, 720, 30 }), Match(C920, constraints));
+}
+
+TEST(MatchCaptureMode, MaxFrameRateExcludesFasterModes)
+{
+	CaptureConstraints constraints;
+	constraints.frameRate.max = 15;
+
+	EXPECT_EQ(std::vector<int>({ 1280, 720, 10 }), Match(C920, constraints));
+}
+
+TEST(MatchCaptureMode, IdealFrameRateTradesSize)
+{
+	CaptureConstraints constraints;
+	constraints.frameRate = Ideal(60);
+	EXPECT_EQ(std::vector<int>({ 640, 480, 60 }), Match(Laptop, constraints));
+
+	// Size counts twice, frame rate once
+	constraints.width = Ideal(1280);
+	constraints.height = Ideal(720);
+	EXPECT_EQ(std::vector<int>({ 1280, 720, 30 }), Match(Laptop, constraints));
+}
+
+TEST(MatchCaptureMode, ExactValuesOpenOnlyThatMode)
+{
+	CaptureConstraints constraints;
+	constraints.width = Exact(1920);
+	constraints.height = Exact(1080);
+	constraints.frameRate = Exact(5);
+
+	EXPECT_EQ(std::vector<int>({ 1920, 1080, 5 }), Match(C920, constraints));
+	EXPECT_EQ(std::vector<int>({ 0, 0, 0 }), Match(Laptop, constraints));
+}
+
+TEST(MatchCaptureMode, ImpossibleConstraintsMatchNothing)
+{
+	CaptureConstraints constraints;
+	constraints.width = Between(1000, 1100);
+	EXPECT_EQ(-1, MatchCaptureMode(C920, constraints));
+
+	EXPECT_EQ(-1, MatchCaptureMode({}, CaptureConstraints()));
+}
+
+TEST(MatchCaptureMode, TiesGoToBiggerThenFasterMode)
+{
+	CaptureConstraints constraints;
+	constraints.width = Ideal(1000);
+	constraints.frameRate.max = 60;
+
+	// Both a fifth away from the ideal width
+	std::vector<CaptureMode> modes = {
+		Mode(800, 600, 30, CaptureFormat::NV12),
+		Mode(1250, 600, 30, CaptureFormat::NV12),
+	};
+	EXPECT_EQ(1, MatchCaptureMode(modes, constraints));
+
+	// Same size, one as much above the ideal frame rate as the other is below
+	constraints.frameRate.ideal = 40;
+	modes = {
+		Mode(1280, 720, 32, CaptureFormat::NV12),
+		Mode(1280, 720, 50, CaptureFormat::NV12),
+	};
+	EXPECT_EQ(1, MatchCaptureMode(modes, constraints));
+}
+
+TEST(MatchCaptureMode, EqualModesPreferCheaperFormat)
+{
+	std::vector<CaptureMode> modes = {
+		Mode(640, 480, 30, CaptureFormat::Other),
+		Mode(640, 480, 30, CaptureFormat::I420),
+		Mode(640, 480, 30, CaptureFormat::MJPEG),
+		Mode(640, 480, 30, CaptureFormat::YUY2),
+		Mode(640, 480, 30, CaptureFormat::NV12),
+	};
+
+	// Removing the best one each time goes through native formats first, by cost
+	const CaptureFormat order[] = {
+		CaptureFormat::NV12, CaptureFormat::YUY2, CaptureFormat::MJPEG, CaptureFormat::I420, CaptureFormat::Other
+	};
+	for (CaptureFormat format : order)
+	{
+		int index = MatchCaptureMode(modes, CaptureConstraints());
+		ASSERT_LE(0, index);
+		EXPECT_EQ((int)format, (int)modes[index].format);
+		modes.erase(modes.begin() + index);
+	}
+}
+
+TEST(MatchCaptureMode, FormatOnlyBreaksTies)
+{
+	CaptureConstraints constraints;
+	constraints.width = Ideal(1280);
+	constraints.height = Ideal(720);
+
+	// MJPEG at full rate rather than a raw mode at 10 fps
+	int index = MatchCaptureMode(C920, constraints);
+	ASSERT_LE(0, index);
+	EXPECT_EQ((int)CaptureFormat::MJPEG, (int)C920[index].format);
+
+	// Cheapest of the two 640x480 modes at 30 fps
+	index = MatchCaptureMode(C920, CaptureConstraints());
+	ASSERT_LE(0, index);
+	EXPECT_EQ((int)CaptureFormat::YUY2, (int)C920[index].format);
+
+	// A closer size wins over a cheaper format
+	std::vector<CaptureMode> modes = {
+		Mode(640, 480, 30, CaptureFormat::NV12),
+		Mode(1280, 720, 30, CaptureFormat::MJPEG),
+	};
+	EXPECT_EQ(1, MatchCaptureMode(modes, constraints));
+}
@@ -0,0 +1,113 @@
+#include <benchmark/benchmark.h>
+
+#include "third_party/libyuv/include/libyuv.h"
+
+#include "CaptureConstraints.hpp"
+#include "JpegEncoder.hpp"
+#include "TestImages.hpp"
+
+// Cost of getting I420 out of each native capture format, the order MatchCaptureMode
+// prefers them in. These are the libyuv calls the capture module makes on its own
+// thread before the plugin sees the frame, there is no plugin converter to time.
+// Samples are packed from the same picture in every format.
+static std::vector<uint8_t> PackNV12(const TestI420& image)
+{
+	std::vector<uint8_t> nv12(image.y);
+	for (size_t i = 0; i < image.u.size(); ++i)
+	{
+		nv12.push_back(image.u[i]);
+		nv12.push_back(image.v[i]);
+	}
+	return nv12;
+}
+
+static std::vector<uint8_t> PackYUY2(const TestI420& image)
+{
+	std::vector<uint8_t> yuy2;
+	for (int j = 0; j < image.height; ++j)
+		for (int i = 0; i < image.width; i += 2)
+		{
+			int uv = (j / 2) * image.StrideUV() + i / 2;
+			yuy2.push_back(image.y[j * image.StrideY() + i]);
+			yuy2.push_back(image.u[uv]);
+			yuy2.push_back(image.y[j * image.StrideY() + i + 1]);
+			yuy2.push_back(image.v[uv]);
+		}
+	return yuy2;
+}
+
+static std::vector<uint8_t> PackMJPEG(const TestI420& image)
+{
+	VectorByteSink jpeg;
+	JpegEncoder().Encode(
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height,
+		JpegEncoder::DefaultQuality, jpeg);
+	return std::vector<uint8_t>(jpeg.GetData(), jpeg.GetData() + jpeg.GetSize());
+}
+
+static void Convert(benchmark::State& state)
+{
+	CaptureFormat format = (CaptureFormat)state.range(0);
+	TestI420 image = MakeGradient((int)state.range(1), (int)state.range(2));
+	TestI420 out(image.width, image.height);
+
+	std::vector<uint8_t> sample;
+	if (format == CaptureFormat::NV12)
+		sample = PackNV12(image);
+	else if (format == CaptureFormat::YUY2)
+		sample = PackYUY2(image);
+	else if (format == CaptureFormat::MJPEG)
+		sample = PackMJPEG(image);
+
+	for (auto _ : state)
+	{
+		switch (format)
+		{
+		case CaptureFormat::NV12:
+			libyuv::NV12ToI420(
+				sample.data(), image.width,
+				sample.data() + image.y.size(), image.StrideUV() * 2,
+				out.y.data(), out.StrideY(),
+				out.u.data(), out.StrideUV(),
+				out.v.data(), out.StrideUV(),
+				image.width, image.height);
+			break;
+		case CaptureFormat::YUY2:
+			libyuv::YUY2ToI420(
+				sample.data(), image.width * 2,
+				out.y.data(), out.StrideY(),
+				out.u.data(), out.StrideUV(),
+				out.v.data(), out.StrideUV(),
+				image.width, image.height);
+			break;
+		default:
+			libyuv::MJPGToI420(
+				sample.data(), sample.size(),
+				out.y.data(), out.StrideY(),
+				out.u.data(), out.StrideUV(),
+				out.v.data(), out.StrideUV(),
+				image.width, image.height,
+				image.width, image.height);
+			break;
+		}
+		benchmark::DoNotOptimize(out.y.data());
+	}
+	static const char* names[] = { "NV12", "YUY2", "MJPEG" };
+	state.SetLabel(names[(int)format]);
+	state.SetBytesProcessed(state.iterations() * (int64_t)image.width * image.height * 3 / 2);
+}
+
+// Every format at the usual capture sizes
+static void Formats(benchmark::internal::Benchmark* benchmark)
+{
+	for (int format = (int)CaptureFormat::NV12; format <= (int)CaptureFormat::MJPEG; ++format)
+	{
+		benchmark->Args({ format, 640, 480 });
+		benchmark->Args({ format, 1280, 720 });
+		benchmark->Args({ format, 1920, 1080 });
+	}
+}
+BENCHMARK(Convert)->Apply(Formats);
@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "modules/video_capture/video_capture_factory.h"
+
+#include "CapturerTrackSource.hpp"
+#include "TestCapture.hpp"
+
+using webrtc::FakeCaptureDevices;
+
+static webrtc::VideoCaptureCapability Capability(int width, int height, int fps, webrtc::VideoType type)
+{
+	webrtc::VideoCaptureCapability capability;
+	capability.width = width;
+	capability.height = height;
+	capability.maxFPS = fps;
+	capability.videoType = type;
+	return capability;
+}
+
+class CapturerTrackSourceTest : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		FakeCaptureDevices::Clear();
+		FakeCaptureDevices::Add("HD Webcam", "webcam", {
+			Capability(1280, 720, 30, webrtc::VideoType::kMJPEG),
+			Capability(640, 480, 30, webrtc::VideoType::kYUY2),
+		});
+		FakeCaptureDevices::Add("Virtual Camera", "virtual", {
+			Capability(640, 480, 30, webrtc::VideoType::kI420),
+		});
+	}
+
+	void TearDown() override
+	{
+		FakeCaptureDevices::Clear();
+		cricket::VideoAdapter::SetCropAspectRatio(0, 0);
+	}
+
+	static CaptureConstraints Size(int width, int height)
+	{
+		CaptureConstraints constraints;
+		constraints.width.ideal = width;
+		constraints.height.ideal = height;
+		return constraints;
+	}
+
+	static FakeCaptureDevices::Device& Webcam()
+	{
+		return *FakeCaptureDevices::Find("webcam");
+	}
+};
+
+TEST_F(CapturerTrackSourceTest, OpensClosestMode)
+{
+	rtc::scoped_refptr<CapturerTrackSource> source = CapturerTrackSource::Create(Size(1280, 720));
+	ASSERT_TRUE(source);
+	EXPECT_EQ("webcam", source->capturer->id_);
+
+	ASSERT_TRUE(Webcam().module);
+	EXPECT_TRUE(Webcam().module->started);
+	EXPECT_EQ(1280, Webcam().module->capability.width);
+	EXPECT_EQ(720, Webcam().module->capability.height);
+	EXPECT_EQ(webrtc::VideoType::kMJPEG, Webcam().module->capability.videoType);
+}
+
+TEST_F(CapturerTrackSourceTest, TracksShareRunningSource)
+{
+	rtc::scoped_refptr<CapturerTrackSource> preview = CapturerTrackSource::Create(Size(1280, 720));
+	rtc::scoped_refptr<CapturerTrackSource> send = CapturerTrackSource::Create(Size(1280, 720));
+
+	ASSERT_TRUE(preview);
+	EXPECT_EQ(preview.get(), send.get());
+	EXPECT_EQ(1, Webcam().opens);
+	EXPECT_EQ(1, Webcam().starts);
+}
+
+TEST_F(CapturerTrackSourceTest, StopsWithLastTrack)
+{
+	rtc::scoped_refptr<CapturerTrackSource> preview = CapturerTrackSource::Create(Size(1280, 720));
+	rtc::scoped_refptr<CapturerTrackSource> send = CapturerTrackSource::Create(Size(1280, 720));
+
+	preview = nullptr;
+	EXPECT_EQ(0, Webcam().stops);
+	ASSERT_TRUE(Webcam().module);
+
+	send = nullptr;
+	EXPECT_EQ(1, Webcam().stops);
+	EXPECT_FALSE(Webcam().module);
+}
+
+TEST_F(CapturerTrackSourceTest, ReopensOnceReleased)
+{
+	// Page reload, the old track is gone before the new one asks
+	CapturerTrackSource::Create(Size(1280, 720));
+	rtc::scoped_refptr<CapturerTrackSource> source = CapturerTrackSource::Create(Size(1280, 720));
+
+	ASSERT_TRUE(source);
+	EXPECT_EQ(2, Webcam().opens);
+	EXPECT_EQ(1, Webcam().stops);
+	EXPECT_TRUE(Webcam().module->started);
+}
+
+TEST_F(CapturerTrackSourceTest, OtherModeSharesBusyCamera)
+{
+	rtc::scoped_refptr<CapturerTrackSource> hd = CapturerTrackSource::Create(Size(1280, 720));
+
+	// The camera cannot be opened twice, the running capture is adapted instead
+	CaptureConstraints constraints = Size(640, 480);
+	constraints.deviceId = "webcam";
+	constraints.exactDeviceId = true;
+	rtc::scoped_refptr<CapturerTrackSource> vga = CapturerTrackSource::Create(constraints);
+
+	EXPECT_EQ(hd.get(), vga.get());
+	EXPECT_EQ(1, Webcam().opens);
+	EXPECT_EQ(1280, Webcam().module->capability.width);
+}
+
+TEST_F(CapturerTrackSourceTest, DevicesRunOnTheirOwn)
+{
+	rtc::scoped_refptr<CapturerTrackSource> webcam = CapturerTrackSource::Create(Size(1280, 720));
+
+	CaptureConstraints constraints;
+	constraints.deviceId = "Virtual Camera";
+	rtc::scoped_refptr<CapturerTrackSource> virtualCamera = CapturerTrackSource::Create(constraints);
+
+	ASSERT_TRUE(virtualCamera);
+	EXPECT_NE(webcam.get(), virtualCamera.get());
+	EXPECT_EQ("virtual", virtualCamera->capturer->id_);
+	EXPECT_NE(webcam->key, virtualCamera->key);
+	EXPECT_TRUE(Webcam().module);
+	EXPECT_TRUE(FakeCaptureDevices::Find("virtual")->module);
+}
+
+TEST_F(CapturerTrackSourceTest, SkipsCameraFailingToStart)
+{
+	Webcam().broken = true;
+
+	rtc::scoped_refptr<CapturerTrackSource> source = CapturerTrackSource::Create(CaptureConstraints());
+	ASSERT_TRUE(source);
+	EXPECT_EQ("virtual", source->capturer->id_);
+
+	// Released right away, not left open
+	EXPECT_EQ(1, Webcam().opens);
+	EXPECT_FALSE(Webcam().module);
+}
+
+TEST_F(CapturerTrackSourceTest, NothingMatchingOpensNothing)
+{
+	CaptureConstraints constraints;
+	constraints.width.min = 4096;
+
+	EXPECT_FALSE(CapturerTrackSource::Create(constraints));
+	EXPECT_EQ(0, Webcam().opens);
+}
+
+TEST_F(CapturerTrackSourceTest, EachTrackSinkGetsItsOwnAdaptation)
+{
+	rtc::scoped_refptr<CapturerTrackSource> preview = CapturerTrackSource::Create(Size(1280, 720));
+	rtc::scoped_refptr<CapturerTrackSource> send = CapturerTrackSource::Create(Size(1280, 720));
+
+	TestSink previewSink;
+	TestSink sendSink;
+	preview->AddOrUpdateSink(&previewSink, rtc::VideoSinkWants());
+	rtc::VideoSinkWants wants;
+	wants.max_pixel_count = 320 * 180;
+	send->AddOrUpdateSink(&sendSink, wants);
+
+	TestSource camera(1280, 720);
+	ASSERT_TRUE(FakeCaptureDevices::Deliver("webcam", camera.NextFrame()));
+
+	EXPECT_EQ(1, previewSink.frames);
+	EXPECT_EQ(1280, previewSink.last.width());
+	EXPECT_EQ(1, sendSink.frames);
+	EXPECT_EQ(320, sendSink.last.width());
+
+	preview->RemoveSink(&previewSink);
+	send->RemoveSink(&sendSink);
+}
+
+TEST_F(CapturerTrackSourceTest, TracksPanOnTheirOwn)
+{
+	rtc::scoped_refptr<CapturerTrackSource> source = CapturerTrackSource::Create(Size(1280, 720));
+	rtc::scoped_refptr<CapturerTrackView> left = CapturerTrackView::Create(source);
+	rtc::scoped_refptr<CapturerTrackView> right = CapturerTrackView::Create(source);
+	cricket::VideoAdapter::SetCropAspectRatio(1, 1);
+
+	TestSink leftSink;
+	TestSink rightSink;
+	rtc::VideoSinkWants wants;
+	wants.max_pixel_count = 360 * 360;
+	left->AddOrUpdateSink(&leftSink, wants);
+	right->AddOrUpdateSink(&rightSink, wants);
+
+	// Set before and after the sink was added
+	left->SetCropOffset(0.0f, 0.5f);
+	TestSink laterSink;
+	left->AddOrUpdateSink(&laterSink, wants);
+
+	TestSource camera(1280, 720);
+	ASSERT_TRUE(FakeCaptureDevices::Deliver("webcam", camera.NextFrame()));
+
+	// First column of each crop
+	EXPECT_EQ(TestSource::LumaAt(0), leftSink.last.video_frame_buffer()->ToI420()->DataY()[0]);
+	EXPECT_EQ(TestSource::LumaAt(0), laterSink.last.video_frame_buffer()->ToI420()->DataY()[0]);
+	EXPECT_EQ(TestSource::LumaAt(280), rightSink.last.video_frame_buffer()->ToI420()->DataY()[0]);
+
+	left->RemoveSink(&leftSink);
+	left->RemoveSink(&laterSink);
+	right->RemoveSink(&rightSink);
+}
+
+TEST_F(CapturerTrackSourceTest, ConcurrentTracksOpenCameraOnce)
+{
+	std::vector<rtc::scoped_refptr<CapturerTrackSource>> sources(8);
+	std::vector<std::thread> threads;
+	for (auto& source : sources)
+		threads.emplace_back([&source]() { source = CapturerTrackSource::Create(Size(1280, 720)); });
+	for (auto& thread : threads)
+		thread.join();
+
+	for (auto& source : sources)
+		EXPECT_EQ(sources[0].get(), source.get());
+	EXPECT_EQ(1, Webcam().opens);
+
+	sources.clear();
+	EXPECT_EQ(1, Webcam().stops);
+}
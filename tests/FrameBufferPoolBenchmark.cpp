@@ -0,0 +1,32 @@
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+
+#include "FrameBufferPool.hpp"
+
+// Buffer for each adapted frame, as the capturer did before the pool
+static void CreateBuffer(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		rtc::scoped_refptr<webrtc::I420Buffer> buffer = webrtc::I420Buffer::Create((int)state.range(0), (int)state.range(1));
+		// Written by the scaler, fresh memory faults its pages in
+		memset(buffer->MutableDataY(), 0, buffer->StrideY() * buffer->height());
+		benchmark::DoNotOptimize(buffer->MutableDataY());
+	}
+}
+BENCHMARK(CreateBuffer)->Args({ 640, 360 })->Args({ 1280, 720 });
+
+static void PooledBuffer(benchmark::State& state)
+{
+	FrameBufferPool pool;
+
+	for (auto _ : state)
+	{
+		rtc::scoped_refptr<webrtc::I420Buffer> buffer = pool.CreateBuffer((int)state.range(0), (int)state.range(1));
+		// Written by the scaler, fresh memory faults its pages in
+		memset(buffer->MutableDataY(), 0, buffer->StrideY() * buffer->height());
+		benchmark::DoNotOptimize(buffer->MutableDataY());
+	}
+}
+BENCHMARK(PooledBuffer)->Args({ 640, 360 })->Args({ 1280, 720 });
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include "FrameBufferPool.hpp"
+#include "TestCapture.hpp"
+
+// Allocations made by any thread while counting is on
+static std::atomic<bool> counting{ false };
+static std::atomic<uint64_t> allocations{ 0 };
+
+void* operator new(size_t size)
+{
+	if (counting)
+		allocations++;
+	if (void* p = malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+// Allocations made while it is alive
+class AllocationCounter
+{
+public:
+	AllocationCounter()
+	{
+		start = allocations;
+		counting = true;
+	}
+
+	~AllocationCounter()
+	{
+		counting = false;
+	}
+
+	uint64_t Get() const { return allocations - start; }
+
+private:
+	uint64_t start;
+};
+
+TEST(FrameBufferPool, ReusesBufferOnceReleased)
+{
+	FrameBufferPool pool;
+
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer = pool.CreateBuffer(320, 240);
+	webrtc::I420Buffer* first = buffer.get();
+	EXPECT_EQ(320, buffer->width());
+	EXPECT_EQ(240, buffer->height());
+	buffer = nullptr;
+
+	buffer = pool.CreateBuffer(320, 240);
+	EXPECT_EQ(first, buffer.get());
+	EXPECT_EQ(1u, pool.GetHits());
+	EXPECT_EQ(1u, pool.GetMisses());
+}
+
+TEST(FrameBufferPool, AllocatesWhileInUse)
+{
+	FrameBufferPool pool;
+
+	rtc::scoped_refptr<webrtc::I420Buffer> first = pool.CreateBuffer(320, 240);
+	rtc::scoped_refptr<webrtc::I420Buffer> second = pool.CreateBuffer(320, 240);
+	EXPECT_NE(first.get(), second.get());
+	EXPECT_EQ(0u, pool.GetHits());
+	EXPECT_EQ(2u, pool.GetMisses());
+
+	// Either one comes back once released
+	webrtc::I420Buffer* released = second.get();
+	second = nullptr;
+	EXPECT_EQ(released, pool.CreateBuffer(320, 240).get());
+}
+
+TEST(FrameBufferPool, KeepsAtMostMaxBuffers)
+{
+	FrameBufferPool pool(2, 1);
+
+	rtc::scoped_refptr<webrtc::I420Buffer> first = pool.CreateBuffer(64, 48);
+	rtc::scoped_refptr<webrtc::I420Buffer> second = pool.CreateBuffer(64, 48);
+
+	// Past the limit buffers are not retained, so never reused
+	for (int i = 0; i < 3; ++i)
+	{
+		rtc::scoped_refptr<webrtc::I420Buffer> extra = pool.CreateBuffer(64, 48);
+		EXPECT_NE(first.get(), extra.get());
+		EXPECT_NE(second.get(), extra.get());
+	}
+	EXPECT_EQ(0u, pool.GetHits());
+	EXPECT_EQ(5u, pool.GetMisses());
+
+	first = nullptr;
+	pool.CreateBuffer(64, 48);
+	EXPECT_EQ(1u, pool.GetHits());
+}
+
+TEST(FrameBufferPool, KeepsSeveralSizes)
+{
+	FrameBufferPool pool(1, 2);
+
+	// An adapter switching back and forth does not flush the pool
+	for (int i = 0; i < 10; ++i)
+	{
+		pool.CreateBuffer(640, 360);
+		pool.CreateBuffer(320, 180);
+	}
+	EXPECT_EQ(2u, pool.GetMisses());
+	EXPECT_EQ(18u, pool.GetHits());
+}
+
+TEST(FrameBufferPool, EvictsLeastRecentlyUsedSize)
+{
+	FrameBufferPool pool(1, 2);
+
+	webrtc::I420Buffer* large = pool.CreateBuffer(640, 360).get();
+	pool.CreateBuffer(320, 180);
+	EXPECT_EQ(large, pool.CreateBuffer(640, 360).get());
+
+	// Drops the smallest size, the one unused for longest
+	pool.CreateBuffer(160, 90);
+	EXPECT_EQ(large, pool.CreateBuffer(640, 360).get());
+	EXPECT_EQ(2u, pool.GetHits());
+	EXPECT_EQ(3u, pool.GetMisses());
+
+	pool.CreateBuffer(320, 180);
+	EXPECT_EQ(4u, pool.GetMisses());
+}
+
+TEST(FrameBufferPool, BuffersOutliveRelease)
+{
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer;
+	{
+		FrameBufferPool pool;
+		buffer = pool.CreateBuffer(64, 48);
+		pool.Release();
+		EXPECT_NE(buffer.get(), pool.CreateBuffer(64, 48).get());
+	}
+
+	// Still owned downstream after the pool is gone
+	webrtc::I420Buffer::SetBlack(buffer.get());
+	EXPECT_EQ(0, buffer->DataY()[64 * 48 - 1]);
+}
+
+TEST(FrameBufferPool, SteadyStateAllocatesNothing)
+{
+	FrameBufferPool pool;
+
+	// Warm up with the buffer held for a frame, as an encoder does
+	rtc::scoped_refptr<webrtc::I420Buffer> held = pool.CreateBuffer(640, 360);
+	held = pool.CreateBuffer(640, 360);
+
+	AllocationCounter counter;
+	for (int i = 0; i < 100; ++i)
+		held = pool.CreateBuffer(640, 360);
+	EXPECT_EQ(0u, counter.Get());
+}
+
+TEST(FrameBufferPool, CounterSeesBufferAllocations)
+{
+	AllocationCounter counter;
+	webrtc::I420Buffer::Create(640, 360);
+	EXPECT_LE(2u, counter.Get());
+}
+
+TEST(VideoCapturerPool, SteadyCaptureAllocatesNothing)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink encoder;
+	TestSink preview;
+
+	rtc::VideoSinkWants encoderWants;
+	encoderWants.max_pixel_count = 640 * 360;
+	capturer.AddOrUpdateSink(&encoder, encoderWants);
+	rtc::VideoSinkWants previewWants;
+	previewWants.max_pixel_count = 320 * 180;
+	capturer.AddOrUpdateSink(&preview, previewWants);
+
+	// Sinks hold the previous frame while the next one is captured
+	for (int i = 0; i < 3; ++i)
+		capturer.OnFrame(source.NextFrame());
+
+	uint64_t hits = capturer.GetPoolHits();
+	uint64_t misses = capturer.GetPoolMisses();
+	{
+		AllocationCounter counter;
+		for (int i = 0; i < 300; ++i)
+			capturer.OnFrame(source.NextFrame());
+		EXPECT_EQ(0u, counter.Get());
+	}
+
+	EXPECT_EQ(303, encoder.frames);
+	EXPECT_EQ(303, preview.frames);
+	EXPECT_EQ(640, encoder.last.width());
+	EXPECT_EQ(320, preview.last.width());
+	EXPECT_EQ(hits + 600, capturer.GetPoolHits());
+	EXPECT_EQ(misses, capturer.GetPoolMisses());
+}
@@ -0,0 +1,24 @@
+#include <benchmark/benchmark.h>
+
+#include "FrameQuality.hpp"
+#include "TestImages.hpp"
+
+static void ScoreFullSize(benchmark::State& state)
+{
+	TestI420 image = MakeNoise((int)state.range(0), (int)state.range(1));
+	SharpnessScorer scorer;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(scorer.Score(image.y.data(), image.StrideY(), image.width, image.height, 0));
+}
+BENCHMARK(ScoreFullSize)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+static void ScoreScaled(benchmark::State& state)
+{
+	TestI420 image = MakeNoise((int)state.range(0), (int)state.range(1));
+	SharpnessScorer scorer;
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(scorer.Score(image.y.data(), image.StrideY(), image.width, image.height, 320));
+}
+BENCHMARK(ScoreScaled)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
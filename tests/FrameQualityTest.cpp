@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "FrameQuality.hpp"
+#include "TestImages.hpp"
+
+namespace {
+
+// Straightforward variance of the Laplacian, borders excluded
+double ReferenceSharpness(const uint8_t* data, int stride, int width, int height)
+{
+	std::vector<double> values;
+	for (int y = 1; y < height - 1; ++y)
+		for (int x = 1; x < width - 1; ++x)
+		{
+			const uint8_t* p = data + y * stride + x;
+			values.push_back((double)p[-stride] + p[stride] + p[-1] + p[1] - 4.0 * p[0]);
+		}
+
+	double mean = 0;
+	for (double value : values)
+		mean += value;
+	mean /= values.size();
+
+	double variance = 0;
+	for (double value : values)
+		variance += (value - mean) * (value - mean);
+	return variance / values.size();
+}
+
+// 3x3 box blur of the luma plane, borders kept
+TestI420 Blur(const TestI420& image)
+{
+	TestI420 blurred = image;
+	for (int y = 1; y < image.height - 1; ++y)
+		for (int x = 1; x < image.width - 1; ++x)
+		{
+			int sum = 0;
+			for (int j = -1; j <= 1; ++j)
+				for (int i = -1; i <= 1; ++i)
+					sum += image.y[(y + j) * image.StrideY() + x + i];
+			blurred.y[y * blurred.StrideY() + x] = (uint8_t)(sum / 9);
+		}
+	return blurred;
+}
+
+double Sharpness(const TestI420& image)
+{
+	return ComputeSharpness(image.y.data(), image.StrideY(), image.width, image.height);
+}
+
+}
+
+TEST(FrameQuality, MatchesReferenceForEveryRowTail)
+{
+	// Widths around the 16 pixel vector steps
+	for (int width = 3; width <= 70; ++width)
+	{
+		TestI420 image = MakeNoise(width, 9, width);
+		EXPECT_NEAR(ReferenceSharpness(image.y.data(), image.StrideY(), width, 9), Sharpness(image), 1e-6) << "width " << width;
+	}
+}
+
+TEST(FrameQuality, MatchesReferenceOnVeryWideRows)
+{
+	// Past the width the vector path handles
+	TestI420 image = MakeNoise(9000, 4);
+	EXPECT_NEAR(ReferenceSharpness(image.y.data(), image.StrideY(), 9000, 4), Sharpness(image), 1e-6);
+}
+
+TEST(FrameQuality, HonoursStride)
+{
+	TestI420 image = MakeNoise(64, 32);
+	// Same plane with half of its columns, reading through the full stride
+	EXPECT_NEAR(ReferenceSharpness(image.y.data(), image.StrideY(), 32, 32),
+		ComputeSharpness(image.y.data(), image.StrideY(), 32, 32), 1e-6);
+}
+
+TEST(FrameQuality, FlatImageHasNoSharpness)
+{
+	EXPECT_EQ(0, Sharpness(MakeSolid(64, 48, 128, 128, 128)));
+}
+
+TEST(FrameQuality, TooSmallImageHasNoSharpness)
+{
+	EXPECT_EQ(0, Sharpness(MakeNoise(2, 64)));
+	EXPECT_EQ(0, Sharpness(MakeNoise(64, 2)));
+}
+
+TEST(FrameQuality, BlurLowersSharpness)
+{
+	TestI420 image = MakeNoise(128, 96);
+	TestI420 blurred = Blur(image);
+
+	EXPECT_GT(Sharpness(image), Sharpness(blurred));
+	EXPECT_GT(Sharpness(blurred), Sharpness(Blur(blurred)));
+}
+
+TEST(SharpnessScorer, ScoresFullSizeWhenNarrowEnough)
+{
+	TestI420 image = MakeNoise(128, 96);
+	SharpnessScorer scorer;
+
+	EXPECT_EQ(Sharpness(image), scorer.Score(image.y.data(), image.StrideY(), 128, 96, 0));
+	EXPECT_EQ(Sharpness(image), scorer.Score(image.y.data(), image.StrideY(), 128, 96, 128));
+}
+
+TEST(SharpnessScorer, KeepsOrderWhenScaledDown)
+{
+	// Coarse detail, so some of it survives scaling
+	TestI420 image = MakeNoise(64, 48);
+	TestI420 big = MakeSolid(256, 192, 0, 128, 128);
+	for (int y = 0; y < 192; ++y)
+		for (int x = 0; x < 256; ++x)
+			big.y[y * 256 + x] = image.y[(y / 4) * 64 + x / 4];
+	TestI420 blurred = Blur(Blur(big));
+
+	SharpnessScorer scorer;
+	double sharp = scorer.Score(big.y.data(), big.StrideY(), 256, 192, 128);
+	double soft = scorer.Score(blurred.y.data(), blurred.StrideY(), 256, 192, 128);
+	EXPECT_GT(sharp, soft);
+}
+
+TEST(SharpnessScorer, ScalesFlatPlanes)
+{
+	TestI420 image = MakeSolid(640, 4, 200, 128, 128);
+	SharpnessScorer scorer;
+
+	// Height is kept at the minimum the Laplacian needs
+	EXPECT_EQ(0, scorer.Score(image.y.data(), image.StrideY(), 640, 4, 64));
+}
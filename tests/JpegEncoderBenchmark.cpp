@@ -0,0 +1,69 @@
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+
+#include <vector>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#include "JpegEncoder.hpp"
+#include "TestImages.hpp"
+
+static void EncodeI420(benchmark::State& state)
+{
+	TestI420 image = MakeGradient((int)state.range(0), (int)state.range(1));
+	JpegEncoder encoder;
+
+	for (auto _ : state)
+	{
+		VectorByteSink jpeg;
+		encoder.Encode(
+			image.y.data(), image.StrideY(),
+			image.u.data(), image.StrideUV(),
+			image.v.data(), image.StrideUV(),
+			image.width, image.height,
+			JpegEncoder::DefaultQuality, jpeg);
+		benchmark::DoNotOptimize(jpeg.GetData());
+	}
+}
+BENCHMARK(EncodeI420)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+// Encoding from an RGB image, as done before, leaving the I420 to RGB conversion out
+static void EncodeRGB(benchmark::State& state)
+{
+	int width = (int)state.range(0);
+	int height = (int)state.range(1);
+	TestI420 rgb = MakeGradient(width * 3, height);
+
+	for (auto _ : state)
+	{
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr err;
+		unsigned char* data = nullptr;
+		unsigned long size = 0;
+
+		cinfo.err = jpeg_std_error(&err);
+		jpeg_create_compress(&cinfo);
+		jpeg_mem_dest(&cinfo, &data, &size);
+		cinfo.image_width = width;
+		cinfo.image_height = height;
+		cinfo.input_components = 3;
+		cinfo.in_color_space = JCS_RGB;
+		jpeg_set_defaults(&cinfo);
+		jpeg_set_quality(&cinfo, JpegEncoder::DefaultQuality, TRUE);
+		jpeg_start_compress(&cinfo, TRUE);
+		while (cinfo.next_scanline < cinfo.image_height)
+		{
+			JSAMPROW row = rgb.y.data() + cinfo.next_scanline * width * 3;
+			jpeg_write_scanlines(&cinfo, &row, 1);
+		}
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+
+		benchmark::DoNotOptimize(data);
+		free(data);
+	}
+}
+BENCHMARK(EncodeRGB)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
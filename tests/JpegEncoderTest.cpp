@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <stdio.h>
+
+#include <vector>
+
+extern "C" {
+#include <jpeglib.h>
+}
+
+#include "JpegEncoder.hpp"
+#include "TestImages.hpp"
+
+namespace {
+
+// Decoded image, interleaved Y Cb Cr samples
+struct Decoded
+{
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> pixels;
+
+	uint8_t At(int x, int y, int component) const { return pixels[(y * width + x) * 3 + component]; }
+};
+
+bool Encode(const TestI420& image, int quality, VectorByteSink& out)
+{
+	JpegEncoder encoder;
+	return encoder.Encode(
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height,
+		quality, out);
+}
+
+// Errors abort the test through libjpeg's default handler
+Decoded Decode(const VectorByteSink& jpeg)
+{
+	jpeg_decompress_struct cinfo;
+	jpeg_error_mgr err;
+	cinfo.err = jpeg_std_error(&err);
+	jpeg_create_decompress(&cinfo);
+	jpeg_mem_src(&cinfo, (unsigned char*)jpeg.GetData(), (unsigned long)jpeg.GetSize());
+	jpeg_read_header(&cinfo, TRUE);
+	cinfo.out_color_space = JCS_YCbCr;
+	jpeg_start_decompress(&cinfo);
+
+	Decoded decoded;
+	decoded.width = cinfo.output_width;
+	decoded.height = cinfo.output_height;
+	decoded.pixels.resize(decoded.width * decoded.height * 3);
+	while (cinfo.output_scanline < cinfo.output_height)
+	{
+		JSAMPROW row = decoded.pixels.data() + cinfo.output_scanline * decoded.width * 3;
+		jpeg_read_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_decompress(&cinfo);
+	jpeg_destroy_decompress(&cinfo);
+	return decoded;
+}
+
+double LumaPSNR(const TestI420& image, const Decoded& decoded)
+{
+	double error = 0;
+	for (int j = 0; j < image.height; ++j)
+		for (int i = 0; i < image.width; ++i)
+		{
+			double diff = (double)image.y[j * image.StrideY() + i] - decoded.At(i, j, 0);
+			error += diff * diff;
+		}
+	error /= (double)image.width * image.height;
+	return error ? 10 * log10(255.0 * 255.0 / error) : 100;
+}
+
+}
+
+class JpegEncoderSizes : public testing::TestWithParam<std::pair<int, int>>
+{
+};
+
+TEST_P(JpegEncoderSizes, DecodesToSource)
+{
+	TestI420 image = MakeGradient(GetParam().first, GetParam().second);
+	VectorByteSink jpeg;
+	ASSERT_TRUE(Encode(image, 90, jpeg));
+
+	Decoded decoded = Decode(jpeg);
+	EXPECT_EQ(image.width, decoded.width);
+	EXPECT_EQ(image.height, decoded.height);
+	EXPECT_GT(LumaPSNR(image, decoded), 35);
+}
+
+// Multiples of the 16 pixel iMCU, odd sizes needing padding and tiny ones
+INSTANTIATE_TEST_CASE_P(Sizes, JpegEncoderSizes, testing::Values(
+	std::make_pair(64, 48),
+	std::make_pair(70, 38),
+	std::make_pair(17, 9),
+	std::make_pair(1, 1),
+	std::make_pair(640, 480)));
+
+TEST(JpegEncoder, KeepsColors)
+{
+	TestI420 image = MakeSolid(32, 32, 81, 90, 240);
+	VectorByteSink jpeg;
+	ASSERT_TRUE(Encode(image, 90, jpeg));
+
+	Decoded decoded = Decode(jpeg);
+	EXPECT_NEAR(81, decoded.At(16, 16, 0), 2);
+	EXPECT_NEAR(90, decoded.At(16, 16, 1), 2);
+	EXPECT_NEAR(240, decoded.At(16, 16, 2), 2);
+}
+
+TEST(JpegEncoder, GrowsOutputPastFirstChunk)
+{
+	// Noise at full quality does not fit in the first guess of the output size
+	TestI420 image = MakeNoise(256, 256);
+	VectorByteSink jpeg;
+	ASSERT_TRUE(Encode(image, 100, jpeg));
+	EXPECT_GT(jpeg.GetSize(), 256u * 256 / 4 + 4096);
+
+	Decoded decoded = Decode(jpeg);
+	EXPECT_EQ(256, decoded.width);
+	EXPECT_EQ(256, decoded.height);
+}
+
+TEST(JpegEncoder, LowerQualityIsSmaller)
+{
+	TestI420 image = MakeNoise(128, 128);
+	VectorByteSink high;
+	VectorByteSink low;
+	ASSERT_TRUE(Encode(image, 95, high));
+	ASSERT_TRUE(Encode(image, 30, low));
+
+	EXPECT_LT(low.GetSize(), high.GetSize());
+}
+
+TEST(JpegEncoder, RejectsEmptyImage)
+{
+	TestI420 image(0, 0);
+	VectorByteSink jpeg;
+	EXPECT_FALSE(Encode(image, 90, jpeg));
+	EXPECT_EQ(0u, jpeg.GetSize());
+}
+
+TEST(JpegEncoder, ReusesEncoderAcrossSizes)
+{
+	JpegEncoder encoder;
+	for (auto size : { std::make_pair(70, 38), std::make_pair(64, 48), std::make_pair(33, 65) })
+	{
+		TestI420 image = MakeGradient(size.first, size.second);
+		VectorByteSink jpeg;
+		ASSERT_TRUE(encoder.Encode(
+			image.y.data(), image.StrideY(),
+			image.u.data(), image.StrideUV(),
+			image.v.data(), image.StrideUV(),
+			image.width, image.height,
+			90, jpeg));
+
+		Decoded decoded = Decode(jpeg);
+		EXPECT_EQ(image.width, decoded.width);
+		EXPECT_GT(LumaPSNR(image, decoded), 35);
+	}
+}
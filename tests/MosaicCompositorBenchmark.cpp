@@ -0,0 +1,43 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "MosaicCompositor.hpp"
+#include "TestImages.hpp"
+
+// Gallery of 720p streams on a 1080p mosaic, every tile gets a frame per compose
+static void ComposeGallery(benchmark::State& state)
+{
+	int columns = (int)state.range(0);
+	int tileWidth = 1920 / columns;
+	int tileHeight = 1080 / columns;
+	TestI420 image = MakeNoise(1280, 720);
+
+	MosaicCompositor mosaic;
+	mosaic.SetSize(1920, 1080);
+	std::vector<int> ids;
+	for (int j = 0; j < columns; ++j)
+		for (int i = 0; i < columns; ++i)
+		{
+			ImageRect rect;
+			rect.x = i * tileWidth;
+			rect.y = j * tileHeight;
+			rect.width = tileWidth;
+			rect.height = tileHeight;
+			ids.push_back(mosaic.AddTile(rect));
+		}
+
+	for (auto _ : state)
+	{
+		for (int id : ids)
+			mosaic.StoreFrame(id,
+				image.y.data(), image.StrideY(),
+				image.u.data(), image.StrideUV(),
+				image.v.data(), image.StrideUV(),
+				image.width, image.height,
+				0, ScaleFilter::Box);
+		mosaic.Compose();
+		benchmark::DoNotOptimize(mosaic.GetBackBuffer().image);
+	}
+}
+BENCHMARK(ComposeGallery)->Arg(2)->Arg(3)->Arg(4);
@@ -0,0 +1,244 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include "MosaicCompositor.hpp"
+#include "TestImages.hpp"
+
+#undef FOURCC
+#include "third_party/libyuv/include/libyuv.h"
+
+namespace {
+
+const uint32_t Black = 0xFF000000;
+
+ImageRect Rect(int x, int y, int width, int height)
+{
+	ImageRect rect;
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	return rect;
+}
+
+bool StoreFrame(MosaicCompositor& mosaic, int id, const TestI420& image, int rotation = 0)
+{
+	return mosaic.StoreFrame(id,
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height,
+		rotation, ScaleFilter::Box);
+}
+
+uint32_t Pixel(const VideoBuffer& buffer, int x, int y)
+{
+	return *(const uint32_t*)PixelAt(buffer, x, y);
+}
+
+bool IsWhite(uint32_t pixel)
+{
+	return (pixel & 0xFF) >= 250 && ((pixel >> 8) & 0xFF) >= 250 && ((pixel >> 16) & 0xFF) >= 250;
+}
+
+// Whether every pixel of a rectangle of the buffer is black
+bool IsBlack(const VideoBuffer& buffer, const ImageRect& rect)
+{
+	for (int y = rect.y; y < rect.y + rect.height; ++y)
+		for (int x = rect.x; x < rect.x + rect.width; ++x)
+			if (Pixel(buffer, x, y) != Black)
+				return false;
+	return true;
+}
+
+TestI420 White(int width, int height)
+{
+	return MakeSolid(width, height, 235, 128, 128);
+}
+
+}
+
+TEST(MosaicCompositor, NothingToComposeWithoutSize)
+{
+	MosaicCompositor mosaic;
+	mosaic.AddTile(Rect(0, 0, 10, 10));
+	EXPECT_FALSE(mosaic.Compose());
+}
+
+TEST(MosaicCompositor, EmptyMosaicIsBlack)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(64, 48);
+
+	ASSERT_TRUE(mosaic.Compose());
+	EXPECT_EQ(64u, mosaic.GetBackBuffer().width);
+	EXPECT_EQ(48u, mosaic.GetBackBuffer().height);
+	EXPECT_TRUE(IsBlack(mosaic.GetBackBuffer(), Rect(0, 0, 64, 48)));
+}
+
+TEST(MosaicCompositor, DrawsTilesInPlace)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(128, 48);
+	int id = mosaic.AddTile(Rect(64, 0, 64, 48));
+
+	ASSERT_TRUE(StoreFrame(mosaic, id, White(128, 96)));
+	EXPECT_TRUE(mosaic.HasNewFrames());
+	ASSERT_TRUE(mosaic.Compose());
+	EXPECT_FALSE(mosaic.HasNewFrames());
+
+	const VideoBuffer& buffer = mosaic.GetBackBuffer();
+	EXPECT_TRUE(IsBlack(buffer, Rect(0, 0, 64, 48)));
+	for (int y = 0; y < 48; ++y)
+		for (int x = 64; x < 128; ++x)
+			ASSERT_TRUE(IsWhite(Pixel(buffer, x, y))) << x << "," << y;
+}
+
+TEST(MosaicCompositor, ScalesFramesToTheirTile)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(80, 60);
+	int id = mosaic.AddTile(Rect(8, 6, 64, 48));
+
+	TestI420 image = MakeNoise(128, 96);
+	ASSERT_TRUE(StoreFrame(mosaic, id, image));
+	ASSERT_TRUE(mosaic.Compose());
+
+	// Same as scaling and converting the frame on its own
+	TestI420 scaled(64, 48);
+	libyuv::I420Scale(
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		128, 96,
+		scaled.y.data(), scaled.StrideY(),
+		scaled.u.data(), scaled.StrideUV(),
+		scaled.v.data(), scaled.StrideUV(),
+		64, 48,
+		libyuv::kFilterBox);
+	VideoBuffer expected;
+	ASSERT_TRUE(ConvertI420ToARGB(expected,
+		scaled.y.data(), scaled.StrideY(),
+		scaled.u.data(), scaled.StrideUV(),
+		scaled.v.data(), scaled.StrideUV(),
+		64, 48));
+
+	const VideoBuffer& buffer = mosaic.GetBackBuffer();
+	for (int y = 0; y < 48; ++y)
+		ASSERT_EQ(0, memcmp(PixelAt(expected, 0, y), PixelAt(buffer, 8, 6 + y), 64 * 4)) << "row " << y;
+}
+
+TEST(MosaicCompositor, LetterboxesOtherAspectRatios)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(100, 100);
+	int id = mosaic.AddTile(Rect(0, 0, 100, 100));
+
+	// 16:9 frame fits as 100x56, centered
+	ASSERT_TRUE(StoreFrame(mosaic, id, White(160, 90)));
+	ASSERT_TRUE(mosaic.Compose());
+
+	const VideoBuffer& buffer = mosaic.GetBackBuffer();
+	EXPECT_TRUE(IsBlack(buffer, Rect(0, 0, 100, 22)));
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 0, 22)));
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 99, 77)));
+	EXPECT_TRUE(IsBlack(buffer, Rect(0, 78, 100, 22)));
+}
+
+TEST(MosaicCompositor, RotatesFrames)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(48, 64);
+	int id = mosaic.AddTile(Rect(0, 0, 48, 64));
+
+	// Landscape frame turned portrait fills the portrait tile
+	ASSERT_TRUE(StoreFrame(mosaic, id, White(64, 48), 90));
+	ASSERT_TRUE(mosaic.Compose());
+
+	const VideoBuffer& buffer = mosaic.GetBackBuffer();
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 0, 0)));
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 47, 63)));
+}
+
+TEST(MosaicCompositor, ClipsTilesToBackBuffer)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(64, 48);
+	int id = mosaic.AddTile(Rect(-32, 24, 64, 48));
+
+	ASSERT_TRUE(StoreFrame(mosaic, id, White(64, 48)));
+	ASSERT_TRUE(mosaic.Compose());
+
+	const VideoBuffer& buffer = mosaic.GetBackBuffer();
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 0, 24)));
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 31, 47)));
+	EXPECT_TRUE(IsBlack(buffer, Rect(32, 0, 32, 48)));
+	EXPECT_TRUE(IsBlack(buffer, Rect(0, 0, 32, 24)));
+}
+
+TEST(MosaicCompositor, RemovedTileIsCleared)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(64, 48);
+	int id = mosaic.AddTile(Rect(0, 0, 64, 48));
+
+	ASSERT_TRUE(StoreFrame(mosaic, id, White(64, 48)));
+	ASSERT_TRUE(mosaic.Compose());
+	EXPECT_TRUE(IsWhite(Pixel(mosaic.GetBackBuffer(), 32, 24)));
+
+	EXPECT_TRUE(mosaic.RemoveTile(id));
+	EXPECT_FALSE(mosaic.RemoveTile(id));
+	ASSERT_TRUE(mosaic.Compose());
+	EXPECT_TRUE(IsBlack(mosaic.GetBackBuffer(), Rect(0, 0, 64, 48)));
+
+	EXPECT_FALSE(StoreFrame(mosaic, id, White(64, 48)));
+}
+
+TEST(MosaicCompositor, MovedTileIsRedrawn)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(128, 48);
+	int id = mosaic.AddTile(Rect(0, 0, 64, 48));
+
+	ASSERT_TRUE(StoreFrame(mosaic, id, White(64, 48)));
+	ASSERT_TRUE(mosaic.Compose());
+
+	// Without a new frame the last one is drawn at the new place
+	EXPECT_TRUE(mosaic.SetTileRect(id, Rect(64, 0, 64, 48)));
+	ASSERT_TRUE(mosaic.Compose());
+
+	const VideoBuffer& buffer = mosaic.GetBackBuffer();
+	EXPECT_TRUE(IsBlack(buffer, Rect(0, 0, 64, 48)));
+	EXPECT_TRUE(IsWhite(Pixel(buffer, 100, 24)));
+}
+
+TEST(MosaicCompositor, CountsComposedAndOverwrittenFrames)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(128, 48);
+	int a = mosaic.AddTile(Rect(0, 0, 64, 48));
+	int b = mosaic.AddTile(Rect(64, 0, 64, 48));
+
+	ASSERT_TRUE(StoreFrame(mosaic, a, White(64, 48)));
+	ASSERT_TRUE(StoreFrame(mosaic, a, White(64, 48)));
+	ASSERT_TRUE(StoreFrame(mosaic, b, White(64, 48)));
+	ASSERT_TRUE(mosaic.Compose());
+
+	EXPECT_EQ(2u, mosaic.GetComposedFrames());
+	EXPECT_EQ(1u, mosaic.GetOverwrittenFrames());
+
+	// Nothing new, nothing composed
+	ASSERT_TRUE(mosaic.Compose());
+	EXPECT_EQ(2u, mosaic.GetComposedFrames());
+}
+
+TEST(MosaicCompositor, RejectsFramesForEmptyTiles)
+{
+	MosaicCompositor mosaic;
+	mosaic.SetSize(64, 48);
+	int id = mosaic.AddTile(Rect(0, 0, 0, 48));
+
+	EXPECT_FALSE(StoreFrame(mosaic, id, White(64, 48)));
+	EXPECT_FALSE(mosaic.SetTileRect(id + 1, Rect(0, 0, 10, 10)));
+}
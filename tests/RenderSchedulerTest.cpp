@@ -0,0 +1,310 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "RenderScheduler.hpp"
+
+namespace {
+
+// Whole milliseconds, so the simulated clock adds no jitter of its own
+const int64_t FrameUs = 33000;
+
+struct Arrival
+{
+	int64_t timestampUs;
+	int64_t nowUs;
+};
+
+struct Simulation
+{
+	std::vector<int64_t> released;
+	std::vector<int64_t> releasedAtUs;
+	size_t dropped = 0;
+};
+
+// Frames captured at a steady pace, each one taking transit(index) to arrive
+template<typename TransitT>
+std::vector<Arrival> MakeArrivals(size_t count, TransitT transit)
+{
+	std::vector<Arrival> arrivals;
+	for (size_t i = 0; i < count; ++i)
+		arrivals.push_back({ (int64_t)i * FrameUs, (int64_t)i * FrameUs + transit(i) });
+	return arrivals;
+}
+
+// Replays arrivals on a millisecond clock the way the scheduler thread releases frames
+Simulation Simulate(RenderTiming& timing, const std::vector<Arrival>& arrivals)
+{
+	Simulation simulation;
+	std::map<int64_t, int64_t> pending;
+	size_t next = 0;
+
+	for (int64_t now = 0; next < arrivals.size() || !pending.empty(); now += 1000)
+	{
+		for (; next < arrivals.size() && arrivals[next].nowUs <= now; ++next)
+		{
+			int64_t renderUs = timing.Schedule(arrivals[next].timestampUs, now);
+			if (renderUs < 0)
+				simulation.dropped++;
+			else
+				pending[arrivals[next].timestampUs] = renderUs;
+		}
+
+		// Newest due frame is released, older due ones are dropped
+		auto last = pending.end();
+		for (auto it = pending.begin(); it != pending.end() && it->second <= now; ++it)
+		{
+			if (last != pending.end())
+				simulation.dropped++;
+			last = it;
+		}
+		if (last == pending.end())
+			continue;
+
+		timing.OnReleased(last->first);
+		simulation.released.push_back(last->first);
+		simulation.releasedAtUs.push_back(now);
+		pending.erase(pending.begin(), std::next(last));
+	}
+
+	return simulation;
+}
+
+uint64_t Total(const std::vector<uint64_t>& counts)
+{
+	uint64_t total = 0;
+	for (auto count : counts)
+		total += count;
+	return total;
+}
+
+}
+
+TEST(LatencyHistogram, CountsInBuckets)
+{
+	LatencyHistogram histogram;
+	histogram.Add(0);
+	histogram.Add(2000);
+	histogram.Add(2001);
+	histogram.Add(10000000);
+
+	std::vector<uint64_t> counts = histogram.GetCounts();
+	ASSERT_EQ((size_t)LatencyHistogram::Buckets, counts.size());
+	EXPECT_EQ(2u, counts[0]);
+	EXPECT_EQ(1u, counts[1]);
+	EXPECT_EQ(1u, counts[LatencyHistogram::Buckets - 1]);
+
+	histogram.Reset();
+	EXPECT_EQ(0u, Total(histogram.GetCounts()));
+}
+
+TEST(RenderTiming, SteadyStreamHasNoDelay)
+{
+	RenderTiming timing;
+	Simulation simulation = Simulate(timing, MakeArrivals(100, [](size_t) { return 20000; }));
+
+	EXPECT_EQ(0, timing.GetDelay());
+	EXPECT_EQ(0u, simulation.dropped);
+	EXPECT_EQ(100u, simulation.released.size());
+}
+
+TEST(RenderTiming, JitterIsAbsorbedByDelay)
+{
+	RenderTiming timing;
+	// Every other frame 30 ms slower
+	Simulation simulation = Simulate(timing, MakeArrivals(200, [](size_t i) { return i % 2 ? 50000 : 20000; }));
+
+	EXPECT_NEAR(30000, timing.GetDelay(), 1000);
+	EXPECT_EQ(0u, simulation.dropped);
+
+	// Once the delay covers the jitter frames are shown at the pace they were captured at
+	for (size_t i = 10; i < simulation.releasedAtUs.size(); ++i)
+		EXPECT_NEAR(FrameUs, simulation.releasedAtUs[i] - simulation.releasedAtUs[i - 1], 1000) << "frame " << i;
+}
+
+TEST(RenderTiming, DelayNeverExceedsMaxLatency)
+{
+	RenderTiming timing;
+	timing.SetMaxLatency(20000);
+	Simulation simulation = Simulate(timing, MakeArrivals(200, [](size_t i) { return i % 2 ? 50000 : 20000; }));
+
+	EXPECT_EQ(20000, timing.GetMaxLatency());
+	EXPECT_GT(timing.GetDelay(), 0);
+	EXPECT_LE(timing.GetDelay(), 20000);
+	// Every other frame is 30 ms behind the fastest path, over the maximum
+	EXPECT_EQ(100u, simulation.dropped);
+
+	// Lowering the maximum cuts the current delay too
+	timing.SetMaxLatency(5000);
+	EXPECT_EQ(5000, timing.GetDelay());
+}
+
+TEST(RenderTiming, DelayShrinksSlowly)
+{
+	RenderTiming timing;
+	std::vector<Arrival> arrivals = MakeArrivals(300, [](size_t i) { return i < 150 && i % 2 ? 50000 : 20000; });
+
+	// Jitter stops half way, the slow frames are still in the window for a while
+	Simulate(timing, std::vector<Arrival>(arrivals.begin(), arrivals.begin() + 150));
+	int64_t jittery = timing.GetDelay();
+	Simulate(timing, std::vector<Arrival>(arrivals.begin() + 150, arrivals.begin() + 160));
+	EXPECT_EQ(jittery, timing.GetDelay());
+
+	Simulate(timing, std::vector<Arrival>(arrivals.begin() + 160, arrivals.end()));
+	EXPECT_LT(timing.GetDelay(), jittery);
+}
+
+TEST(RenderTiming, DropsFramesOlderThanReleasedOne)
+{
+	RenderTiming timing;
+	EXPECT_GE(timing.Schedule(2 * FrameUs, 0), 0);
+	timing.OnReleased(2 * FrameUs);
+
+	EXPECT_EQ(-1, timing.Schedule(FrameUs, 1000));
+	EXPECT_EQ(-1, timing.Schedule(2 * FrameUs, 1000));
+	EXPECT_GE(timing.Schedule(3 * FrameUs, 1000), 0);
+}
+
+TEST(RenderTiming, SpikePastMaxLatencyIsDropped)
+{
+	RenderTiming timing;
+	// A stall holds a frame 200 ms, the ones behind it arrive along with it
+	Simulation simulation = Simulate(timing, MakeArrivals(100, [](size_t i) { return i == 50 ? 220000 : 20000; }));
+
+	// Only those still over the 150 ms maximum latency, 220, 187 and 154 ms
+	EXPECT_EQ(3u, simulation.dropped);
+	EXPECT_EQ(97u, simulation.released.size());
+	EXPECT_LE(timing.GetDelay(), (int64_t)RenderTiming::DefaultMaxLatencyUs);
+}
+
+TEST(RenderTiming, TransitStepMovesBaseAfterAFewDrops)
+{
+	RenderTiming timing;
+	// Path gets 200 ms slower for good, more than the 150 ms maximum latency
+	Simulation simulation = Simulate(timing, MakeArrivals(300, [](size_t i) { return i < 100 ? 20000 : 220000; }));
+
+	// Dropped for a third of a second, not until the old fastest frame leaves the window
+	EXPECT_EQ(9u, simulation.dropped);
+	EXPECT_EQ(291u, simulation.released.size());
+	EXPECT_EQ(0, timing.GetDelay());
+
+	// Frames after the step are shown at an even pace again, not queued behind the old base
+	for (size_t i = 110; i < simulation.releasedAtUs.size(); ++i)
+		EXPECT_NEAR(FrameUs, simulation.releasedAtUs[i] - simulation.releasedAtUs[i - 1], 1000) << "frame " << i;
+}
+
+TEST(RenderTiming, DiscontinuityResetsTiming)
+{
+	RenderTiming timing;
+	Simulate(timing, MakeArrivals(200, [](size_t i) { return i % 2 ? 50000 : 20000; }));
+	ASSERT_GT(timing.GetDelay(), 0);
+
+	// Source restarted its clock, older timestamps are new frames again
+	int64_t now = 200 * FrameUs + 20000;
+	EXPECT_EQ(now, timing.Schedule(0, now));
+	EXPECT_EQ(0, timing.GetDelay());
+}
+
+TEST(RenderTiming, RecordsEarlyAndLateFrames)
+{
+	RenderTiming timing;
+	timing.Schedule(0, 20000);
+	// Arrives 30 ms after the fastest path, with no delay yet it is late
+	timing.Schedule(FrameUs, FrameUs + 50000);
+	// Fastest path again, waits for the delay just learnt
+	timing.Schedule(2 * FrameUs, 2 * FrameUs + 20000);
+
+	EXPECT_EQ(1u, Total(timing.GetLateHistogram().GetCounts()));
+	EXPECT_EQ(2u, Total(timing.GetEarlyHistogram().GetCounts()));
+}
+
+TEST(RenderScheduler, ReleasesFramesInOrder)
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<int> released;
+
+	RenderScheduler<int> scheduler([&](int& item) {
+		std::lock_guard<std::mutex> lock(mutex);
+		released.push_back(item);
+		cond.notify_one();
+	});
+
+	// Captured and delivered at the same steady pace
+	for (int i = 0; i < 5; ++i)
+	{
+		EXPECT_TRUE(scheduler.Push(i * 10000, i));
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(5), [&]() { return released.size() + scheduler.GetDropped() == 5; }));
+	for (size_t i = 1; i < released.size(); ++i)
+		EXPECT_LT(released[i - 1], released[i]);
+	EXPECT_EQ(4, released.back());
+}
+
+TEST(RenderScheduler, RejectsFramesOlderThanReleasedOne)
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool done = false;
+
+	RenderScheduler<int> scheduler([&](int&) {
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+		cond.notify_one();
+	});
+
+	EXPECT_TRUE(scheduler.Push(100000, 1));
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(5), [&]() { return done; }));
+	}
+
+	EXPECT_FALSE(scheduler.Push(50000, 2));
+	EXPECT_EQ(1u, scheduler.GetDropped());
+
+	// Stopping forgets the timeline, so the same frame is accepted again
+	scheduler.Stop();
+	EXPECT_TRUE(scheduler.Push(50000, 2));
+}
+
+TEST(RenderScheduler, TimesFramesWithoutTimestampByArrival)
+{
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::vector<int> released;
+
+	RenderScheduler<int> scheduler([&](int& item) {
+		std::lock_guard<std::mutex> lock(mutex);
+		released.push_back(item);
+		cond.notify_one();
+	});
+
+	// Source that never sets a capture time
+	for (int i = 0; i < 5; ++i)
+	{
+		EXPECT_TRUE(scheduler.Push(0, i));
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	ASSERT_TRUE(cond.wait_for(lock, std::chrono::seconds(5), [&]() { return released.size() + scheduler.GetDropped() == 5; }));
+	EXPECT_EQ(0u, scheduler.GetDropped());
+	EXPECT_EQ(4, released.back());
+}
+
+TEST(RenderScheduler, SetsMaxLatency)
+{
+	RenderScheduler<int> scheduler([](int&) {});
+	EXPECT_EQ((int64_t)RenderTiming::DefaultMaxLatencyUs, scheduler.GetMaxLatency());
+
+	scheduler.SetMaxLatency(40000);
+	EXPECT_EQ(40000, scheduler.GetMaxLatency());
+}
@@ -0,0 +1,16 @@
+#include <benchmark/benchmark.h>
+
+#include "StaticFrameDetector.hpp"
+#include "TestImages.hpp"
+
+// Worst case for a static scene, every block is compared
+static void DetectStatic(benchmark::State& state)
+{
+	TestI420 image = MakeNoise((int)state.range(0), (int)state.range(1));
+	StaticFrameDetector detector;
+	detector.IsStatic(image.y.data(), image.StrideY(), image.width, image.height, 2);
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(detector.IsStatic(image.y.data(), image.StrideY(), image.width, image.height, 2));
+}
+BENCHMARK(DetectStatic)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
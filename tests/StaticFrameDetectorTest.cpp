@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include "StaticFrameDetector.hpp"
+#include "TestImages.hpp"
+
+namespace {
+
+bool IsStatic(StaticFrameDetector& detector, const TestI420& image, double threshold = 2)
+{
+	return detector.IsStatic(image.y.data(), image.StrideY(), image.width, image.height, threshold);
+}
+
+// Adds delta to the luma of a rectangle, clamped
+TestI420 Change(const TestI420& image, int x, int y, int width, int height, int delta)
+{
+	TestI420 changed = image;
+	for (int j = y; j < y + height; ++j)
+		for (int i = x; i < x + width; ++i)
+		{
+			int value = changed.y[j * changed.StrideY() + i] + delta;
+			changed.y[j * changed.StrideY() + i] = (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+		}
+	return changed;
+}
+
+}
+
+TEST(StaticFrameDetector, FirstFrameHasChanged)
+{
+	StaticFrameDetector detector;
+	EXPECT_FALSE(IsStatic(detector, MakeNoise(64, 48)));
+}
+
+TEST(StaticFrameDetector, SameFrameIsStatic)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeNoise(64, 48);
+
+	EXPECT_FALSE(IsStatic(detector, image));
+	EXPECT_TRUE(IsStatic(detector, image));
+	EXPECT_TRUE(IsStatic(detector, image, 0));
+}
+
+TEST(StaticFrameDetector, NoiseWithinThresholdIsStatic)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeGradient(64, 48);
+
+	EXPECT_FALSE(IsStatic(detector, image));
+	EXPECT_TRUE(IsStatic(detector, Change(image, 0, 0, 64, 48, 2), 2));
+	EXPECT_FALSE(IsStatic(detector, Change(image, 0, 0, 64, 48, 3), 2));
+}
+
+TEST(StaticFrameDetector, SmallMovingAreaHasChanged)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeGradient(640, 480);
+
+	EXPECT_FALSE(IsStatic(detector, image));
+	// One block out of 1200, well under the threshold on average over the frame
+	EXPECT_FALSE(IsStatic(detector, Change(image, 320, 240, 16, 16, 40), 4));
+}
+
+TEST(StaticFrameDetector, ChangesOnPartialBlocksAreSeen)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeGradient(70, 38);
+
+	EXPECT_FALSE(IsStatic(detector, image));
+	// Bottom right corner, on the last sampled row and the narrow last column of blocks
+	EXPECT_FALSE(IsStatic(detector, Change(image, 64, 36, 6, 2, 40), 4));
+}
+
+TEST(StaticFrameDetector, SkipsRowsBetweenSamples)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeGradient(64, 48);
+
+	EXPECT_FALSE(IsStatic(detector, image));
+	// Only every RowStep-th row is compared
+	EXPECT_TRUE(IsStatic(detector, Change(image, 0, 1, 64, StaticFrameDetector::RowStep - 1, 100)));
+}
+
+TEST(StaticFrameDetector, ChangedFrameBecomesReference)
+{
+	StaticFrameDetector detector;
+	TestI420 a = MakeNoise(64, 48, 1);
+	TestI420 b = MakeNoise(64, 48, 2);
+
+	EXPECT_FALSE(IsStatic(detector, a));
+	EXPECT_FALSE(IsStatic(detector, b));
+	EXPECT_TRUE(IsStatic(detector, b));
+	EXPECT_FALSE(IsStatic(detector, a));
+}
+
+TEST(StaticFrameDetector, SlowDriftIsCaught)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeGradient(64, 48);
+
+	// Static frames do not move the reference, so small steps add up
+	EXPECT_FALSE(IsStatic(detector, image));
+	EXPECT_TRUE(IsStatic(detector, Change(image, 0, 0, 64, 48, 1), 2));
+	EXPECT_TRUE(IsStatic(detector, Change(image, 0, 0, 64, 48, 2), 2));
+	EXPECT_FALSE(IsStatic(detector, Change(image, 0, 0, 64, 48, 3), 2));
+}
+
+TEST(StaticFrameDetector, SizeChangeHasChanged)
+{
+	StaticFrameDetector detector;
+
+	EXPECT_FALSE(IsStatic(detector, MakeSolid(64, 48, 100, 128, 128)));
+	EXPECT_FALSE(IsStatic(detector, MakeSolid(48, 64, 100, 128, 128)));
+	EXPECT_TRUE(IsStatic(detector, MakeSolid(48, 64, 100, 128, 128)));
+}
+
+TEST(StaticFrameDetector, ResetForgetsReference)
+{
+	StaticFrameDetector detector;
+	TestI420 image = MakeNoise(64, 48);
+
+	EXPECT_FALSE(IsStatic(detector, image));
+	detector.Reset();
+	EXPECT_FALSE(IsStatic(detector, image));
+	EXPECT_TRUE(IsStatic(detector, image));
+}
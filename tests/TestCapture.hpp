@@ -0,0 +1,85 @@
+#ifndef TEST_CAPTURE_HPP
+#define TEST_CAPTURE_HPP
+
+#include <stdint.h>
+
+#include "api/scoped_refptr.h"
+#include "api/video/i420_buffer.h"
+#include "api/video/video_frame.h"
+#include "api/video/video_sink_interface.h"
+
+#include "VideoCapturer.hpp"
+
+// Capturer fed by the test instead of a device
+class TestCapturer : public VideoCapturer
+{
+public:
+	using VideoCapturer::OnFrame;
+	using VideoCapturer::GetSinkWants;
+};
+
+// Synthetic camera, the same picture at a steady frame rate. Luma follows the
+// column and chroma the row, so the source position of scaled pixels can be told.
+class TestSource
+{
+public:
+	TestSource(int width, int height, int fps = 30) :
+		buffer(webrtc::I420Buffer::Create(width, height)),
+		interval_us(1000000 / fps)
+	{
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				buffer->MutableDataY()[y * buffer->StrideY() + x] = LumaAt(x);
+		for (int y = 0; y < buffer->ChromaHeight(); ++y)
+			for (int x = 0; x < buffer->ChromaWidth(); ++x)
+			{
+				buffer->MutableDataU()[y * buffer->StrideU() + x] = ChromaAt(y);
+				buffer->MutableDataV()[y * buffer->StrideV() + x] = 128;
+			}
+	}
+
+	webrtc::VideoFrame NextFrame()
+	{
+		webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+			.set_video_frame_buffer(buffer)
+			.set_timestamp_us(timestamp_us)
+			.set_id(id++)
+			.build();
+		timestamp_us += interval_us;
+		return frame;
+	}
+
+	// Prime period, a shifted crop gives other values
+	static uint8_t LumaAt(int x) { return (uint8_t)(x % 251); }
+	static uint8_t ChromaAt(int y) { return (uint8_t)(y % 251); }
+
+private:
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer;
+	int64_t interval_us;
+	int64_t timestamp_us = 0;
+	uint16_t id = 0;
+};
+
+// Keeps the last frame it got, as an encoder holds it while encoding
+class TestSink : public rtc::VideoSinkInterface<webrtc::VideoFrame>
+{
+public:
+	TestSink() : last(webrtc::VideoFrame::Builder().build()) {}
+
+	void OnFrame(const webrtc::VideoFrame& frame) override
+	{
+		last = frame;
+		frames++;
+	}
+
+	// Stop holding the last frame
+	void Drop()
+	{
+		last = webrtc::VideoFrame::Builder().build();
+	}
+
+	webrtc::VideoFrame last;
+	int frames = 0;
+};
+
+#endif
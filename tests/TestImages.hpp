@@ -0,0 +1,93 @@
+#ifndef TEST_IMAGES_HPP
+#define TEST_IMAGES_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <vector>
+
+#include "VideoFrameStore.hpp"
+
+// I420 image owning its planes, chroma rounded up for odd sizes
+struct TestI420
+{
+	int width;
+	int height;
+	std::vector<uint8_t> y;
+	std::vector<uint8_t> u;
+	std::vector<uint8_t> v;
+
+	TestI420(int width, int height) :
+		width(width),
+		height(height),
+		y(width * height),
+		u(StrideUV() * ((height + 1) / 2)),
+		v(StrideUV() * ((height + 1) / 2))
+	{
+	}
+
+	int StrideY() const { return width; }
+	int StrideUV() const { return (width + 1) / 2; }
+};
+
+// Same value on every plane
+inline TestI420 MakeSolid(int width, int height, uint8_t y, uint8_t u, uint8_t v)
+{
+	TestI420 image(width, height);
+	memset(image.y.data(), y, image.y.size());
+	memset(image.u.data(), u, image.u.size());
+	memset(image.v.data(), v, image.v.size());
+	return image;
+}
+
+// Smooth diagonal ramps, different on each plane so rotations and swaps show up
+inline TestI420 MakeGradient(int width, int height)
+{
+	TestI420 image(width, height);
+	for (int j = 0; j < height; ++j)
+		for (int i = 0; i < width; ++i)
+			image.y[j * image.StrideY() + i] = (uint8_t)(16 + (i * 219 / width + j * 219 / height) / 2);
+	for (int j = 0; j < (height + 1) / 2; ++j)
+		for (int i = 0; i < image.StrideUV(); ++i)
+		{
+			image.u[j * image.StrideUV() + i] = (uint8_t)(64 + i * 128 / image.StrideUV());
+			image.v[j * image.StrideUV() + i] = (uint8_t)(64 + j * 128 / ((height + 1) / 2));
+		}
+	return image;
+}
+
+// Deterministic pseudo random planes
+inline TestI420 MakeNoise(int width, int height, uint32_t seed = 1)
+{
+	TestI420 image(width, height);
+	auto next = [&seed]() {
+		seed = seed * 1664525 + 1013904223;
+		return (uint8_t)(seed >> 24);
+	};
+	for (auto& value : image.y)
+		value = next();
+	for (auto& value : image.u)
+		value = next();
+	for (auto& value : image.v)
+		value = next();
+	return image;
+}
+
+// Pixel of an ARGB surface, as stored in memory: B, G, R, A
+inline const uint8_t* PixelAt(const VideoBuffer& buffer, int x, int y)
+{
+	return buffer.image + y * buffer.stride + x * 4;
+}
+
+// Whether two surfaces have the same size and pixels
+inline bool SameSurface(const VideoBuffer& a, const VideoBuffer& b)
+{
+	if (a.width != b.width || a.height != b.height)
+		return false;
+	for (size_t j = 0; j < a.height; ++j)
+		if (memcmp(a.image + j * a.stride, b.image + j * b.stride, a.width * 4))
+			return false;
+	return true;
+}
+
+#endif
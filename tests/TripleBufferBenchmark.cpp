@@ -0,0 +1,62 @@
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+#include "TripleBuffer.hpp"
+
+// Frame exchange as the renderer does it, one publish and one read per frame
+static void TripleBufferExchange(benchmark::State& state)
+{
+	TripleBuffer<int> buffer;
+	int value = 0;
+
+	for (auto _ : state)
+	{
+		buffer.GetWriteBuffer() = value++;
+		buffer.Publish();
+		buffer.Update();
+		benchmark::DoNotOptimize(buffer.GetReadBuffer());
+	}
+}
+BENCHMARK(TripleBufferExchange);
+
+// Previous approach, a single slot behind a mutex
+static void MutexExchange(benchmark::State& state)
+{
+	std::mutex mutex;
+	int slot = 0;
+	int value = 0;
+
+	for (auto _ : state)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slot = value++;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		benchmark::DoNotOptimize(slot);
+	}
+}
+BENCHMARK(MutexExchange);
+
+// Writer and reader on their own threads
+static TripleBuffer<int> shared;
+
+static void TripleBufferContended(benchmark::State& state)
+{
+	int value = 0;
+
+	for (auto _ : state)
+	{
+		if (state.thread_index() == 0)
+		{
+			shared.GetWriteBuffer() = value++;
+			shared.Publish();
+		}
+		else if (shared.Update())
+		{
+			benchmark::DoNotOptimize(shared.GetReadBuffer());
+		}
+	}
+}
+BENCHMARK(TripleBufferContended)->Threads(2);
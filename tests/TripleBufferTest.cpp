@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include "TripleBuffer.hpp"
+
+TEST(TripleBuffer, NothingToReadBeforePublish)
+{
+	TripleBuffer<int> buffer;
+
+	EXPECT_FALSE(buffer.HasUpdate());
+	EXPECT_FALSE(buffer.Update());
+	EXPECT_FALSE(buffer.HasReadBuffer());
+}
+
+TEST(TripleBuffer, ReaderPicksUpPublishedValue)
+{
+	TripleBuffer<int> buffer;
+
+	buffer.GetWriteBuffer() = 1;
+	buffer.Publish();
+	EXPECT_TRUE(buffer.HasUpdate());
+
+	ASSERT_TRUE(buffer.Update());
+	EXPECT_TRUE(buffer.HasReadBuffer());
+	EXPECT_EQ(1, buffer.GetReadBuffer());
+
+	// Same value until the next publish
+	EXPECT_FALSE(buffer.HasUpdate());
+	EXPECT_FALSE(buffer.Update());
+	EXPECT_EQ(1, buffer.GetReadBuffer());
+}
+
+TEST(TripleBuffer, WriterNeverTouchesReadSlot)
+{
+	TripleBuffer<int> buffer;
+
+	buffer.GetWriteBuffer() = 1;
+	buffer.Publish();
+	ASSERT_TRUE(buffer.Update());
+	int* read = &buffer.GetReadBuffer();
+
+	// However many times the writer publishes, the slot being read stays put
+	for (int i = 2; i < 10; ++i)
+	{
+		EXPECT_NE(read, &buffer.GetWriteBuffer());
+		buffer.GetWriteBuffer() = i;
+		buffer.Publish();
+	}
+	EXPECT_EQ(1, *read);
+
+	ASSERT_TRUE(buffer.Update());
+	EXPECT_EQ(9, buffer.GetReadBuffer());
+}
+
+TEST(TripleBuffer, CountsOverwrittenValues)
+{
+	TripleBuffer<int> buffer;
+
+	for (int i = 0; i < 5; ++i)
+	{
+		buffer.GetWriteBuffer() = i;
+		buffer.Publish();
+	}
+	buffer.Update();
+
+	buffer.GetWriteBuffer() = 5;
+	buffer.Publish();
+	buffer.Update();
+
+	EXPECT_EQ(6u, buffer.GetPublished());
+	EXPECT_EQ(4u, buffer.GetOverwritten());
+}
+
+// Values the reader can check for tearing
+struct Stamped
+{
+	uint64_t sequence = 0;
+	uint64_t words[15] = {};
+};
+
+TEST(TripleBuffer, ConcurrentReaderSeesWholeIncreasingValues)
+{
+	TripleBuffer<Stamped> buffer;
+	const uint64_t Count = 200000;
+	std::atomic<bool> done{ false };
+
+	std::thread writer([&]() {
+		for (uint64_t i = 1; i <= Count; ++i)
+		{
+			Stamped& value = buffer.GetWriteBuffer();
+			value.sequence = i;
+			for (auto& word : value.words)
+				word = i;
+			buffer.Publish();
+		}
+		done = true;
+	});
+
+	uint64_t last = 0;
+	uint64_t reads = 0;
+	bool torn = false;
+	bool backwards = false;
+	for (;;)
+	{
+		bool finished = done;
+		if (!buffer.Update())
+		{
+			if (finished)
+				break;
+			continue;
+		}
+		const Stamped& value = buffer.GetReadBuffer();
+		for (auto word : value.words)
+			torn |= word != value.sequence;
+		backwards |= value.sequence <= last;
+		last = value.sequence;
+		reads++;
+	}
+	writer.join();
+
+	EXPECT_FALSE(torn);
+	EXPECT_FALSE(backwards);
+	EXPECT_EQ(Count, last);
+	EXPECT_EQ(Count, buffer.GetPublished());
+	EXPECT_EQ(Count - reads, buffer.GetOverwritten());
+}
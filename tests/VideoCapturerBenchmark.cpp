@@ -0,0 +1,33 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "TestCapture.hpp"
+
+// One captured frame to a number of sinks, all wanting the same size or each
+// its own. Scaling is the nearest pixel pick of the test buffers, not libyuv,
+// so compare the runs with each other rather than with real capture timings.
+static void FanOut(benchmark::State& state)
+{
+	int count = (int)state.range(0);
+	bool sameSize = state.range(1) != 0;
+
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	std::vector<TestSink> sinks(count);
+	for (int i = 0; i < count; ++i)
+	{
+		rtc::VideoSinkWants wants;
+		wants.max_pixel_count = sameSize ? 640 * 360 : (640 * 360) >> (2 * i);
+		capturer.AddOrUpdateSink(&sinks[i], wants);
+	}
+
+	for (auto _ : state)
+		capturer.OnFrame(source.NextFrame());
+
+	state.counters["scales"] = benchmark::Counter((double)capturer.GetScales(), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(FanOut)
+	->Args({ 1, 1 })
+	->Args({ 2, 1 })->Args({ 2, 0 })
+	->Args({ 4, 1 })->Args({ 4, 0 });
@@ -0,0 +1,396 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+#include "TestCapture.hpp"
+
+class VideoCapturerCrop : public testing::Test
+{
+protected:
+	void TearDown() override
+	{
+		cricket::VideoAdapter::SetCropAspectRatio(0, 0);
+	}
+
+	// Captures one frame for a sink wanting at most that many pixels, cropped at the offset
+	webrtc::VideoFrame Capture(TestCapturer& capturer, TestSource& source, int maxPixels, float offsetX = 0.5f, float offsetY = 0.5f)
+	{
+		TestSink sink;
+		rtc::VideoSinkWants wants;
+		wants.max_pixel_count = maxPixels;
+		capturer.AddOrUpdateSink(&sink, wants);
+		capturer.SetCropOffset(&sink, offsetX, offsetY);
+		capturer.OnFrame(source.NextFrame());
+		capturer.RemoveSink(&sink);
+		EXPECT_EQ(1, sink.frames);
+		return sink.last;
+	}
+
+	// Every output pixel comes from the crop rectangle at that place, scaled evenly
+	void ExpectCropAt(const webrtc::VideoFrame& frame, int x, int y, int width, int height)
+	{
+		auto buffer = frame.video_frame_buffer()->ToI420();
+		for (int i = 0; i < buffer->width(); ++i)
+			ASSERT_EQ(TestSource::LumaAt(x + i * width / buffer->width()), buffer->DataY()[i]) << "column " << i;
+		for (int j = 0; j < buffer->ChromaHeight(); ++j)
+			ASSERT_EQ(TestSource::ChromaAt(y / 2 + j * ((height + 1) / 2) / buffer->ChromaHeight()), buffer->DataU()[j * buffer->StrideU()]) << "row " << j;
+	}
+};
+
+TEST_F(VideoCapturerCrop, ScalesWholeFrameWithoutCrop)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+
+	webrtc::VideoFrame frame = Capture(capturer, source, 640 * 360);
+	ASSERT_EQ(640, frame.width());
+	ASSERT_EQ(360, frame.height());
+	ExpectCropAt(frame, 0, 0, 1280, 720);
+}
+
+TEST_F(VideoCapturerCrop, CropsCenteredByDefault)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	cricket::VideoAdapter::SetCropAspectRatio(4, 3);
+
+	// Cut on the sides rather than squashed
+	webrtc::VideoFrame frame = Capture(capturer, source, 480 * 360);
+	ASSERT_EQ(480, frame.width());
+	ASSERT_EQ(360, frame.height());
+	ExpectCropAt(frame, 160, 0, 960, 720);
+}
+
+TEST_F(VideoCapturerCrop, CropsCenteredVertically)
+{
+	TestCapturer capturer;
+	TestSource source(640, 480);
+	cricket::VideoAdapter::SetCropAspectRatio(16, 9);
+
+	webrtc::VideoFrame frame = Capture(capturer, source, 320 * 180);
+	ASSERT_EQ(320, frame.width());
+	ASSERT_EQ(180, frame.height());
+	ExpectCropAt(frame, 0, 60, 640, 360);
+}
+
+TEST_F(VideoCapturerCrop, OffsetPansOverCapture)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	cricket::VideoAdapter::SetCropAspectRatio(1, 1);
+
+	ExpectCropAt(Capture(capturer, source, 360 * 360, 0.0f, 0.5f), 0, 0, 720, 720);
+	ExpectCropAt(Capture(capturer, source, 360 * 360, 1.0f, 0.5f), 560, 0, 720, 720);
+
+	// Rounded to even columns so chroma stays aligned
+	ExpectCropAt(Capture(capturer, source, 360 * 360, 0.25f, 0.5f), 140, 0, 720, 720);
+}
+
+TEST_F(VideoCapturerCrop, SinksPanOnTheirOwn)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	cricket::VideoAdapter::SetCropAspectRatio(1, 1);
+
+	TestSink left;
+	TestSink right;
+	rtc::VideoSinkWants wants;
+	wants.max_pixel_count = 360 * 360;
+	capturer.AddOrUpdateSink(&left, wants);
+	capturer.AddOrUpdateSink(&right, wants);
+	capturer.SetCropOffset(&left, 0.0f, 0.5f);
+	capturer.SetCropOffset(&right, 1.0f, 0.5f);
+
+	capturer.OnFrame(source.NextFrame());
+	ExpectCropAt(left.last, 0, 0, 720, 720);
+	ExpectCropAt(right.last, 560, 0, 720, 720);
+
+	// Same size, but not the same pixels
+	EXPECT_EQ(2u, capturer.GetScales());
+	EXPECT_EQ(0u, capturer.GetSharedScales());
+
+	capturer.RemoveSink(&left);
+	capturer.RemoveSink(&right);
+}
+
+TEST_F(VideoCapturerCrop, OffsetIsClampedToCapture)
+{
+	TestCapturer capturer;
+	TestSource source(640, 480);
+	cricket::VideoAdapter::SetCropAspectRatio(16, 9);
+
+	ExpectCropAt(Capture(capturer, source, 320 * 180, -1.0f, -1.0f), 0, 0, 640, 360);
+	ExpectCropAt(Capture(capturer, source, 320 * 180, 2.0f, 2.0f), 0, 120, 640, 360);
+}
+
+TEST_F(VideoCapturerCrop, PassesFrameThroughWhenNothingToAdapt)
+{
+	TestCapturer capturer;
+	TestSource source(640, 480);
+	TestSink sink;
+	capturer.AddOrUpdateSink(&sink, rtc::VideoSinkWants());
+
+	webrtc::VideoFrame frame = source.NextFrame();
+	capturer.OnFrame(frame);
+	EXPECT_EQ(frame.video_frame_buffer().get(), sink.last.video_frame_buffer().get());
+	EXPECT_EQ(0u, capturer.GetScales());
+}
+
+// Capture size, and aspect ratio asked to the adapter
+typedef std::pair<int, int> Size;
+
+class VideoCapturerAspect : public VideoCapturerCrop, public testing::WithParamInterface<std::tuple<Size, Size>>
+{
+};
+
+TEST_P(VideoCapturerAspect, KeepsCroppedAspectRatio)
+{
+	int width = std::get<0>(GetParam()).first;
+	int height = std::get<0>(GetParam()).second;
+	int aspectWidth = std::get<1>(GetParam()).first;
+	int aspectHeight = std::get<1>(GetParam()).second;
+
+	TestCapturer capturer;
+	TestSource source(width, height);
+	cricket::VideoAdapter::SetCropAspectRatio(aspectWidth, aspectHeight);
+
+	int croppedWidth = std::min(width, height * aspectWidth / aspectHeight) & ~1;
+	int croppedHeight = std::min(height, width * aspectHeight / aspectWidth) & ~1;
+
+	webrtc::VideoFrame frame = Capture(capturer, source, croppedWidth * croppedHeight / 4);
+	ASSERT_EQ(croppedWidth / 2, frame.width());
+	ASSERT_EQ(croppedHeight / 2, frame.height());
+	ExpectCropAt(frame, ((width - croppedWidth) / 2) & ~1, ((height - croppedHeight) / 2) & ~1, croppedWidth, croppedHeight);
+}
+
+INSTANTIATE_TEST_CASE_P(VideoCapturer, VideoCapturerAspect, testing::Combine(
+	testing::Values(Size(1280, 720), Size(1920, 1080), Size(640, 480), Size(352, 288), Size(720, 1280)),
+	testing::Values(Size(16, 9), Size(4, 3), Size(1, 1), Size(9, 16))));
+
+static rtc::VideoSinkWants Wants(int maxPixels, int maxFps = std::numeric_limits<int>::max())
+{
+	rtc::VideoSinkWants wants;
+	wants.max_pixel_count = maxPixels;
+	wants.max_framerate_fps = maxFps;
+	return wants;
+}
+
+TEST(VideoCapturerSinks, EachSinkGetsItsOwnSize)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink preview;
+	TestSink encoder;
+	capturer.AddOrUpdateSink(&preview, rtc::VideoSinkWants());
+	capturer.AddOrUpdateSink(&encoder, Wants(640 * 360));
+
+	webrtc::VideoFrame frame = source.NextFrame();
+	capturer.OnFrame(frame);
+
+	// Full size preview gets the captured frame itself
+	EXPECT_EQ(frame.video_frame_buffer().get(), preview.last.video_frame_buffer().get());
+	EXPECT_EQ(640, encoder.last.width());
+	EXPECT_EQ(360, encoder.last.height());
+	EXPECT_EQ(frame.id(), encoder.last.id());
+	EXPECT_EQ(frame.timestamp_us(), encoder.last.timestamp_us());
+	EXPECT_EQ(1u, capturer.GetScales());
+}
+
+TEST(VideoCapturerSinks, SameSizeIsScaledOnce)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink first;
+	TestSink second;
+	TestSink third;
+	capturer.AddOrUpdateSink(&first, Wants(640 * 360));
+	capturer.AddOrUpdateSink(&second, Wants(640 * 360));
+	capturer.AddOrUpdateSink(&third, Wants(320 * 180));
+
+	capturer.OnFrame(source.NextFrame());
+
+	EXPECT_EQ(first.last.video_frame_buffer().get(), second.last.video_frame_buffer().get());
+	EXPECT_NE(first.last.video_frame_buffer().get(), third.last.video_frame_buffer().get());
+	EXPECT_EQ(320, third.last.width());
+	EXPECT_EQ(2u, capturer.GetScales());
+	EXPECT_EQ(1u, capturer.GetSharedScales());
+}
+
+TEST(VideoCapturerSinks, EachSinkKeepsItsOwnFrameRate)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720, 30);
+	TestSink preview;
+	TestSink encoder;
+	capturer.AddOrUpdateSink(&preview, rtc::VideoSinkWants());
+	capturer.AddOrUpdateSink(&encoder, Wants(640 * 360, 15));
+
+	// Encoder degrading does not slow the preview down
+	for (int i = 0; i < 30; ++i)
+		capturer.OnFrame(source.NextFrame());
+	EXPECT_EQ(30, preview.frames);
+	EXPECT_EQ(15, encoder.frames);
+
+	// Nor the other way round
+	capturer.AddOrUpdateSink(&preview, Wants(320 * 180, 10));
+	capturer.AddOrUpdateSink(&encoder, rtc::VideoSinkWants());
+	for (int i = 0; i < 30; ++i)
+		capturer.OnFrame(source.NextFrame());
+	EXPECT_EQ(40, preview.frames);
+	EXPECT_EQ(45, encoder.frames);
+	EXPECT_EQ(320, preview.last.width());
+	EXPECT_EQ(1280, encoder.last.width());
+}
+
+TEST(VideoCapturerSinks, BlackFramesOnlyForThatSink)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink preview;
+	TestSink disabled;
+	capturer.AddOrUpdateSink(&preview, Wants(640 * 360));
+	rtc::VideoSinkWants wants = Wants(640 * 360);
+	wants.black_frames = true;
+	capturer.AddOrUpdateSink(&disabled, wants);
+
+	capturer.OnFrame(source.NextFrame());
+	webrtc::VideoFrameBuffer* first = disabled.last.video_frame_buffer().get();
+	capturer.OnFrame(source.NextFrame());
+
+	// Filled once, then sent again for every frame
+	EXPECT_EQ(first, disabled.last.video_frame_buffer().get());
+	auto black = disabled.last.video_frame_buffer()->ToI420();
+	ASSERT_EQ(640, black->width());
+	ASSERT_EQ(360, black->height());
+	for (int i = 0; i < black->width() * black->height(); ++i)
+		ASSERT_EQ(0, black->DataY()[i]);
+	EXPECT_EQ(128, black->DataU()[0]);
+
+	auto picture = preview.last.video_frame_buffer()->ToI420();
+	EXPECT_EQ(TestSource::LumaAt(2), picture->DataY()[1]);
+	EXPECT_EQ(2, disabled.frames);
+	EXPECT_EQ(2u, capturer.GetScales());
+}
+
+TEST(VideoCapturerSinks, RemovedSinkGetsNothing)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink kept;
+	TestSink removed;
+	capturer.AddOrUpdateSink(&kept, Wants(640 * 360));
+	capturer.AddOrUpdateSink(&removed, Wants(640 * 360));
+
+	capturer.OnFrame(source.NextFrame());
+	capturer.RemoveSink(&removed);
+	capturer.OnFrame(source.NextFrame());
+
+	EXPECT_EQ(2, kept.frames);
+	EXPECT_EQ(1, removed.frames);
+	EXPECT_EQ(1u, capturer.GetSharedScales());
+}
+
+// Runs an action on the capturer from its first OnFrame, as renderers do when switching tracks
+class ReentrantSink : public TestSink
+{
+public:
+	explicit ReentrantSink(std::function<void()> action) : action(action) {}
+
+	void OnFrame(const webrtc::VideoFrame& frame) override
+	{
+		TestSink::OnFrame(frame);
+		if (action)
+			action();
+		action = nullptr;
+	}
+
+private:
+	std::function<void()> action;
+};
+
+TEST(VideoCapturerSinks, SinkCanRemoveItselfWhileDelivered)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	ReentrantSink* self = nullptr;
+	ReentrantSink sink([&]() { capturer.RemoveSink(self); });
+	self = &sink;
+	capturer.AddOrUpdateSink(&sink, Wants(640 * 360));
+
+	capturer.OnFrame(source.NextFrame());
+	capturer.OnFrame(source.NextFrame());
+
+	EXPECT_EQ(1, sink.frames);
+}
+
+TEST(VideoCapturerSinks, SinkRemovedWhileDeliveringGetsNothingMore)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink removed;
+	ReentrantSink remover([&]() { capturer.RemoveSink(&removed); });
+	capturer.AddOrUpdateSink(&remover, Wants(640 * 360));
+	capturer.AddOrUpdateSink(&removed, Wants(640 * 360));
+
+	// Removed before its turn on the same frame
+	capturer.OnFrame(source.NextFrame());
+
+	EXPECT_EQ(1, remover.frames);
+	EXPECT_EQ(0, removed.frames);
+}
+
+TEST(VideoCapturerSinks, SinkCanAddAnotherWhileDelivered)
+{
+	TestCapturer capturer;
+	TestSource source(1280, 720);
+	TestSink added;
+	ReentrantSink adder([&]() { capturer.AddOrUpdateSink(&added, Wants(320 * 180)); });
+	capturer.AddOrUpdateSink(&adder, Wants(640 * 360));
+
+	capturer.OnFrame(source.NextFrame());
+	EXPECT_EQ(0, added.frames);
+
+	// Starts with the next frame
+	capturer.OnFrame(source.NextFrame());
+	EXPECT_EQ(2, adder.frames);
+	EXPECT_EQ(1, added.frames);
+	EXPECT_EQ(320, added.last.width());
+
+	capturer.RemoveSink(&adder);
+	capturer.RemoveSink(&added);
+}
+
+TEST(VideoCapturerSinks, WantsAggregateToTheLeastOfAllSinks)
+{
+	TestCapturer capturer;
+	TestSink preview;
+	TestSink encoder;
+
+	rtc::VideoSinkWants none = capturer.GetSinkWants();
+	EXPECT_EQ(std::numeric_limits<int>::max(), none.max_pixel_count);
+	EXPECT_FALSE(none.target_pixel_count);
+
+	rtc::VideoSinkWants previewWants = Wants(1280 * 720, 30);
+	previewWants.rotation_applied = true;
+	capturer.AddOrUpdateSink(&preview, previewWants);
+	rtc::VideoSinkWants encoderWants = Wants(640 * 360, 60);
+	encoderWants.target_pixel_count = 960 * 540;
+	capturer.AddOrUpdateSink(&encoder, encoderWants);
+
+	rtc::VideoSinkWants wants = capturer.GetSinkWants();
+	EXPECT_TRUE(wants.rotation_applied);
+	EXPECT_EQ(640 * 360, wants.max_pixel_count);
+	EXPECT_EQ(30, wants.max_framerate_fps);
+	// Never above the max
+	ASSERT_TRUE(wants.target_pixel_count);
+	EXPECT_EQ(640 * 360, *wants.target_pixel_count);
+
+	capturer.RemoveSink(&encoder);
+	wants = capturer.GetSinkWants();
+	EXPECT_EQ(1280 * 720, wants.max_pixel_count);
+	EXPECT_FALSE(wants.target_pixel_count);
+}
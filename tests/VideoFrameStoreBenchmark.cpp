@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include "TestImages.hpp"
+#include "VideoFrameStore.hpp"
+
+// Frames arrive at 30 fps while paints come much more often, each paint
+// used to convert the frame again
+static const int PaintsPerFrame = 4;
+
+static void ConvertOnPaint(benchmark::State& state)
+{
+	TestI420 image = MakeNoise((int)state.range(0), (int)state.range(1));
+	VideoBuffer buffer;
+
+	for (auto _ : state)
+		for (int i = 0; i < PaintsPerFrame; ++i)
+		{
+			ConvertI420ToARGB(buffer,
+				image.y.data(), image.StrideY(),
+				image.u.data(), image.StrideUV(),
+				image.v.data(), image.StrideUV(),
+				image.width, image.height);
+			benchmark::DoNotOptimize(buffer.image);
+		}
+}
+BENCHMARK(ConvertOnPaint)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+static void StoreOnArrival(benchmark::State& state)
+{
+	TestI420 image = MakeNoise((int)state.range(0), (int)state.range(1));
+	VideoFrameStore<int> store;
+
+	for (auto _ : state)
+	{
+		store.Store(
+			image.y.data(), image.StrideY(),
+			image.u.data(), image.StrideUV(),
+			image.v.data(), image.StrideUV(),
+			image.width, image.height,
+			RenderOptions(), 0);
+		for (int i = 0; i < PaintsPerFrame; ++i)
+			store.Read([](VideoFrameStore<int>::Frame& frame) { benchmark::DoNotOptimize(frame.surface.image); });
+	}
+}
+BENCHMARK(StoreOnArrival)->Args({ 640, 480 })->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+// Same conversion split over pool threads, as set with renderThreads,
+// at source size or scaled by a non-integer ratio to the given height
+static void StoreSliced(benchmark::State& state)
+{
+	TestI420 image = MakeNoise((int)state.range(0), (int)state.range(1));
+	WorkerPool pool(3);
+	VideoFrameStore<int> store;
+	store.SetThreads(&pool, (int)state.range(2));
+
+	RenderOptions options;
+	if (state.range(3))
+	{
+		options.targetHeight = (int)state.range(3);
+		options.targetWidth = image.width * options.targetHeight / image.height;
+	}
+
+	for (auto _ : state)
+	{
+		store.Store(
+			image.y.data(), image.StrideY(),
+			image.u.data(), image.StrideUV(),
+			image.v.data(), image.StrideUV(),
+			image.width, image.height,
+			options, 0);
+		store.Read([](VideoFrameStore<int>::Frame& frame) { benchmark::DoNotOptimize(frame.surface.image); });
+	}
+}
+BENCHMARK(StoreSliced)
+	->Args({ 1280, 720, 1, 0 })->Args({ 1280, 720, 2, 0 })->Args({ 1280, 720, 4, 0 })
+	->Args({ 1920, 1080, 1, 0 })->Args({ 1920, 1080, 2, 0 })->Args({ 1920, 1080, 4, 0 })
+	->Args({ 3840, 2160, 1, 0 })->Args({ 3840, 2160, 4, 0 })
+	->Args({ 1920, 1080, 1, 563 })->Args({ 1920, 1080, 4, 563 })
+	->Args({ 3840, 2160, 1, 1080 })->Args({ 3840, 2160, 4, 1080 })
+	->UseRealTime();
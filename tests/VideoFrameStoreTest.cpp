@@ -0,0 +1,490 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <set>
+#include <tuple>
+#include <utility>
+
+#include "TestImages.hpp"
+#include "VideoFrameStore.hpp"
+
+#undef FOURCC
+#include "third_party/libyuv/include/libyuv.h"
+
+namespace {
+
+bool Store(VideoFrameStore<int>& store, const TestI420& image, int payload, const RenderOptions& options = RenderOptions())
+{
+	return store.Store(
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height,
+		options, payload);
+}
+
+bool Convert(VideoBuffer& buffer, const TestI420& image)
+{
+	return ConvertI420ToARGB(buffer,
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height);
+}
+
+TestI420 Scale(const TestI420& image, int width, int height, ScaleFilter filter)
+{
+	TestI420 scaled(width, height);
+	libyuv::I420Scale(
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height,
+		scaled.y.data(), scaled.StrideY(),
+		scaled.u.data(), scaled.StrideUV(),
+		scaled.v.data(), scaled.StrideUV(),
+		width, height,
+		(libyuv::FilterMode)filter);
+	return scaled;
+}
+
+// Plain conversion rotated and then mirrored, one whole image step at a time
+void Transform(VideoBuffer& buffer, const VideoBuffer& source, int rotation, bool mirror)
+{
+	bool transposed = rotation == 90 || rotation == 270;
+	VideoBuffer rotated;
+	rotated.Reserve(transposed ? source.height : source.width, transposed ? source.width : source.height);
+	libyuv::ARGBRotate(source.image, (int)source.stride, rotated.image, (int)rotated.stride,
+		(int)source.width, (int)source.height, (libyuv::RotationMode)rotation);
+
+	buffer.Reserve(rotated.width, rotated.height);
+	if (mirror)
+		libyuv::ARGBMirror(rotated.image, (int)rotated.stride, buffer.image, (int)buffer.stride, (int)rotated.width, (int)rotated.height);
+	else
+		libyuv::ARGBCopy(rotated.image, (int)rotated.stride, buffer.image, (int)buffer.stride, (int)rotated.width, (int)rotated.height);
+}
+
+RenderOptions Target(int width, int height)
+{
+	RenderOptions options;
+	options.targetWidth = width;
+	options.targetHeight = height;
+	return options;
+}
+
+}
+
+TEST(VideoFrameStore, NothingToReadBeforeFirstStore)
+{
+	VideoFrameStore<int> store;
+
+	EXPECT_FALSE(store.HasNewFrame());
+	EXPECT_FALSE(store.Read([](VideoFrameStore<int>::Frame&) {}));
+}
+
+TEST(VideoFrameStore, ConvertsOncePerStoredFrame)
+{
+	VideoFrameStore<int> store;
+	TestI420 image = MakeGradient(64, 48);
+
+	ASSERT_TRUE(Store(store, image, 1));
+	EXPECT_TRUE(store.HasNewFrame());
+
+	// Painting again and again reads the same converted surface
+	for (int i = 0; i < 3; ++i)
+	{
+		int payload = 0;
+		EXPECT_TRUE(store.Read([&](VideoFrameStore<int>::Frame& frame) { payload = frame.payload; }));
+		EXPECT_EQ(1, payload);
+		EXPECT_FALSE(store.HasNewFrame());
+	}
+
+	EXPECT_EQ(1u, store.GetConvertedFrames());
+	EXPECT_EQ(0u, store.GetOverwrittenFrames());
+}
+
+TEST(VideoFrameStore, ReaderGetsLatestFrame)
+{
+	VideoFrameStore<int> store;
+	TestI420 image = MakeGradient(64, 48);
+
+	ASSERT_TRUE(Store(store, image, 1));
+	ASSERT_TRUE(Store(store, image, 2));
+	ASSERT_TRUE(Store(store, image, 3));
+
+	int payload = 0;
+	EXPECT_TRUE(store.Read([&](VideoFrameStore<int>::Frame& frame) { payload = frame.payload; }));
+	EXPECT_EQ(3, payload);
+	EXPECT_EQ(3u, store.GetConvertedFrames());
+	EXPECT_EQ(2u, store.GetOverwrittenFrames());
+}
+
+TEST(VideoFrameStore, SurfaceMatchesDirectConversion)
+{
+	VideoFrameStore<int> store;
+	TestI420 image = MakeGradient(64, 48);
+	ASSERT_TRUE(Store(store, image, 1));
+
+	VideoBuffer expected;
+	ASSERT_TRUE(ConvertI420ToARGB(expected,
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height));
+
+	store.Read([&](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_TRUE(SameSurface(expected, frame.surface));
+	});
+}
+
+TEST(VideoFrameStore, ConvertsLimitedRangeWhite)
+{
+	VideoFrameStore<int> store;
+	ASSERT_TRUE(Store(store, MakeSolid(16, 16, 235, 128, 128), 1));
+
+	store.Read([](VideoFrameStore<int>::Frame& frame) {
+		const uint8_t* pixel = PixelAt(frame.surface, 7, 7);
+		EXPECT_GE(pixel[0], 253);
+		EXPECT_GE(pixel[1], 253);
+		EXPECT_GE(pixel[2], 253);
+		EXPECT_EQ(255, pixel[3]);
+	});
+}
+
+TEST(VideoFrameStore, ReusesSurfaces)
+{
+	VideoFrameStore<int> store;
+	TestI420 image = MakeGradient(64, 48);
+
+	// Three slots, each allocated once for frames of the same size
+	std::set<uint8_t*> surfaces;
+	for (int i = 0; i < 20; ++i)
+	{
+		ASSERT_TRUE(Store(store, image, i));
+		store.Read([&](VideoFrameStore<int>::Frame& frame) { surfaces.insert(frame.surface.image); });
+	}
+
+	EXPECT_LE(surfaces.size(), 3u);
+}
+
+TEST(VideoFrameStore, ScalesDownBeforeConversion)
+{
+	VideoFrameStore<int> store;
+	TestI420 image = MakeNoise(128, 96);
+	ASSERT_TRUE(Store(store, image, 1, Target(64, 48)));
+
+	VideoBuffer expected;
+	ASSERT_TRUE(Convert(expected, Scale(image, 64, 48, ScaleFilter::Box)));
+
+	store.Read([&](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_EQ(64u, frame.surface.width);
+		EXPECT_EQ(48u, frame.surface.height);
+		EXPECT_TRUE(SameSurface(expected, frame.surface));
+	});
+}
+
+TEST(VideoFrameStore, KeepsFrameSizeWithoutTarget)
+{
+	VideoFrameStore<int> store;
+	ASSERT_TRUE(Store(store, MakeNoise(128, 96), 1));
+
+	store.Read([](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_EQ(128u, frame.surface.width);
+		EXPECT_EQ(96u, frame.surface.height);
+	});
+}
+
+TEST(VideoFrameStore, LeavesUpscalingToTheBlit)
+{
+	VideoFrameStore<int> store;
+	ASSERT_TRUE(Store(store, MakeNoise(128, 96), 1, Target(256, 192)));
+
+	store.Read([](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_EQ(128u, frame.surface.width);
+		EXPECT_EQ(96u, frame.surface.height);
+	});
+}
+
+TEST(VideoFrameStore, UpscalesWhenAsked)
+{
+	VideoFrameStore<int> store;
+	TestI420 image = MakeNoise(64, 48);
+	RenderOptions options = Target(128, 96);
+	options.upscale = true;
+	ASSERT_TRUE(Store(store, image, 1, options));
+
+	VideoBuffer expected;
+	ASSERT_TRUE(Convert(expected, Scale(image, 128, 96, ScaleFilter::Box)));
+
+	store.Read([&](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_TRUE(SameSurface(expected, frame.surface));
+	});
+}
+
+class VideoFrameStoreTransform : public testing::TestWithParam<std::tuple<int, bool>>
+{
+};
+
+TEST_P(VideoFrameStoreTransform, MatchesRotatedConversion)
+{
+	int rotation = std::get<0>(GetParam());
+	bool mirror = std::get<1>(GetParam());
+
+	// Height not a multiple of the band height, so the last band is a partial one
+	TestI420 image = MakeNoise(70, 38);
+	RenderOptions options;
+	options.rotation = rotation;
+	options.mirror = mirror;
+
+	VideoFrameStore<int> store;
+	ASSERT_TRUE(Store(store, image, 1, options));
+
+	VideoBuffer converted;
+	ASSERT_TRUE(Convert(converted, image));
+	VideoBuffer expected;
+	Transform(expected, converted, rotation, mirror);
+
+	store.Read([&](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_TRUE(SameSurface(expected, frame.surface));
+	});
+}
+
+TEST_P(VideoFrameStoreTransform, ScalesToTargetBeforeRotation)
+{
+	int rotation = std::get<0>(GetParam());
+	bool mirror = std::get<1>(GetParam());
+	bool transposed = rotation == 90 || rotation == 270;
+
+	TestI420 image = MakeNoise(128, 96);
+	// Target is the displayed size, after rotation
+	RenderOptions options = transposed ? Target(48, 64) : Target(64, 48);
+	options.rotation = rotation;
+	options.mirror = mirror;
+
+	VideoFrameStore<int> store;
+	ASSERT_TRUE(Store(store, image, 1, options));
+
+	VideoBuffer converted;
+	ASSERT_TRUE(Convert(converted, Scale(image, 64, 48, ScaleFilter::Box)));
+	VideoBuffer expected;
+	Transform(expected, converted, rotation, mirror);
+
+	store.Read([&](VideoFrameStore<int>::Frame& frame) {
+		EXPECT_EQ((size_t)options.targetWidth, frame.surface.width);
+		EXPECT_EQ((size_t)options.targetHeight, frame.surface.height);
+		EXPECT_TRUE(SameSurface(expected, frame.surface));
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(Rotations, VideoFrameStoreTransform,
+	testing::Combine(testing::Values(0, 90, 180, 270), testing::Bool()));
+
+namespace {
+
+bool CropAndScale(YUVBuffer& buffer, const TestI420& image, const ImageRect& region, int width, int height)
+{
+	return CropAndScaleI420(buffer,
+		image.y.data(), image.StrideY(),
+		image.u.data(), image.StrideUV(),
+		image.v.data(), image.StrideUV(),
+		image.width, image.height,
+		region, width, height, ScaleFilter::Box);
+}
+
+ImageRect Rect(int x, int y, int width, int height)
+{
+	ImageRect rect;
+	rect.x = x;
+	rect.y = y;
+	rect.width = width;
+	rect.height = height;
+	return rect;
+}
+
+// Copy of a region of an image, origin on even pixels
+TestI420 Crop(const TestI420& image, const ImageRect& rect)
+{
+	TestI420 crop(rect.width, rect.height);
+	for (int j = 0; j < rect.height; ++j)
+		memcpy(&crop.y[j * crop.StrideY()], &image.y[(rect.y + j) * image.StrideY() + rect.x], rect.width);
+	for (int j = 0; j < (rect.height + 1) / 2; ++j)
+	{
+		memcpy(&crop.u[j * crop.StrideUV()], &image.u[(rect.y / 2 + j) * image.StrideUV() + rect.x / 2], crop.StrideUV());
+		memcpy(&crop.v[j * crop.StrideUV()], &image.v[(rect.y / 2 + j) * image.StrideUV() + rect.x / 2], crop.StrideUV());
+	}
+	return crop;
+}
+
+bool SamePlanes(const TestI420& image, const YUVBuffer& buffer)
+{
+	if (image.width != buffer.width || image.height != buffer.height)
+		return false;
+	for (int j = 0; j < image.height; ++j)
+		if (memcmp(&image.y[j * image.StrideY()], buffer.DataY() + j * buffer.strideY, image.width))
+			return false;
+	for (int j = 0; j < (image.height + 1) / 2; ++j)
+		if (memcmp(&image.u[j * image.StrideUV()], buffer.DataU() + j * buffer.strideUV, image.StrideUV()) ||
+			memcmp(&image.v[j * image.StrideUV()], buffer.DataV() + j * buffer.strideUV, image.StrideUV()))
+			return false;
+	return true;
+}
+
+}
+
+TEST(CropAndScaleI420, CopiesRegionAtSameSize)
+{
+	TestI420 image = MakeNoise(64, 48);
+	YUVBuffer buffer;
+
+	ASSERT_TRUE(CropAndScale(buffer, image, Rect(8, 6, 32, 20), 32, 20));
+	EXPECT_TRUE(SamePlanes(Crop(image, Rect(8, 6, 32, 20)), buffer));
+}
+
+TEST(CropAndScaleI420, ScalesRegion)
+{
+	TestI420 image = MakeNoise(64, 48);
+	YUVBuffer buffer;
+
+	ASSERT_TRUE(CropAndScale(buffer, image, Rect(16, 8, 32, 32), 16, 16));
+	EXPECT_TRUE(SamePlanes(Scale(Crop(image, Rect(16, 8, 32, 32)), 16, 16, ScaleFilter::Box), buffer));
+}
+
+TEST(CropAndScaleI420, AlignsOriginToChroma)
+{
+	TestI420 image = MakeNoise(64, 48);
+	YUVBuffer buffer;
+
+	// Odd origin moves back one pixel, the far edges stay
+	ASSERT_TRUE(CropAndScale(buffer, image, Rect(9, 7, 31, 19), 32, 20));
+	EXPECT_TRUE(SamePlanes(Crop(image, Rect(8, 6, 32, 20)), buffer));
+}
+
+TEST(CropAndScaleI420, ClampsRegionToImage)
+{
+	TestI420 image = MakeNoise(64, 48);
+	YUVBuffer buffer;
+
+	ASSERT_TRUE(CropAndScale(buffer, image, Rect(-10, 32, 40, 100), 30, 16));
+	EXPECT_TRUE(SamePlanes(Crop(image, Rect(0, 32, 30, 16)), buffer));
+}
+
+TEST(CropAndScaleI420, RejectsEmptyRegion)
+{
+	TestI420 image = MakeNoise(64, 48);
+	YUVBuffer buffer;
+
+	EXPECT_FALSE(CropAndScale(buffer, image, Rect(64, 0, 10, 10), 10, 10));
+	EXPECT_FALSE(CropAndScale(buffer, image, Rect(0, 0, 0, 10), 10, 10));
+	EXPECT_FALSE(CropAndScale(buffer, image, Rect(0, 0, 10, 10), 0, 10));
+}
+
+class UnrotateRectTest : public testing::TestWithParam<int>
+{
+};
+
+TEST_P(UnrotateRectTest, PointsAtSameSourcePixels)
+{
+	int rotation = GetParam();
+	TestI420 image = MakeNoise(40, 24);
+
+	VideoBuffer plain;
+	ASSERT_TRUE(Convert(plain, image));
+
+	RenderOptions options;
+	options.rotation = rotation;
+	VideoFrameStore<int> store;
+	ASSERT_TRUE(Store(store, image, 1, options));
+
+	store.Read([&](VideoFrameStore<int>::Frame& frame) {
+		// Every corner of a rectangle on the displayed image lands on a corner of the unrotated one
+		ImageRect rect = Rect(3, 5, 7, 4);
+		ImageRect src = UnrotateRect(rect, image.width, image.height, rotation);
+
+		std::multiset<uint32_t> displayed;
+		std::multiset<uint32_t> source;
+		for (int j : { 0, 1 })
+			for (int i : { 0, 1 })
+			{
+				displayed.insert(*(const uint32_t*)PixelAt(frame.surface, rect.x + i * (rect.width - 1), rect.y + j * (rect.height - 1)));
+				source.insert(*(const uint32_t*)PixelAt(plain, src.x + i * (src.width - 1), src.y + j * (src.height - 1)));
+			}
+		EXPECT_EQ(displayed, source);
+		EXPECT_EQ((int64_t)rect.width * rect.height, (int64_t)src.width * src.height);
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(Rotations, UnrotateRectTest, testing::Values(0, 90, 180, 270));
+
+class VideoFrameStoreSlices : public testing::TestWithParam<std::tuple<int, bool, bool>>
+{
+};
+
+TEST_P(VideoFrameStoreSlices, MatchesSingleThreadConversion)
+{
+	// Integer ratio, so slices scale exactly as the whole image
+	TestI420 image = MakeNoise(1280, 720);
+	RenderOptions options = std::get<2>(GetParam()) ? Target(640, 360) : RenderOptions();
+	options.rotation = std::get<0>(GetParam());
+	options.mirror = std::get<1>(GetParam());
+	if (options.rotation == 90 || options.rotation == 270)
+		std::swap(options.targetWidth, options.targetHeight);
+
+	VideoFrameStore<int> single;
+	ASSERT_TRUE(Store(single, image, 1, options));
+
+	WorkerPool pool(3);
+	VideoFrameStore<int> sliced;
+	sliced.SetThreads(&pool, 4);
+	ASSERT_TRUE(Store(sliced, image, 1, options));
+
+	single.Read([&](VideoFrameStore<int>::Frame& expected) {
+		sliced.Read([&](VideoFrameStore<int>::Frame& frame) {
+			EXPECT_TRUE(SameSurface(expected.surface, frame.surface));
+		});
+	});
+}
+
+TEST_P(VideoFrameStoreSlices, MatchesSingleThreadAtAnyRatio)
+{
+	// Slice edges fall between source rows, the scale must not see them
+	TestI420 image = MakeNoise(1920, 1080);
+	RenderOptions options = Target(1000, 563);
+	options.rotation = std::get<0>(GetParam());
+	options.mirror = std::get<1>(GetParam());
+	options.filter = std::get<2>(GetParam()) ? ScaleFilter::Box : ScaleFilter::Bilinear;
+	if (options.rotation == 90 || options.rotation == 270)
+		std::swap(options.targetWidth, options.targetHeight);
+
+	VideoFrameStore<int> single;
+	ASSERT_TRUE(Store(single, image, 1, options));
+
+	WorkerPool pool(3);
+	VideoFrameStore<int> sliced;
+	sliced.SetThreads(&pool, 4);
+	ASSERT_TRUE(Store(sliced, image, 1, options));
+
+	single.Read([&](VideoFrameStore<int>::Frame& expected) {
+		sliced.Read([&](VideoFrameStore<int>::Frame& frame) {
+			EXPECT_TRUE(SameSurface(expected.surface, frame.surface));
+		});
+	});
+}
+
+INSTANTIATE_TEST_CASE_P(Transforms, VideoFrameStoreSlices,
+	testing::Combine(testing::Values(0, 90, 180, 270), testing::Bool(), testing::Bool()));
+
+TEST(VideoBuffer, GrowsOnly)
+{
+	VideoBuffer buffer;
+	ASSERT_TRUE(buffer.Reserve(64, 48));
+	uint8_t* image = buffer.image;
+	size_t capacity = buffer.capacity;
+
+	ASSERT_TRUE(buffer.Reserve(32, 24));
+	EXPECT_EQ(image, buffer.image);
+	EXPECT_EQ(capacity, buffer.capacity);
+	EXPECT_EQ(32u, buffer.width);
+	EXPECT_EQ(24u, buffer.height);
+	EXPECT_EQ(32u * 4, buffer.stride);
+}
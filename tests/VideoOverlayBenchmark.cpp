@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "VideoOverlay.hpp"
+
+namespace {
+
+// A few annotations as an agent would draw them
+std::vector<OverlayShape> MakeShapes()
+{
+	std::vector<OverlayShape> shapes(4);
+	shapes[0].type = OverlayShape::Type::Arrow;
+	shapes[0].x1 = 0.1f;
+	shapes[0].y1 = 0.1f;
+	shapes[0].x2 = 0.4f;
+	shapes[0].y2 = 0.35f;
+	shapes[1].type = OverlayShape::Type::Circle;
+	shapes[1].x1 = 0.5f;
+	shapes[1].y1 = 0.5f;
+	shapes[1].radius = 0.1f;
+	shapes[2].type = OverlayShape::Type::Line;
+	shapes[2].x1 = 0.2f;
+	shapes[2].y1 = 0.8f;
+	shapes[2].x2 = 0.8f;
+	shapes[2].y2 = 0.8f;
+	shapes[3].type = OverlayShape::Type::Anchor;
+	shapes[3].x1 = 0.6f;
+	shapes[3].y1 = 0.3f;
+	shapes[3].lineWidth = 10;
+	shapes[3].text = "Press the reset button";
+	return shapes;
+}
+
+}
+
+// Paid once per change of the shapes, on the pool
+static void Rasterize(benchmark::State& state)
+{
+	std::vector<OverlayShape> shapes = MakeShapes();
+	OverlayLayer layer;
+
+	for (auto _ : state)
+	{
+		RasterizeOverlay(shapes, layer, (int)state.range(0), (int)state.range(1));
+		benchmark::DoNotOptimize(layer.image.image);
+	}
+}
+BENCHMARK(Rasterize)->Args({ 1280, 720 })->Args({ 1920, 1080 });
+
+// Paid on every frame
+static void Blend(benchmark::State& state)
+{
+	OverlayLayer layer;
+	RasterizeOverlay(MakeShapes(), layer, (int)state.range(0), (int)state.range(1));
+	VideoBuffer surface;
+	surface.Reserve(state.range(0), state.range(1));
+
+	for (auto _ : state)
+	{
+		BlendOverlay(surface, layer);
+		benchmark::DoNotOptimize(surface.image);
+	}
+}
+BENCHMARK(Blend)->Args({ 1280, 720 })->Args({ 1920, 1080 });
@@ -0,0 +1,348 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "TestImages.hpp"
+#include "VideoOverlay.hpp"
+
+namespace {
+
+OverlayShape Line(float x1, float y1, float x2, float y2, uint32_t color = 0xFFFF0000)
+{
+	OverlayShape shape;
+	shape.type = OverlayShape::Type::Line;
+	shape.x1 = x1;
+	shape.y1 = y1;
+	shape.x2 = x2;
+	shape.y2 = y2;
+	shape.color = color;
+	return shape;
+}
+
+OverlayShape Anchor(float x, float y, const std::string& text)
+{
+	OverlayShape shape;
+	shape.type = OverlayShape::Type::Anchor;
+	shape.x1 = x;
+	shape.y1 = y;
+	shape.lineWidth = 8;
+	shape.text = text;
+	return shape;
+}
+
+// Surface filled with one BGRA value
+void Fill(VideoBuffer& surface, int width, int height, uint32_t pixel)
+{
+	surface.Reserve(width, height);
+	for (int y = 0; y < height; ++y)
+		for (int x = 0; x < width; ++x)
+			memcpy(surface.image + y * surface.stride + x * 4, &pixel, 4);
+}
+
+uint32_t Pixel(const VideoBuffer& buffer, int x, int y)
+{
+	return *(const uint32_t*)PixelAt(buffer, x, y);
+}
+
+// Rightmost drawn column over all rows
+int DrawnRight(const OverlayLayer& layer)
+{
+	int right = 0;
+	for (size_t y = 0; y < layer.rowEnd.size(); ++y)
+		if (layer.rowStart[y] < layer.rowEnd[y] && layer.rowEnd[y] > right)
+			right = layer.rowEnd[y];
+	return right;
+}
+
+bool WaitForGeneration(const VideoOverlay& overlay, uint64_t generation)
+{
+	for (int i = 0; i < 500 && overlay.GetGeneration() < generation; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return overlay.GetGeneration() >= generation;
+}
+
+}
+
+TEST(ParseOverlayColor, ParsesLongAndShortForms)
+{
+	uint32_t rgb = 0;
+	EXPECT_TRUE(ParseOverlayColor("#ff8800", rgb));
+	EXPECT_EQ(0xFF8800u, rgb);
+	EXPECT_TRUE(ParseOverlayColor("#ABCDEF", rgb));
+	EXPECT_EQ(0xABCDEFu, rgb);
+	EXPECT_TRUE(ParseOverlayColor("#f80", rgb));
+	EXPECT_EQ(0xFF8800u, rgb);
+}
+
+TEST(ParseOverlayColor, RejectsOtherStrings)
+{
+	uint32_t rgb = 0x123456;
+	for (const char* text : { "", "#", "red", "ff8800", "#ff88", "#ff88000", "#ggg", "#12345z" })
+		EXPECT_FALSE(ParseOverlayColor(text, rgb)) << text;
+	EXPECT_EQ(0x123456u, rgb);
+}
+
+TEST(RasterizeOverlay, NothingDrawnWithoutShapes)
+{
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({}, layer, 64, 48));
+
+	EXPECT_EQ(64u, layer.image.width);
+	EXPECT_EQ(48u, layer.image.height);
+	EXPECT_EQ(0, DrawnRight(layer));
+	EXPECT_EQ(0u, Pixel(layer.image, 32, 24));
+}
+
+TEST(RasterizeOverlay, DrawsLinesOnTheirRowsOnly)
+{
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ Line(0.1f, 0.5f, 0.9f, 0.5f) }, layer, 100, 50));
+
+	// Opaque red in the middle of the stroke, as B, G, R, A in memory
+	EXPECT_EQ(0xFFFF0000u, Pixel(layer.image, 50, 25));
+	EXPECT_EQ(0u, Pixel(layer.image, 50, 10));
+	EXPECT_EQ(0u, Pixel(layer.image, 5, 25));
+
+	for (int y = 0; y < 50; ++y)
+	{
+		if (y < 22 || y > 27)
+		{
+			EXPECT_EQ(layer.rowStart[y], layer.rowEnd[y]) << "row " << y;
+		}
+	}
+	EXPECT_LE(layer.rowStart[25], 10);
+	EXPECT_GE(layer.rowEnd[25], 90);
+}
+
+TEST(RasterizeOverlay, PremultipliesTranslucentColors)
+{
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ Line(0.1f, 0.5f, 0.9f, 0.5f, 0x80FF0000) }, layer, 100, 50));
+
+	const uint8_t* pixel = PixelAt(layer.image, 50, 25);
+	EXPECT_EQ(0x80, pixel[3]);
+	EXPECT_EQ(0x80, pixel[2]);
+	EXPECT_EQ(0, pixel[1]);
+}
+
+TEST(RasterizeOverlay, SkipsInvisibleShapes)
+{
+	OverlayShape thin = Line(0.1f, 0.5f, 0.9f, 0.5f);
+	thin.lineWidth = 0;
+
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ Line(0.1f, 0.5f, 0.9f, 0.5f, 0x00FF0000), thin }, layer, 100, 50));
+	EXPECT_EQ(0, DrawnRight(layer));
+}
+
+TEST(RasterizeOverlay, DrawsCircleOutline)
+{
+	OverlayShape circle;
+	circle.type = OverlayShape::Type::Circle;
+	circle.x1 = 0.5f;
+	circle.y1 = 0.5f;
+	circle.radius = 0.25f;
+
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ circle }, layer, 100, 100));
+
+	EXPECT_EQ(0u, Pixel(layer.image, 50, 50));
+	EXPECT_EQ(0xFFFF0000u, Pixel(layer.image, 75, 50));
+	EXPECT_EQ(0xFFFF0000u, Pixel(layer.image, 50, 25));
+	EXPECT_EQ(0u, Pixel(layer.image, 90, 50));
+}
+
+TEST(RasterizeOverlay, DrawsAnchorTextToTheRight)
+{
+	OverlayLayer dot;
+	ASSERT_TRUE(RasterizeOverlay({ Anchor(0.25f, 0.5f, "") }, dot, 200, 50));
+	EXPECT_EQ(0xFFFF0000u, Pixel(dot.image, 50, 25));
+
+	OverlayLayer label;
+	ASSERT_TRUE(RasterizeOverlay({ Anchor(0.25f, 0.5f, "Tap") }, label, 200, 50));
+	OverlayLayer longer;
+	ASSERT_TRUE(RasterizeOverlay({ Anchor(0.25f, 0.5f, "Tap here") }, longer, 200, 50));
+
+	// Three glyphs of 6 dots of 2 pixels, a quarter of the font size after the dot
+	EXPECT_LE(DrawnRight(dot), 56);
+	EXPECT_NEAR(50 + 4 + 4 + 3 * 6 * 2, DrawnRight(label), 3);
+	EXPECT_GT(DrawnRight(longer), DrawnRight(label));
+}
+
+TEST(RasterizeOverlay, ClipsShapesToLayer)
+{
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ Line(-1, -1, 2, 2), Anchor(0.9f, 0.5f, "Clipped text") }, layer, 64, 48));
+
+	for (int y = 0; y < 48; ++y)
+	{
+		EXPECT_GE(layer.rowStart[y], 0);
+		EXPECT_LE(layer.rowEnd[y], 64);
+	}
+}
+
+TEST(BlendOverlay, MatchesPerPixelBlend)
+{
+	// Widths around the 4 pixel vector steps, valid premultiplied pixels
+	for (int width = 1; width <= 19; ++width)
+	{
+		OverlayLayer layer;
+		ASSERT_TRUE(RasterizeOverlay({}, layer, width, 4));
+		uint32_t seed = width;
+		for (int y = 0; y < 4; ++y)
+		{
+			layer.rowStart[y] = 0;
+			layer.rowEnd[y] = width;
+			for (int x = 0; x < width; ++x)
+			{
+				uint8_t* pixel = layer.image.image + y * layer.image.stride + x * 4;
+				seed = seed * 1664525 + 1013904223;
+				uint8_t alpha = (uint8_t)(seed >> 24);
+				// Some fully transparent runs too
+				if (x % 5 == 0)
+					alpha = 0;
+				for (int i = 0; i < 3; ++i)
+					pixel[i] = alpha ? (uint8_t)((seed >> (i * 8)) % (alpha + 1)) : 0;
+				pixel[3] = alpha;
+			}
+		}
+
+		VideoBuffer surface;
+		ASSERT_TRUE(ConvertI420ToARGB(surface,
+			MakeNoise(width, 4).y.data(), width,
+			MakeNoise(width, 4).u.data(), (width + 1) / 2,
+			MakeNoise(width, 4).v.data(), (width + 1) / 2,
+			width, 4));
+
+		std::vector<uint8_t> expected(surface.image, surface.image + surface.stride * 4);
+		for (int y = 0; y < 4; ++y)
+			for (int x = 0; x < width; ++x)
+			{
+				const uint8_t* src = layer.image.image + y * layer.image.stride + x * 4;
+				uint8_t* dst = expected.data() + y * surface.stride + x * 4;
+				for (int i = 0; i < 4; ++i)
+				{
+					uint32_t under = dst[i] * (255 - src[3]) + 128;
+					uint32_t value = src[i] + ((under + (under >> 8)) >> 8);
+					dst[i] = (uint8_t)(value > 255 ? 255 : value);
+				}
+			}
+
+		BlendOverlay(surface, layer);
+		EXPECT_EQ(0, memcmp(expected.data(), surface.image, expected.size())) << "width " << width;
+	}
+}
+
+TEST(BlendOverlay, LeavesUndrawnPixels)
+{
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ Line(0.1f, 0.5f, 0.9f, 0.5f) }, layer, 100, 50));
+
+	VideoBuffer surface;
+	Fill(surface, 100, 50, 0xFF808080);
+	BlendOverlay(surface, layer);
+
+	EXPECT_EQ(0xFFFF0000u, Pixel(surface, 50, 25));
+	EXPECT_EQ(0xFF808080u, Pixel(surface, 50, 10));
+}
+
+TEST(BlendOverlay, IgnoresLayerOfAnotherSize)
+{
+	OverlayLayer layer;
+	ASSERT_TRUE(RasterizeOverlay({ Line(0, 0, 1, 1) }, layer, 100, 50));
+
+	VideoBuffer surface;
+	Fill(surface, 50, 100, 0xFF808080);
+	BlendOverlay(surface, layer);
+
+	for (int y = 0; y < 100; ++y)
+		for (int x = 0; x < 50; ++x)
+			ASSERT_EQ(0xFF808080u, Pixel(surface, x, y));
+}
+
+TEST(VideoOverlay, RasterizesOnThePool)
+{
+	WorkerPool pool(1);
+	VideoOverlay overlay;
+	VideoBuffer surface;
+
+	overlay.SetShapes({ Line(0.1f, 0.5f, 0.9f, 0.5f) });
+	uint64_t generation = overlay.GetGeneration();
+
+	// No layer yet, the frame is shown without it
+	Fill(surface, 100, 50, 0xFF808080);
+	overlay.Apply(surface, pool);
+	EXPECT_EQ(0xFF808080u, Pixel(surface, 50, 25));
+
+	ASSERT_TRUE(WaitForGeneration(overlay, generation + 1));
+	EXPECT_EQ(1u, overlay.GetRasterized());
+
+	Fill(surface, 100, 50, 0xFF808080);
+	overlay.Apply(surface, pool);
+	EXPECT_EQ(0xFFFF0000u, Pixel(surface, 50, 25));
+
+	// Same shapes and size, nothing new to draw
+	overlay.Apply(surface, pool);
+	pool.Stop();
+	EXPECT_EQ(1u, overlay.GetRasterized());
+}
+
+TEST(VideoOverlay, RasterizesAgainForNewSize)
+{
+	WorkerPool pool(1);
+	VideoOverlay overlay;
+	VideoBuffer surface;
+
+	overlay.SetShapes({ Line(0.1f, 0.5f, 0.9f, 0.5f) });
+	Fill(surface, 100, 50, 0xFF808080);
+	overlay.Apply(surface, pool);
+	ASSERT_TRUE(WaitForGeneration(overlay, 1));
+
+	// Old layer does not fit, the frame is shown without it until the new one is ready
+	Fill(surface, 50, 100, 0xFF808080);
+	overlay.Apply(surface, pool);
+	EXPECT_EQ(0xFF808080u, Pixel(surface, 25, 50));
+
+	ASSERT_TRUE(WaitForGeneration(overlay, 2));
+	overlay.Apply(surface, pool);
+	EXPECT_EQ(0xFFFF0000u, Pixel(surface, 25, 50));
+	EXPECT_EQ(2u, overlay.GetRasterized());
+}
+
+TEST(VideoOverlay, RemovingShapesDropsLayerAtOnce)
+{
+	WorkerPool pool(1);
+	VideoOverlay overlay;
+	VideoBuffer surface;
+
+	overlay.SetShapes({ Line(0.1f, 0.5f, 0.9f, 0.5f) });
+	Fill(surface, 100, 50, 0xFF808080);
+	overlay.Apply(surface, pool);
+	ASSERT_TRUE(WaitForGeneration(overlay, 1));
+
+	overlay.SetShapes({});
+	EXPECT_EQ(2u, overlay.GetGeneration());
+
+	overlay.Apply(surface, pool);
+	EXPECT_EQ(0xFF808080u, Pixel(surface, 50, 25));
+}
+
+TEST(VideoOverlay, RasterizesInPlaceWhenPoolIsStopped)
+{
+	WorkerPool pool(1);
+	pool.Stop();
+	VideoOverlay overlay;
+	VideoBuffer surface;
+
+	overlay.SetShapes({ Line(0.1f, 0.5f, 0.9f, 0.5f) });
+	Fill(surface, 100, 50, 0xFF808080);
+	overlay.Apply(surface, pool);
+
+	EXPECT_EQ(1u, overlay.GetGeneration());
+	overlay.Apply(surface, pool);
+	EXPECT_EQ(0xFFFF0000u, Pixel(surface, 50, 25));
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+TEST(WorkerPool, RunsHooksOnEachThread)
+{
+	std::mutex mutex;
+	std::set<std::thread::id> initialized;
+	std::set<std::thread::id> uninitialized;
+	std::atomic<int> unprepared{ 0 };
+
+	{
+		WorkerPool pool(3,
+			[&]() {
+				std::lock_guard<std::mutex> lock(mutex);
+				initialized.insert(std::this_thread::get_id());
+			},
+			[&]() {
+				std::lock_guard<std::mutex> lock(mutex);
+				uninitialized.insert(std::this_thread::get_id());
+			});
+
+		for (int i = 0; i < 30; ++i)
+			pool.Post([&]() {
+				std::lock_guard<std::mutex> lock(mutex);
+				// Hooks bracket every task run on the thread
+				if (!initialized.count(std::this_thread::get_id()) || uninitialized.count(std::this_thread::get_id()))
+					unprepared++;
+			});
+	}
+
+	EXPECT_EQ(3u, initialized.size());
+	EXPECT_EQ(initialized, uninitialized);
+	EXPECT_EQ(0, unprepared);
+}
+
+TEST(WorkerPool, RunsPostedTasks)
+{
+	std::atomic<int> runs{ 0 };
+	{
+		WorkerPool pool(2);
+		EXPECT_EQ(2u, pool.GetSize());
+		for (int i = 0; i < 100; ++i)
+			EXPECT_TRUE(pool.Post([&]() { runs++; }));
+	}
+
+	// Destruction drains the queue
+	EXPECT_EQ(100, runs);
+}
+
+TEST(WorkerPool, RunsTasksInOrderOnSingleThread)
+{
+	std::vector<int> order;
+	{
+		WorkerPool pool(1);
+		for (int i = 0; i < 10; ++i)
+			pool.Post([&order, i]() { order.push_back(i); });
+	}
+
+	EXPECT_EQ((std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }), order);
+}
+
+TEST(WorkerPool, RejectsPostsOnceStopped)
+{
+	WorkerPool pool(1);
+	pool.Stop();
+	pool.Stop();
+
+	EXPECT_FALSE(pool.Post([]() {}));
+}
+
+TEST(WorkerPool, DefaultSizeLeavesCallerACore)
+{
+	WorkerPool pool(0);
+	EXPECT_EQ(WorkerPool::GetDefaultSize(), pool.GetSize());
+	EXPECT_GE(WorkerPool::GetDefaultSize(), 1u);
+}
+
+TEST(WorkerPool, ParallelForRunsEachIndexOnce)
+{
+	WorkerPool pool(3);
+	std::vector<std::atomic<int>> runs(1000);
+	for (auto& count : runs)
+		count = 0;
+
+	pool.ParallelFor(runs.size(), [&](size_t index) { runs[index]++; });
+
+	for (size_t i = 0; i < runs.size(); ++i)
+		ASSERT_EQ(1, runs[i]) << "index " << i;
+}
+
+TEST(WorkerPool, ParallelForWithNothingToDo)
+{
+	WorkerPool pool(2);
+	bool ran = false;
+
+	pool.ParallelFor(0, [&](size_t) { ran = true; });
+
+	EXPECT_FALSE(ran);
+}
+
+TEST(WorkerPool, ParallelForSpreadsOverThreads)
+{
+	WorkerPool pool(3);
+	std::mutex mutex;
+	std::set<std::thread::id> threads;
+
+	pool.ParallelFor(16, [&](size_t) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			threads.insert(std::this_thread::get_id());
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	});
+
+	EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(WorkerPool, ParallelForFinishesWhenPoolIsBusy)
+{
+	WorkerPool pool(2);
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool release = false;
+
+	// Keep every pool thread busy until the loop is done
+	for (int i = 0; i < 2; ++i)
+		pool.Post([&]() {
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() { return release; });
+		});
+
+	std::atomic<int> runs{ 0 };
+	pool.ParallelFor(10, [&](size_t) { runs++; });
+	EXPECT_EQ(10, runs);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		release = true;
+	}
+	cond.notify_all();
+}
@@ -0,0 +1,11 @@
+// Stands in for the plugin log sink, tracing goes nowhere
+#ifndef FAKE_LOG_SINK_IMPL_H
+#define FAKE_LOG_SINK_IMPL_H
+
+#include "rtc_base/logging.h"
+
+#define FUNC_BEGIN()
+#define FUNC_END()
+#define FUNC_END_RET_S(r)	return r
+
+#endif
@@ -0,0 +1,14 @@
+// absl::optional of a C++14 toolchain
+#ifndef FAKE_ABSL_TYPES_OPTIONAL_H
+#define FAKE_ABSL_TYPES_OPTIONAL_H
+
+#include <experimental/optional>
+
+namespace absl {
+
+using std::experimental::optional;
+using std::experimental::nullopt;
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+// Same behaviour as webrtc api/scoped_refptr.h of M75
+#ifndef FAKE_API_SCOPED_REFPTR_H
+#define FAKE_API_SCOPED_REFPTR_H
+
+#include <utility>
+
+namespace rtc {
+
+template<class T>
+class scoped_refptr
+{
+public:
+	scoped_refptr() : ptr(nullptr) {}
+
+	scoped_refptr(T* p) : ptr(p)
+	{
+		if (ptr)
+			ptr->AddRef();
+	}
+
+	scoped_refptr(const scoped_refptr<T>& r) : scoped_refptr(r.ptr) {}
+
+	template<typename U>
+	scoped_refptr(const scoped_refptr<U>& r) : scoped_refptr(r.get()) {}
+
+	scoped_refptr(scoped_refptr<T>&& r) : ptr(r.ptr)
+	{
+		r.ptr = nullptr;
+	}
+
+	template<typename U>
+	scoped_refptr(scoped_refptr<U>&& r) : ptr(r.release()) {}
+
+	~scoped_refptr()
+	{
+		if (ptr)
+			ptr->Release();
+	}
+
+	T* get() const { return ptr; }
+	operator T*() const { return ptr; }
+	T* operator->() const { return ptr; }
+
+	// Returns the pointer without releasing it
+	T* release()
+	{
+		T* retVal = ptr;
+		ptr = nullptr;
+		return retVal;
+	}
+
+	scoped_refptr<T>& operator=(T* p)
+	{
+		// AddRef first so that self assignment works
+		if (p)
+			p->AddRef();
+		if (ptr)
+			ptr->Release();
+		ptr = p;
+		return *this;
+	}
+
+	scoped_refptr<T>& operator=(const scoped_refptr<T>& r)
+	{
+		return *this = r.ptr;
+	}
+
+	scoped_refptr<T>& operator=(scoped_refptr<T>&& r)
+	{
+		scoped_refptr<T>(std::move(r)).swap(*this);
+		return *this;
+	}
+
+	void swap(scoped_refptr<T>& r)
+	{
+		std::swap(ptr, r.ptr);
+	}
+
+protected:
+	T* ptr;
+};
+
+}
+
+#endif
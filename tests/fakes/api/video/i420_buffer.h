@@ -0,0 +1,88 @@
+// Subset of webrtc api/video/i420_buffer.h. Scaling picks the nearest
+// source pixel instead of filtering, so tests can tell where pixels came from.
+#ifndef FAKE_API_VIDEO_I420_BUFFER_H
+#define FAKE_API_VIDEO_I420_BUFFER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <memory>
+
+#include "api/scoped_refptr.h"
+#include "api/video/video_frame_buffer.h"
+#include "rtc_base/ref_counted_object.h"
+
+namespace webrtc {
+
+class I420Buffer : public I420BufferInterface
+{
+public:
+	static rtc::scoped_refptr<I420Buffer> Create(int width, int height)
+	{
+		return new rtc::RefCountedObject<I420Buffer>(width, height);
+	}
+
+	static void SetBlack(I420Buffer* buffer)
+	{
+		memset(buffer->MutableDataY(), 0, buffer->StrideY() * buffer->height());
+		memset(buffer->MutableDataU(), 128, buffer->StrideU() * buffer->ChromaHeight());
+		memset(buffer->MutableDataV(), 128, buffer->StrideV() * buffer->ChromaHeight());
+	}
+
+	int width() const override { return width_; }
+	int height() const override { return height_; }
+
+	const uint8_t* DataY() const override { return data_.get(); }
+	const uint8_t* DataU() const override { return DataY() + StrideY() * height_; }
+	const uint8_t* DataV() const override { return DataU() + StrideU() * ChromaHeight(); }
+	int StrideY() const override { return width_; }
+	int StrideU() const override { return ChromaWidth(); }
+	int StrideV() const override { return ChromaWidth(); }
+
+	uint8_t* MutableDataY() { return const_cast<uint8_t*>(DataY()); }
+	uint8_t* MutableDataU() { return const_cast<uint8_t*>(DataU()); }
+	uint8_t* MutableDataV() { return const_cast<uint8_t*>(DataV()); }
+
+	// Scale the crop rectangle of src into this buffer, offsets should be even
+	void CropAndScaleFrom(const I420BufferInterface& src, int offset_x, int offset_y, int crop_width, int crop_height)
+	{
+		ScalePlane(src.DataY() + offset_y * src.StrideY() + offset_x, src.StrideY(), crop_width, crop_height,
+			MutableDataY(), StrideY(), width_, height_);
+		ScalePlane(src.DataU() + offset_y / 2 * src.StrideU() + offset_x / 2, src.StrideU(), (crop_width + 1) / 2, (crop_height + 1) / 2,
+			MutableDataU(), StrideU(), ChromaWidth(), ChromaHeight());
+		ScalePlane(src.DataV() + offset_y / 2 * src.StrideV() + offset_x / 2, src.StrideV(), (crop_width + 1) / 2, (crop_height + 1) / 2,
+			MutableDataV(), StrideV(), ChromaWidth(), ChromaHeight());
+	}
+
+	void ScaleFrom(const I420BufferInterface& src)
+	{
+		CropAndScaleFrom(src, 0, 0, src.width(), src.height());
+	}
+
+protected:
+	I420Buffer(int width, int height) :
+		width_(width),
+		height_(height),
+		data_(new uint8_t[width * height + ((width + 1) / 2) * ((height + 1) / 2) * 2])
+	{
+	}
+
+	~I420Buffer() override {}
+
+private:
+	static void ScalePlane(const uint8_t* src, int srcStride, int srcWidth, int srcHeight,
+		uint8_t* dst, int dstStride, int dstWidth, int dstHeight)
+	{
+		for (int y = 0; y < dstHeight; ++y)
+			for (int x = 0; x < dstWidth; ++x)
+				dst[y * dstStride + x] = src[(y * srcHeight / dstHeight) * srcStride + x * srcWidth / dstWidth];
+	}
+
+	const int width_;
+	const int height_;
+	std::unique_ptr<uint8_t[]> data_;
+};
+
+}
+
+#endif
@@ -0,0 +1,79 @@
+// Subset of webrtc api/video/video_frame.h
+#ifndef FAKE_API_VIDEO_VIDEO_FRAME_H
+#define FAKE_API_VIDEO_VIDEO_FRAME_H
+
+#include <stdint.h>
+
+#include "api/scoped_refptr.h"
+#include "api/video/video_frame_buffer.h"
+#include "api/video/video_rotation.h"
+
+namespace webrtc {
+
+class VideoFrame
+{
+public:
+	class Builder
+	{
+	public:
+		VideoFrame build()
+		{
+			return VideoFrame(video_frame_buffer, rotation, timestamp_us, id);
+		}
+
+		Builder& set_video_frame_buffer(const rtc::scoped_refptr<VideoFrameBuffer>& buffer)
+		{
+			video_frame_buffer = buffer;
+			return *this;
+		}
+
+		Builder& set_rotation(VideoRotation value)
+		{
+			rotation = value;
+			return *this;
+		}
+
+		Builder& set_timestamp_us(int64_t value)
+		{
+			timestamp_us = value;
+			return *this;
+		}
+
+		Builder& set_id(uint16_t value)
+		{
+			id = value;
+			return *this;
+		}
+
+	private:
+		rtc::scoped_refptr<VideoFrameBuffer> video_frame_buffer;
+		VideoRotation rotation = kVideoRotation_0;
+		int64_t timestamp_us = 0;
+		uint16_t id = 0;
+	};
+
+	int width() const { return video_frame_buffer_->width(); }
+	int height() const { return video_frame_buffer_->height(); }
+	rtc::scoped_refptr<VideoFrameBuffer> video_frame_buffer() const { return video_frame_buffer_; }
+	VideoRotation rotation() const { return rotation_; }
+	int64_t timestamp_us() const { return timestamp_us_; }
+	uint16_t id() const { return id_; }
+
+private:
+	VideoFrame(const rtc::scoped_refptr<VideoFrameBuffer>& buffer, VideoRotation rotation, int64_t timestamp_us, uint16_t id) :
+		video_frame_buffer_(buffer),
+		rotation_(rotation),
+		timestamp_us_(timestamp_us),
+		id_(id)
+	{
+	}
+
+	rtc::scoped_refptr<VideoFrameBuffer> video_frame_buffer_;
+	VideoRotation rotation_;
+	int64_t timestamp_us_;
+	uint16_t id_;
+};
+
+}
+
+#endif
@@ -0,0 +1,49 @@
+// Subset of webrtc api/video/video_frame_buffer.h, I420 only
+#ifndef FAKE_API_VIDEO_VIDEO_FRAME_BUFFER_H
+#define FAKE_API_VIDEO_VIDEO_FRAME_BUFFER_H
+
+#include <stdint.h>
+
+#include "api/scoped_refptr.h"
+#include "rtc_base/ref_count.h"
+
+namespace webrtc {
+
+class I420BufferInterface;
+
+class VideoFrameBuffer : public rtc::RefCountInterface
+{
+public:
+	virtual int width() const = 0;
+	virtual int height() const = 0;
+	virtual rtc::scoped_refptr<I420BufferInterface> ToI420() = 0;
+
+protected:
+	~VideoFrameBuffer() override {}
+};
+
+class I420BufferInterface : public VideoFrameBuffer
+{
+public:
+	virtual const uint8_t* DataY() const = 0;
+	virtual const uint8_t* DataU() const = 0;
+	virtual const uint8_t* DataV() const = 0;
+	virtual int StrideY() const = 0;
+	virtual int StrideU() const = 0;
+	virtual int StrideV() const = 0;
+
+	int ChromaWidth() const { return (width() + 1) / 2; }
+	int ChromaHeight() const { return (height() + 1) / 2; }
+
+	rtc::scoped_refptr<I420BufferInterface> ToI420() override
+	{
+		return this;
+	}
+
+protected:
+	~I420BufferInterface() override {}
+};
+
+}
+
+#endif
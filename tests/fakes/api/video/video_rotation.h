@@ -0,0 +1,17 @@
+// Same values as webrtc api/video/video_rotation.h
+#ifndef FAKE_API_VIDEO_VIDEO_ROTATION_H
+#define FAKE_API_VIDEO_VIDEO_ROTATION_H
+
+namespace webrtc {
+
+enum VideoRotation
+{
+	kVideoRotation_0 = 0,
+	kVideoRotation_90 = 90,
+	kVideoRotation_180 = 180,
+	kVideoRotation_270 = 270
+};
+
+}
+
+#endif
@@ -0,0 +1,19 @@
+// Same interface as webrtc api/video/video_sink_interface.h
+#ifndef FAKE_API_VIDEO_VIDEO_SINK_INTERFACE_H
+#define FAKE_API_VIDEO_VIDEO_SINK_INTERFACE_H
+
+namespace rtc {
+
+template<typename VideoFrameT>
+class VideoSinkInterface
+{
+public:
+	virtual ~VideoSinkInterface() = default;
+
+	virtual void OnFrame(const VideoFrameT& frame) = 0;
+	virtual void OnDiscardedFrame() {}
+};
+
+}
+
+#endif
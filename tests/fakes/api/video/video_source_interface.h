@@ -0,0 +1,33 @@
+// Same interface as webrtc api/video/video_source_interface.h
+#ifndef FAKE_API_VIDEO_VIDEO_SOURCE_INTERFACE_H
+#define FAKE_API_VIDEO_VIDEO_SOURCE_INTERFACE_H
+
+#include <limits>
+
+#include "absl/types/optional.h"
+#include "api/video/video_sink_interface.h"
+
+namespace rtc {
+
+struct VideoSinkWants
+{
+	bool rotation_applied = false;
+	bool black_frames = false;
+	int max_pixel_count = std::numeric_limits<int>::max();
+	absl::optional<int> target_pixel_count;
+	int max_framerate_fps = std::numeric_limits<int>::max();
+};
+
+template<typename VideoFrameT>
+class VideoSourceInterface
+{
+public:
+	virtual ~VideoSourceInterface() = default;
+
+	virtual void AddOrUpdateSink(VideoSinkInterface<VideoFrameT>* sink, const VideoSinkWants& wants) = 0;
+	virtual void RemoveSink(VideoSinkInterface<VideoFrameT>* sink) = 0;
+};
+
+}
+
+#endif
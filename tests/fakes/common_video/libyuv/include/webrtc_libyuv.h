@@ -0,0 +1,29 @@
+// Subset of webrtc common_video/libyuv/include/webrtc_libyuv.h
+#ifndef FAKE_COMMON_VIDEO_LIBYUV_INCLUDE_WEBRTC_LIBYUV_H
+#define FAKE_COMMON_VIDEO_LIBYUV_INCLUDE_WEBRTC_LIBYUV_H
+
+namespace webrtc {
+
+enum class VideoType
+{
+	kUnknown,
+	kI420,
+	kIYUV,
+	kRGB24,
+	kABGR,
+	kARGB,
+	kARGB4444,
+	kRGB565,
+	kARGB1555,
+	kYUY2,
+	kYV12,
+	kUYVY,
+	kMJPEG,
+	kNV21,
+	kNV12,
+	kBGRA,
+};
+
+}
+
+#endif
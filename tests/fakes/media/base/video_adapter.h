@@ -0,0 +1,95 @@
+// Stands in for webrtc media/base/video_adapter.h with simpler rules: the
+// output halves until it fits the wanted pixel count, frames closer than the
+// wanted frame interval are dropped, and the crop follows the aspect ratio set
+// with SetCropAspectRatio, standing in for an output format request.
+#ifndef FAKE_MEDIA_BASE_VIDEO_ADAPTER_H
+#define FAKE_MEDIA_BASE_VIDEO_ADAPTER_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "absl/types/optional.h"
+
+namespace cricket {
+
+class VideoAdapter
+{
+public:
+	bool AdaptFrameResolution(int in_width, int in_height, int64_t in_timestamp_ns,
+		int* cropped_width, int* cropped_height, int* out_width, int* out_height)
+	{
+		if (max_framerate_fps <= 0)
+			return false;
+
+		// Keep the frames at least one wanted interval apart
+		if (max_framerate_fps < std::numeric_limits<int>::max())
+		{
+			int64_t interval = 1000000000ll / max_framerate_fps;
+			if (has_last && in_timestamp_ns - last_timestamp_ns < interval * 9 / 10)
+				return false;
+			has_last = true;
+			last_timestamp_ns = in_timestamp_ns;
+		}
+
+		*cropped_width = in_width;
+		*cropped_height = in_height;
+		const CropAspect& aspect = GetCropAspect();
+		if (aspect.width > 0 && aspect.height > 0)
+		{
+			*cropped_width = std::min(in_width, in_height * aspect.width / aspect.height) & ~1;
+			*cropped_height = std::min(in_height, in_width * aspect.height / aspect.width) & ~1;
+		}
+
+		// Target pixel count when given, as the real adapter steps towards it
+		int wanted = target_pixel_count ? std::min(*target_pixel_count, max_pixel_count) : max_pixel_count;
+		*out_width = *cropped_width;
+		*out_height = *cropped_height;
+		while (*out_width * *out_height > wanted && *out_width > 1)
+		{
+			*out_width /= 2;
+			*out_height /= 2;
+		}
+
+		return true;
+	}
+
+	void OnResolutionFramerateRequest(const absl::optional<int>& target_pixel_count,
+		int max_pixel_count, int max_framerate_fps)
+	{
+		this->target_pixel_count = target_pixel_count;
+		this->max_pixel_count = max_pixel_count;
+		this->max_framerate_fps = max_framerate_fps;
+	}
+
+	// Aspect ratio every adapter crops to, 0 to keep the input one
+	static void SetCropAspectRatio(int width, int height)
+	{
+		GetCropAspect() = CropAspect{ width, height };
+	}
+
+private:
+	absl::optional<int> target_pixel_count;
+	int max_pixel_count = std::numeric_limits<int>::max();
+	int max_framerate_fps = std::numeric_limits<int>::max();
+	bool has_last = false;
+	int64_t last_timestamp_ns = 0;
+
+	struct CropAspect
+	{
+		int width;
+		int height;
+	};
+
+	// Header only, C++14 has no inline variables
+	static CropAspect& GetCropAspect()
+	{
+		static CropAspect aspect{ 0, 0 };
+		return aspect;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,44 @@
+// Subset of webrtc modules/video_capture/video_capture.h
+#ifndef FAKE_MODULES_VIDEO_CAPTURE_VIDEO_CAPTURE_H
+#define FAKE_MODULES_VIDEO_CAPTURE_VIDEO_CAPTURE_H
+
+#include <stdint.h>
+
+#include "api/video/video_frame.h"
+#include "api/video/video_sink_interface.h"
+#include "modules/video_capture/video_capture_defines.h"
+#include "rtc_base/ref_count.h"
+
+namespace webrtc {
+
+class VideoCaptureModule : public rtc::RefCountInterface
+{
+public:
+	class DeviceInfo
+	{
+	public:
+		virtual ~DeviceInfo() {}
+
+		virtual uint32_t NumberOfDevices() = 0;
+		virtual int32_t GetDeviceName(uint32_t deviceNumber,
+			char* deviceNameUTF8, uint32_t deviceNameLength,
+			char* deviceUniqueIdUTF8, uint32_t deviceUniqueIdUTF8Length,
+			char* productUniqueIdUTF8 = 0, uint32_t productUniqueIdUTF8Length = 0) = 0;
+		virtual int32_t NumberOfCapabilities(const char* deviceUniqueIdUTF8) = 0;
+		virtual int32_t GetCapability(const char* deviceUniqueIdUTF8,
+			const uint32_t deviceCapabilityNumber, VideoCaptureCapability& capability) = 0;
+	};
+
+	virtual void RegisterCaptureDataCallback(rtc::VideoSinkInterface<VideoFrame>* dataCallback) = 0;
+	virtual void DeRegisterCaptureDataCallback() = 0;
+	virtual int32_t StartCapture(const VideoCaptureCapability& capability) = 0;
+	virtual int32_t StopCapture() = 0;
+	virtual bool CaptureStarted() = 0;
+
+protected:
+	~VideoCaptureModule() override {}
+};
+
+}
+
+#endif
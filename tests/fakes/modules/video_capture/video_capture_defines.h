@@ -0,0 +1,22 @@
+// Subset of webrtc modules/video_capture/video_capture_defines.h
+#ifndef FAKE_MODULES_VIDEO_CAPTURE_VIDEO_CAPTURE_DEFINES_H
+#define FAKE_MODULES_VIDEO_CAPTURE_VIDEO_CAPTURE_DEFINES_H
+
+#include <stdint.h>
+
+#include "common_video/libyuv/include/webrtc_libyuv.h"
+
+namespace webrtc {
+
+struct VideoCaptureCapability
+{
+	int32_t width = 0;
+	int32_t height = 0;
+	int32_t maxFPS = 0;
+	VideoType videoType = VideoType::kUnknown;
+	bool interlaced = false;
+};
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+// Stands in for webrtc modules/video_capture/video_capture_factory.h with the
+// cameras tests set up in FakeCaptureDevices. As with DirectShow, a camera
+// already open cannot be opened again until released.
+#ifndef FAKE_MODULES_VIDEO_CAPTURE_VIDEO_CAPTURE_FACTORY_H
+#define FAKE_MODULES_VIDEO_CAPTURE_VIDEO_CAPTURE_FACTORY_H
+
+#include <string.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "api/scoped_refptr.h"
+#include "modules/video_capture/video_capture.h"
+#include "rtc_base/ref_counted_object.h"
+
+namespace webrtc {
+
+class FakeVideoCaptureModule;
+
+// Cameras of the fake factory
+class FakeCaptureDevices
+{
+public:
+	struct Device
+	{
+		std::string name;
+		std::string id;
+		std::vector<VideoCaptureCapability> capabilities;
+		// Opens but fails to start
+		bool broken = false;
+
+		FakeVideoCaptureModule* module = nullptr;
+		int opens = 0;
+		int starts = 0;
+		int stops = 0;
+	};
+
+	static void Add(const std::string& name, const std::string& id, const std::vector<VideoCaptureCapability>& capabilities)
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		Device device;
+		device.name = name;
+		device.id = id;
+		device.capabilities = capabilities;
+		GetDevices().push_back(device);
+	}
+
+	static void Clear()
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		GetDevices().clear();
+	}
+
+	// Null when not set up, valid until the next Add or Clear
+	static Device* Find(const std::string& id)
+	{
+		for (auto& device : GetDevices())
+			if (device.id == id)
+				return &device;
+		return nullptr;
+	}
+
+	// Pushes a frame from the camera to whoever captures it, false when not capturing
+	static bool Deliver(const std::string& id, const VideoFrame& frame);
+
+	static std::vector<Device>& GetDevices()
+	{
+		static std::vector<Device> devices;
+		return devices;
+	}
+
+	static std::mutex& GetMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+};
+
+class FakeVideoCaptureModule : public VideoCaptureModule
+{
+public:
+	explicit FakeVideoCaptureModule(const std::string& id) : id(id) {}
+
+	void RegisterCaptureDataCallback(rtc::VideoSinkInterface<VideoFrame>* dataCallback) override
+	{
+		callback = dataCallback;
+	}
+
+	void DeRegisterCaptureDataCallback() override
+	{
+		callback = nullptr;
+	}
+
+	int32_t StartCapture(const VideoCaptureCapability& capability) override
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		FakeCaptureDevices::Device* device = FakeCaptureDevices::Find(id);
+		if (!device || device->broken)
+			return -1;
+		device->starts++;
+		this->capability = capability;
+		started = true;
+		return 0;
+	}
+
+	int32_t StopCapture() override
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		if (FakeCaptureDevices::Device* device = FakeCaptureDevices::Find(id))
+			if (started)
+				device->stops++;
+		started = false;
+		return 0;
+	}
+
+	bool CaptureStarted() override { return started; }
+
+	const std::string id;
+	VideoCaptureCapability capability;
+	rtc::VideoSinkInterface<VideoFrame>* callback = nullptr;
+	bool started = false;
+
+protected:
+	~FakeVideoCaptureModule() override
+	{
+		// Free for the next open
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		if (FakeCaptureDevices::Device* device = FakeCaptureDevices::Find(id))
+			if (device->module == this)
+				device->module = nullptr;
+	}
+};
+
+inline bool FakeCaptureDevices::Deliver(const std::string& id, const VideoFrame& frame)
+{
+	rtc::VideoSinkInterface<VideoFrame>* callback = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(GetMutex());
+		Device* device = Find(id);
+		if (device && device->module && device->module->started)
+			callback = device->module->callback;
+	}
+	if (!callback)
+		return false;
+	callback->OnFrame(frame);
+	return true;
+}
+
+class FakeDeviceInfo : public VideoCaptureModule::DeviceInfo
+{
+public:
+	uint32_t NumberOfDevices() override
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		return (uint32_t)FakeCaptureDevices::GetDevices().size();
+	}
+
+	int32_t GetDeviceName(uint32_t deviceNumber,
+		char* deviceNameUTF8, uint32_t deviceNameLength,
+		char* deviceUniqueIdUTF8, uint32_t deviceUniqueIdUTF8Length,
+		char* = 0, uint32_t = 0) override
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		auto& devices = FakeCaptureDevices::GetDevices();
+		if (deviceNumber >= devices.size() || !deviceNameLength || !deviceUniqueIdUTF8Length)
+			return -1;
+		strncpy(deviceNameUTF8, devices[deviceNumber].name.c_str(), deviceNameLength - 1);
+		strncpy(deviceUniqueIdUTF8, devices[deviceNumber].id.c_str(), deviceUniqueIdUTF8Length - 1);
+		return 0;
+	}
+
+	int32_t NumberOfCapabilities(const char* deviceUniqueIdUTF8) override
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		FakeCaptureDevices::Device* device = FakeCaptureDevices::Find(deviceUniqueIdUTF8);
+		return device ? (int32_t)device->capabilities.size() : -1;
+	}
+
+	int32_t GetCapability(const char* deviceUniqueIdUTF8,
+		const uint32_t deviceCapabilityNumber, VideoCaptureCapability& capability) override
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		FakeCaptureDevices::Device* device = FakeCaptureDevices::Find(deviceUniqueIdUTF8);
+		if (!device || deviceCapabilityNumber >= device->capabilities.size())
+			return -1;
+		capability = device->capabilities[deviceCapabilityNumber];
+		return 0;
+	}
+};
+
+class VideoCaptureFactory
+{
+public:
+	// Null when there is no such camera or it is already open
+	static rtc::scoped_refptr<VideoCaptureModule> Create(const char* deviceUniqueIdUTF8)
+	{
+		std::lock_guard<std::mutex> lock(FakeCaptureDevices::GetMutex());
+		FakeCaptureDevices::Device* device = FakeCaptureDevices::Find(deviceUniqueIdUTF8);
+		if (!device || device->module)
+			return nullptr;
+		device->module = new rtc::RefCountedObject<FakeVideoCaptureModule>(device->id);
+		device->opens++;
+		return device->module;
+	}
+
+	static VideoCaptureModule::DeviceInfo* CreateDeviceInfo()
+	{
+		return new FakeDeviceInfo();
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,37 @@
+// Subset of webrtc pc/video_track_source.h, sinks go straight to the source
+#ifndef FAKE_PC_VIDEO_TRACK_SOURCE_H
+#define FAKE_PC_VIDEO_TRACK_SOURCE_H
+
+#include "api/video/video_frame.h"
+#include "api/video/video_source_interface.h"
+#include "rtc_base/ref_count.h"
+
+namespace webrtc {
+
+class VideoTrackSource : public rtc::RefCountInterface, public rtc::VideoSourceInterface<VideoFrame>
+{
+public:
+	explicit VideoTrackSource(bool remote) : remote_(remote) {}
+
+	bool remote() const { return remote_; }
+
+	void AddOrUpdateSink(rtc::VideoSinkInterface<VideoFrame>* sink, const rtc::VideoSinkWants& wants) override
+	{
+		source()->AddOrUpdateSink(sink, wants);
+	}
+
+	void RemoveSink(rtc::VideoSinkInterface<VideoFrame>* sink) override
+	{
+		source()->RemoveSink(sink);
+	}
+
+protected:
+	virtual rtc::VideoSourceInterface<VideoFrame>* source() = 0;
+
+private:
+	const bool remote_;
+};
+
+}
+
+#endif
@@ -0,0 +1,14 @@
+// Subset of webrtc rtc_base/checks.h
+#ifndef FAKE_RTC_BASE_CHECKS_H
+#define FAKE_RTC_BASE_CHECKS_H
+
+#include <stdlib.h>
+
+#define RTC_CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+			abort(); \
+	} while (0)
+
+#endif
@@ -0,0 +1,26 @@
+// Subset of webrtc rtc_base/logging.h, messages are discarded
+#ifndef FAKE_RTC_BASE_LOGGING_H
+#define FAKE_RTC_BASE_LOGGING_H
+
+namespace rtc {
+
+enum LoggingSeverity
+{
+	LS_VERBOSE,
+	LS_INFO,
+	LS_WARNING,
+	LS_ERROR,
+	LS_NONE
+};
+
+struct NullLogStream
+{
+	template<typename T>
+	NullLogStream& operator<<(const T&) { return *this; }
+};
+
+}
+
+#define RTC_LOG(sev) rtc::NullLogStream()
+
+#endif
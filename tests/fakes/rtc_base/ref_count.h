@@ -0,0 +1,25 @@
+// Same interface as webrtc rtc_base/ref_count.h
+#ifndef FAKE_RTC_BASE_REF_COUNT_H
+#define FAKE_RTC_BASE_REF_COUNT_H
+
+namespace rtc {
+
+enum class RefCountReleaseStatus
+{
+	kDroppedLastRef,
+	kOtherRefsRemained
+};
+
+class RefCountInterface
+{
+public:
+	virtual void AddRef() const = 0;
+	virtual RefCountReleaseStatus Release() const = 0;
+
+protected:
+	virtual ~RefCountInterface() {}
+};
+
+}
+
+#endif
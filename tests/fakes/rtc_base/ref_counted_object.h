@@ -0,0 +1,49 @@
+// Same behaviour as webrtc rtc_base/ref_counted_object.h
+#ifndef FAKE_RTC_BASE_REF_COUNTED_OBJECT_H
+#define FAKE_RTC_BASE_REF_COUNTED_OBJECT_H
+
+#include <atomic>
+#include <utility>
+
+#include "rtc_base/ref_count.h"
+
+namespace rtc {
+
+template<class T>
+class RefCountedObject : public T
+{
+public:
+	RefCountedObject() {}
+
+	template<class... Args>
+	explicit RefCountedObject(Args&&... args) : T(std::forward<Args>(args)...) {}
+
+	void AddRef() const override
+	{
+		ref_count.fetch_add(1);
+	}
+
+	RefCountReleaseStatus Release() const override
+	{
+		if (ref_count.fetch_sub(1) == 1)
+		{
+			delete this;
+			return RefCountReleaseStatus::kDroppedLastRef;
+		}
+		return RefCountReleaseStatus::kOtherRefsRemained;
+	}
+
+	virtual bool HasOneRef() const
+	{
+		return ref_count == 1;
+	}
+
+protected:
+	virtual ~RefCountedObject() {}
+
+	mutable std::atomic<int> ref_count{ 0 };
+};
+
+}
+
+#endif
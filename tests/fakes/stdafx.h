@@ -0,0 +1,7 @@
+// Stands in for the ATL precompiled header of the plugin
+#ifndef FAKE_STDAFX_H
+#define FAKE_STDAFX_H
+
+#include <string>
+
+#endif